@@ -21,6 +21,9 @@ static NotificationLayer* _notif_layer;
 static Window* _notif_window;
 static Menu *s_menu;
 static Window *s_main_window;
+/* pinned while the menu points into them, so the store can't free or move them */
+static full_msg_t **_listed;
+static uint16_t _listed_count;
 
 static void _notif_window_load(Window *window);
 static void _notif_window_unload(Window *window);
@@ -87,8 +90,10 @@ static void _notif_window_load(Window *window)
     layer_add_child(window_layer, menu_get_layer(s_menu));
 
     menu_set_click_config_onto_window(s_menu, window);
+    message_store_lock();
     if (!message_count())
     {
+        message_store_unlock();
         items = menu_items_create(1);
         menu_items_add(items, MenuItem("No Messages", NULL, RESOURCE_ID_SPEECH_BUBBLE, NULL));
         menu_set_items(s_menu, items);
@@ -96,12 +101,17 @@ static void _notif_window_load(Window *window)
     }
     
     items = menu_items_create(message_count());
+    _listed = app_calloc(message_count(), sizeof(full_msg_t *));
     full_msg_t *msg;
     cmd_phone_attribute_t *a;
     list_head *message_head = message_get_head();
     
     list_foreach(msg, message_head, full_msg_t, node)
     {
+        if (!_listed)
+            break;
+        message_pin(msg);
+        _listed[_listed_count++] = msg;
         list_foreach(a, &msg->attributes_list_head, cmd_phone_attribute_t, node)
         {
             MenuItem mi = MenuItem((char *)a->data, NULL, RESOURCE_ID_SPEECH_BUBBLE, _msg_list_item_selected);
@@ -109,6 +119,7 @@ static void _notif_window_load(Window *window)
             menu_items_add(items, mi);
         }
     }        
+    message_store_unlock();
     menu_set_items(s_menu, items);
 
     
@@ -123,6 +134,13 @@ static void _notif_window_unload(Window *window)
         notification_layer_destroy(_notif_layer);
         _notif_layer = NULL;
     }
+
+    /* the menu is done with them */
+    for (uint16_t i = 0; i < _listed_count; i++)
+        message_unpin(_listed[i]);
+    app_free(_listed);
+    _listed = NULL;
+    _listed_count = 0;
 }
 
 void notif_deinit(void)
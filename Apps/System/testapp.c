@@ -96,6 +96,55 @@ app_test _tests[] = {
         .test_init = &vibes_test_init,
         .test_execute = &vibes_test_exec,
         .test_deinit = &vibes_test_deinit
+    },
+    {
+        .test_name = "Layer Tree Test",
+        .test_desc = "200 Layer Scroll View",
+        .test_init = &layer_tree_test_init,
+        .test_execute = &layer_tree_test_exec,
+        .test_deinit = &layer_tree_test_deinit
+    },
+    {
+        .test_name = "Menu Large Test",
+        .test_desc = "500 Row Menu",
+        .test_init = &menu_large_test_init,
+        .test_execute = &menu_large_test_exec,
+        .test_deinit = &menu_large_test_deinit
+    },
+    {
+        .test_name = "Text Layout Test",
+        .test_desc = "300 Char Body",
+        .test_init = &text_layout_test_init,
+        .test_execute = &text_layout_test_exec,
+        .test_deinit = &text_layout_test_deinit
+    },
+    {
+        .test_name = "Log Bench Test",
+        .test_desc = "Log Call Cycles",
+        .test_init = &log_bench_test_init,
+        .test_execute = &log_bench_test_exec,
+        .test_deinit = &log_bench_test_deinit
+    },
+    {
+        .test_name = "Notification Parse Test",
+        .test_desc = "Parse Cycles, Heap",
+        .test_init = &notification_parse_test_init,
+        .test_execute = &notification_parse_test_exec,
+        .test_deinit = &notification_parse_test_deinit
+    },
+    {
+        .test_name = "Notification Store Test",
+        .test_desc = "Burst Eviction",
+        .test_init = &notification_store_test_init,
+        .test_execute = &notification_store_test_exec,
+        .test_deinit = &notification_store_test_deinit
+    },
+    {
+        .test_name = "Notification Burst Test",
+        .test_desc = "Coalesced Overlay",
+        .test_init = &notification_burst_test_init,
+        .test_execute = &notification_burst_test_exec,
+        .test_deinit = &notification_burst_test_deinit
     }
 };
 
@@ -146,7 +195,7 @@ void test_set_success(bool success)
 /* Just flag the test as completed in whatever state it is in */
 bool _test_pass(bool pass, char *msg)
 {
-    APP_LOG("tstapp", pass ? APP_LOG_LEVEL_INFO : APP_LOG_LEVEL_ERROR, msg);
+    APP_LOG("tstapp", pass ? APP_LOG_LEVEL_INFO : APP_LOG_LEVEL_ERROR, "%s", msg);
     test_set_success(pass);
     return pass;
 }
@@ -8,3 +8,11 @@ SRCS_all += Apps/System/tests/menu_simple_test.c
 SRCS_all += Apps/System/tests/menu_multi_column_test.c
 SRCS_all += Apps/System/tests/action_menu_test.c
 SRCS_all += Apps/System/tests/vibes_test.c
+SRCS_all += Apps/System/tests/layer_tree_test.c
+SRCS_all += Apps/System/tests/menu_large_test.c
+SRCS_all += Apps/System/tests/text_layout_test.c
+SRCS_all += Apps/System/tests/log_bench_test.c
+SRCS_all += Apps/System/tests/test_notification.c
+SRCS_all += Apps/System/tests/notification_parse_test.c
+SRCS_all += Apps/System/tests/notification_store_test.c
+SRCS_all += Apps/System/tests/notification_burst_test.c
@@ -0,0 +1,93 @@
+/* layer_tree_test.c
+ * Build and tear down a big scroll view, timing the layer tree operations
+ * libRebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+
+#define LAYER_TREE_TEST_COUNT  200
+#define LAYER_TREE_TEST_HEIGHT 20
+
+static ScrollLayer *_scroll_layer;
+static Layer *_layers[LAYER_TREE_TEST_COUNT];
+
+bool layer_tree_test_init(Window *window)
+{
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Init: Layer Tree Test");
+    Layer *window_layer = window_get_root_layer(window);
+    GRect bounds = layer_get_bounds(window_layer);
+
+    _scroll_layer = scroll_layer_create(bounds);
+    scroll_layer_set_content_size(_scroll_layer,
+        GSize(bounds.size.w, LAYER_TREE_TEST_COUNT * LAYER_TREE_TEST_HEIGHT));
+    layer_add_child(window_layer, scroll_layer_get_layer(_scroll_layer));
+
+    return true;
+}
+
+bool layer_tree_test_exec(void)
+{
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Exec: Layer Tree Test");
+    Layer *root = scroll_layer_get_layer(_scroll_layer);
+    GRect bounds = layer_get_bounds(root);
+
+    TickType_t start = xTaskGetTickCount();
+    for (int i = 0; i < LAYER_TREE_TEST_COUNT; i++)
+    {
+        _layers[i] = layer_create(GRect(0, i * LAYER_TREE_TEST_HEIGHT,
+                                        bounds.size.w, LAYER_TREE_TEST_HEIGHT));
+        scroll_layer_add_child(_scroll_layer, _layers[i]);
+    }
+    TickType_t built = xTaskGetTickCount();
+
+    if (!test_assert(layer_tree_check(root)))
+        return false;
+
+    /* shuffle a few about so the middle of the list gets exercised */
+    for (int i = 1; i < LAYER_TREE_TEST_COUNT - 1; i += 2)
+        layer_insert_above_sibling(_layers[i], _layers[i + 1]);
+
+    if (!test_assert(layer_tree_check(root)))
+        return false;
+
+    TickType_t shuffled = xTaskGetTickCount();
+    /* tear down from the middle out, the worst case for a parent search */
+    for (int i = 0; i < LAYER_TREE_TEST_COUNT; i++)
+    {
+        int n = (LAYER_TREE_TEST_COUNT / 2 + i) % LAYER_TREE_TEST_COUNT;
+        layer_remove_from_parent(_layers[n]);
+        layer_destroy(_layers[n]);
+        _layers[n] = NULL;
+    }
+    TickType_t done = xTaskGetTickCount();
+
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "%d layers: build %dms reorder %dms teardown %dms",
+            LAYER_TREE_TEST_COUNT,
+            (built - start) * portTICK_PERIOD_MS,
+            (shuffled - built) * portTICK_PERIOD_MS,
+            (done - shuffled) * portTICK_PERIOD_MS);
+
+    test_complete(test_assert(layer_tree_check(root)));
+
+    return true;
+}
+
+bool layer_tree_test_deinit(void)
+{
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "De-Init: Layer Tree Test");
+    for (int i = 0; i < LAYER_TREE_TEST_COUNT; i++)
+    {
+        if (_layers[i])
+        {
+            layer_remove_from_parent(_layers[i]);
+            layer_destroy(_layers[i]);
+            _layers[i] = NULL;
+        }
+    }
+    scroll_layer_destroy(_scroll_layer);
+    _scroll_layer = NULL;
+
+    return true;
+}
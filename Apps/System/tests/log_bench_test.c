@@ -0,0 +1,63 @@
+/* log_bench_test.c
+ * How many cycles a log call costs the caller, and that a burst
+ * bigger than the log ring is dropped and counted rather than waited on
+ * libRebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+
+/* comfortably fits in the ring */
+#define LOG_BENCH_RUNS 16
+/* doesn't */
+#define LOG_BENCH_BURST 200
+
+bool log_bench_test_init(Window *window)
+{
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Init: Log Bench Test");
+    return true;
+}
+
+bool log_bench_test_exec(void)
+{
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Exec: Log Bench Test");
+
+    /* let anything already queued drain first */
+    vTaskDelay(pdMS_TO_TICKS(200));
+    uint32_t dropped = log_dropped_count();
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    uint32_t start = DWT->CYCCNT;
+    for (int i = 0; i < LOG_BENCH_RUNS; i++)
+        SYS_LOG("logbench", APP_LOG_LEVEL_DEBUG, "int %d hex %x", i, i * 3);
+    uint32_t ints = DWT->CYCCNT - start;
+
+    start = DWT->CYCCNT;
+    for (int i = 0; i < LOG_BENCH_RUNS; i++)
+        SYS_LOG("logbench", APP_LOG_LEVEL_DEBUG, "string %s %d", "a short string", i);
+    uint32_t strings = DWT->CYCCNT - start;
+
+    vTaskDelay(pdMS_TO_TICKS(200));
+    if (!test_assert(log_dropped_count() == dropped))
+        return false;
+
+    for (int i = 0; i < LOG_BENCH_BURST; i++)
+        SYS_LOG("logbench", APP_LOG_LEVEL_DEBUG, "burst %d", i);
+    uint32_t burst_dropped = log_dropped_count() - dropped;
+    if (!test_assert(burst_dropped > 0))
+        return false;
+
+    vTaskDelay(pdMS_TO_TICKS(200));
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "Log call: %d cycles (ints), %d cycles (string). Burst of %d dropped %d",
+            ints / LOG_BENCH_RUNS, strings / LOG_BENCH_RUNS, LOG_BENCH_BURST, burst_dropped);
+
+    return true;
+}
+
+bool log_bench_test_deinit(void)
+{
+    return true;
+}
@@ -0,0 +1,112 @@
+/* menu_large_test.c
+ * Scroll a 500 row menu, and time how long the menu layer takes with it
+ * RebbleOS
+ */
+
+#include "librebble.h"
+#include "menu_layer.h"
+#include "test_defs.h"
+
+#define MENU_LARGE_TEST_ROWS 500
+
+static MenuLayer *s_menu_layer;
+static uint16_t s_num_rows;
+static uint16_t s_rows_drawn;
+static uint16_t s_heights_asked;
+
+static uint16_t _get_num_rows(MenuLayer *menu_layer, uint16_t section_index, void *context)
+{
+    return s_num_rows;
+}
+
+static int16_t _get_cell_height(MenuLayer *menu_layer, MenuIndex *cell_index, void *context)
+{
+    s_heights_asked++;
+    // a mix of heights, so the layout has something to work out
+    return cell_index->row % 3 ? MENU_CELL_BASIC_CELL_HEIGHT : MENU_CELL_BASIC_CELL_HEIGHT + 12;
+}
+
+static void _draw_row(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *context)
+{
+    char title[16];
+    char subtitle[16];
+
+    s_rows_drawn++;
+    snprintf(title, sizeof(title), "Row %d", cell_index->row);
+    snprintf(subtitle, sizeof(subtitle), "of %d", s_num_rows);
+    menu_cell_basic_draw(ctx, cell_layer, title, subtitle, NULL);
+}
+
+static void _selection_changed(MenuLayer *menu_layer, MenuIndex *new_index, MenuIndex *old_index, void *context)
+{
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "Row %d: %d rows drawn, %d heights asked for since last",
+            new_index->row, s_rows_drawn, s_heights_asked);
+    s_rows_drawn = 0;
+    s_heights_asked = 0;
+}
+
+static void _select_click(MenuLayer *menu_layer, MenuIndex *cell_index, void *context)
+{
+    // append a screenful, which shouldn't need the others measuring again
+    s_heights_asked = 0;
+    s_num_rows += 10;
+    TickType_t start = xTaskGetTickCount();
+    menu_layer_reload_data(s_menu_layer);
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "Appended to %d rows in %dms, %d heights asked for",
+            s_num_rows, (xTaskGetTickCount() - start) * portTICK_PERIOD_MS, s_heights_asked);
+}
+
+static void _select_long_click(MenuLayer *menu_layer, MenuIndex *cell_index, void *context)
+{
+    test_complete(true);
+}
+
+bool menu_large_test_init(Window *window)
+{
+    Layer *window_layer = window_get_root_layer(window);
+    GRect bounds = layer_get_frame(window_layer);
+
+    s_num_rows = MENU_LARGE_TEST_ROWS;
+    s_menu_layer = menu_layer_create(bounds);
+    menu_layer_set_callbacks(s_menu_layer, NULL, (MenuLayerCallbacks) {
+        .get_num_rows = _get_num_rows,
+        .get_cell_height = _get_cell_height,
+        .draw_row = _draw_row,
+        .selection_changed = _selection_changed,
+        .select_click = _select_click,
+        .select_long_click = _select_long_click,
+    });
+    menu_layer_set_click_config_onto_window(s_menu_layer, window);
+    layer_add_child(window_layer, menu_layer_get_layer(s_menu_layer));
+
+    return true;
+}
+
+bool menu_large_test_exec(void)
+{
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "Exec: Menu Large Test. Hold select to pass");
+
+    s_heights_asked = 0;
+    TickType_t start = xTaskGetTickCount();
+    menu_layer_reload_data(s_menu_layer);
+    TickType_t reloaded = xTaskGetTickCount();
+    uint16_t reload_heights = s_heights_asked;
+    
+    // the worst case: jump to the bottom, measuring everything above it
+    menu_layer_set_selected_index(s_menu_layer, MenuIndex(0, s_num_rows - 1), MenuRowAlignCenter, false);
+    TickType_t jumped = xTaskGetTickCount();
+    
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "%d rows: reload %dms (%d heights), jump to end %dms",
+            s_num_rows, (reloaded - start) * portTICK_PERIOD_MS, reload_heights,
+            (jumped - reloaded) * portTICK_PERIOD_MS);
+    
+    return true;
+}
+
+bool menu_large_test_deinit(void)
+{
+    layer_remove_from_parent(menu_layer_get_layer(s_menu_layer));
+    menu_layer_destroy(s_menu_layer);
+    s_menu_layer = NULL;
+    return true;
+}
@@ -0,0 +1,94 @@
+/* notification_burst_test.c
+ * A burst of notifications from the phone, the way the endpoint hands
+ * them over. They should go into one window instead of a window each,
+ * and every one should be accounted for
+ * libRebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "protocol_notification.h"
+#include "notification_manager.h"
+#include "test_notification.h"
+
+#define NOTY_BURST 50
+/* how long the overlay thread gets to catch up */
+#define NOTY_BURST_WAIT_MS 2000
+/* and for the windows to time out, each one after the last */
+#define NOTY_CLOSE_WAIT_MS 30000
+/* so ours can be told apart from real ones */
+#define NOTY_ID_BASE 0x7e580000
+
+static uint8_t _packet[256];
+
+static uint16_t _make_notification(uint16_t n)
+{
+    uint16_t lens[2] = { 12, 20 + (n * 37) % 100 };
+    return test_make_notification(_packet, sizeof(_packet), NOTY_ID_BASE + n, 2, lens, false);
+}
+
+static uint32_t _accounted(NotificationBurstStats *before, NotificationBurstStats *now)
+{
+    return (now->windows - before->windows) + (now->merged - before->merged) +
+           (now->not_shown - before->not_shown);
+}
+
+bool notification_burst_test_init(Window *window)
+{
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Init: Notification Burst Test");
+    return true;
+}
+
+bool notification_burst_test_exec(void)
+{
+    NotificationBurstStats before, after;
+
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Exec: Notification Burst Test");
+
+    notification_burst_stats(&before);
+    uint8_t overlays = overlay_window_count();
+
+    TickType_t start = xTaskGetTickCount();
+    for (uint16_t i = 0; i < NOTY_BURST; i++)
+    {
+        uint16_t len = _make_notification(i);
+        process_notification_packet(_packet, len);
+    }
+    TickType_t pushed = xTaskGetTickCount();
+
+    /* absorbed once the overlay thread has put them all somewhere */
+    do {
+        notification_burst_stats(&after);
+        if (_accounted(&before, &after) == NOTY_BURST)
+            break;
+        vTaskDelay(1);
+    } while ((xTaskGetTickCount() - start) * portTICK_PERIOD_MS < NOTY_BURST_WAIT_MS);
+    TickType_t absorbed = xTaskGetTickCount();
+
+    uint32_t windows = after.windows - before.windows;
+    uint32_t shown = windows + after.merged - before.merged;
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "Burst of %d: pushed in %dms, absorbed in %dms. %d reached the UI in %d windows, %d only stored",
+            NOTY_BURST, (pushed - start) * portTICK_PERIOD_MS, (absorbed - start) * portTICK_PERIOD_MS,
+            shown, windows, after.not_shown - before.not_shown);
+
+    bool ok = test_assert(_accounted(&before, &after) == NOTY_BURST);
+    /* a window can only be full */
+    ok = ok && test_assert(shown >= NOTIFICATION_WINDOW_MAX_MESSAGES || shown == NOTY_BURST);
+    /* one window, unless one was open already and timed out mid burst */
+    ok = ok && test_assert(windows <= 2 && overlay_window_count() <= overlays + 1);
+
+    /* leave nothing behind: wait for our windows to go, and then the messages they had */
+    start = xTaskGetTickCount();
+    while (overlay_window_count() > overlays &&
+           (xTaskGetTickCount() - start) * portTICK_PERIOD_MS < NOTY_CLOSE_WAIT_MS)
+        vTaskDelay(pdMS_TO_TICKS(100));
+
+    ok = test_assert(overlay_window_count() <= overlays) && ok;
+    return test_assert(test_remove_notifications(NOTY_ID_BASE, NOTY_BURST) == 0) && ok;
+}
+
+bool notification_burst_test_deinit(void)
+{
+    return true;
+}
@@ -0,0 +1,101 @@
+/* notification_parse_test.c
+ * Parse time for phone notifications, and what a steady stream of them
+ * does to the notification heap. Also that one cut short is turned away
+ * libRebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "protocol_notification.h"
+#include "notification_message.h"
+#include "test_notification.h"
+
+#define NOTY_BENCH_COUNT 1000
+/* how many are kept around at once, oldest freed first */
+#define NOTY_BENCH_KEEP 8
+
+static uint8_t _packet[512];
+static uint32_t _seed = 1;
+
+static uint32_t _rand(void)
+{
+    _seed = _seed * 1103515245 + 12345;
+    return (_seed >> 16) & 0x7fff;
+}
+
+/* title, maybe a subtitle, a body and a dismiss action. Returns the length */
+static uint16_t _make_notification(uint32_t id)
+{
+    uint16_t lens[3];
+    uint8_t count = 2 + _rand() % 2;
+
+    for (uint8_t i = 0; i < count; i++)
+        lens[i] = i == count - 1 ? _rand() % 300 : 4 + _rand() % 28;
+
+    return test_make_notification(_packet, sizeof(_packet), id, count, lens, true);
+}
+
+bool notification_parse_test_init(Window *window)
+{
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Init: Notification Parse Test");
+    return true;
+}
+
+bool notification_parse_test_exec(void)
+{
+    full_msg_t *kept[NOTY_BENCH_KEEP] = { NULL };
+    uint32_t free_start, free_now, largest;
+    uint32_t cycles = 0, bytes = 0, worst_frag = 0;
+
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Exec: Notification Parse Test");
+
+    noty_heap_stats(&free_start, &largest);
+
+    /* short by a byte, so the last string runs off the end */
+    full_msg_t *msg;
+    uint16_t len = _make_notification(0);
+    if (!test_assert(!notification_packet_push(_packet, len - 1, &msg)))
+        return false;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (int i = 0; i < NOTY_BENCH_COUNT; i++)
+    {
+        len = _make_notification(i);
+        bytes += len;
+
+        uint8_t slot = i % NOTY_BENCH_KEEP;
+        if (kept[slot])
+            notification_packet_free(kept[slot]);
+
+        uint32_t start = DWT->CYCCNT;
+        bool ok = notification_packet_push(_packet, len, &kept[slot]);
+        cycles += DWT->CYCCNT - start;
+
+        if (!test_assert(ok))
+            return false;
+
+        /* how much of the free space can't be used for one big block */
+        noty_heap_stats(&free_now, &largest);
+        uint32_t frag = free_now ? 100 - largest * 100 / free_now : 0;
+        if (frag > worst_frag)
+            worst_frag = frag;
+    }
+
+    for (int i = 0; i < NOTY_BENCH_KEEP; i++)
+        notification_packet_free(kept[i]);
+
+    noty_heap_stats(&free_now, &largest);
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "%d notifications, avg %d bytes: %d cycles each, worst fragmentation %d%%",
+            NOTY_BENCH_COUNT, bytes / NOTY_BENCH_COUNT, cycles / NOTY_BENCH_COUNT, worst_frag);
+
+    /* every one went back */
+    return test_assert(free_now == free_start);
+}
+
+bool notification_parse_test_deinit(void)
+{
+    return true;
+}
@@ -0,0 +1,127 @@
+/* notification_store_test.c
+ * A burst of notifications far bigger than the store. The oldest should
+ * go to make room and none of the new ones should be lost, and the ones
+ * a list is showing should stay put while it does
+ * libRebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "protocol_notification.h"
+#include "notification_message.h"
+#include "test_notification.h"
+
+#define NOTY_BURST 200
+/* listed, the way the notification app lists them, while a second burst comes in */
+#define NOTY_LISTED 4
+/* so ours can be told apart from real ones */
+#define NOTY_ID_BASE 0x7e570000
+
+static uint8_t _packet[256];
+
+/* a title and a body of varying length */
+static bool _push_notification(uint16_t n)
+{
+    full_msg_t *msg;
+    uint16_t lens[2] = { 12, 40 + (n * 37) % 160 };
+    uint16_t len = test_make_notification(_packet, sizeof(_packet), NOTY_ID_BASE + n, 2, lens, false);
+
+    if (!notification_packet_push(_packet, len, &msg))
+        return false;
+    message_add(msg);
+    return true;
+}
+
+/* what a list shows of a message, to see it didn't change under it */
+static uint32_t _message_sum(full_msg_t *msg)
+{
+    uint32_t sum = msg->header->id;
+    cmd_phone_attribute_t *a;
+
+    list_foreach(a, &msg->attributes_list_head, cmd_phone_attribute_t, node)
+        for (uint16_t i = 0; i < a->hdr.str_len; i++)
+            sum = sum * 31 + a->data[i];
+    return sum;
+}
+
+static bool _message_in_store(full_msg_t *want)
+{
+    full_msg_t *msg;
+    list_foreach(msg, message_get_head(), full_msg_t, node)
+        if (msg == want)
+            return true;
+    return false;
+}
+
+bool notification_store_test_init(Window *window)
+{
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Init: Notification Store Test");
+    return true;
+}
+
+bool notification_store_test_exec(void)
+{
+    MessageStoreStats before, after;
+    full_msg_t *msg, *listed[NOTY_LISTED];
+    uint32_t sums[NOTY_LISTED];
+    uint16_t kept_max = 0, n, count = 0;
+    bool ok = true;
+
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Exec: Notification Store Test");
+
+    message_store_stats(&before);
+
+    for (n = 0; ok && n < NOTY_BURST; n++)
+    {
+        ok = test_assert(_push_notification(n));
+
+        uint16_t kept = message_count();
+        if (kept > kept_max)
+            kept_max = kept;
+    }
+
+    message_store_stats(&after);
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "Burst of %d: kept at most %d, %d now in %d bytes. %d evicted, %d compactions",
+            NOTY_BURST, kept_max, after.count, after.bytes,
+            after.evicted - before.evicted, after.compactions - before.compactions);
+
+    /* the newest is at the front. List it and the next few */
+    message_store_lock();
+    msg = list_elem(list_get_head(message_get_head()), full_msg_t, node);
+    ok = ok && test_assert(msg && msg->header->id == NOTY_ID_BASE + NOTY_BURST - 1);
+    list_foreach(msg, message_get_head(), full_msg_t, node)
+    {
+        if (count == NOTY_LISTED)
+            break;
+        message_pin(msg);
+        listed[count] = msg;
+        sums[count++] = _message_sum(msg);
+    }
+    message_store_unlock();
+
+    /* and the store fills up again under the list */
+    for (; ok && n < 2 * NOTY_BURST; n++)
+        ok = test_assert(_push_notification(n));
+
+    message_store_lock();
+    for (uint16_t i = 0; i < count; i++)
+        ok = ok && test_assert(_message_in_store(listed[i]) && _message_sum(listed[i]) == sums[i]);
+    message_store_unlock();
+
+    message_store_stats(&after);
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "Second burst with %d listed: %d evicted, %d compactions in all",
+            count, after.evicted - before.evicted, after.compactions - before.compactions);
+
+    for (uint16_t i = 0; i < count; i++)
+        message_unpin(listed[i]);
+    /* none of ours are left to fill the store for real ones */
+    ok = test_assert(test_remove_notifications(NOTY_ID_BASE, 2 * NOTY_BURST) == 0) && ok;
+
+    return ok && test_assert(count == NOTY_LISTED && after.failed == before.failed);
+}
+
+bool notification_store_test_deinit(void)
+{
+    return true;
+}
@@ -153,3 +153,31 @@ bool action_menu_test_deinit(void);
 bool vibes_test_init(Window *window);
 bool vibes_test_exec(void);
 bool vibes_test_deinit(void);
+
+bool layer_tree_test_init(Window *window);
+bool layer_tree_test_exec(void);
+bool layer_tree_test_deinit(void);
+
+bool menu_large_test_init(Window *window);
+bool menu_large_test_exec(void);
+bool menu_large_test_deinit(void);
+
+bool text_layout_test_init(Window *window);
+bool text_layout_test_exec(void);
+bool text_layout_test_deinit(void);
+
+bool log_bench_test_init(Window *window);
+bool log_bench_test_exec(void);
+bool log_bench_test_deinit(void);
+
+bool notification_parse_test_init(Window *window);
+bool notification_parse_test_exec(void);
+bool notification_parse_test_deinit(void);
+
+bool notification_store_test_init(Window *window);
+bool notification_store_test_exec(void);
+bool notification_store_test_deinit(void);
+
+bool notification_burst_test_init(Window *window);
+bool notification_burst_test_exec(void);
+bool notification_burst_test_deinit(void);
@@ -0,0 +1,86 @@
+/* test_notification.c
+ * Phone notification packets for the notification tests
+ * libRebbleOS
+ */
+
+#include "rebbleos.h"
+#include "protocol_notification.h"
+#include "notification_message.h"
+#include "test_notification.h"
+
+#define DISMISS "Dismiss"
+
+static uint8_t *_put_string(uint8_t *p, uint16_t len, uint32_t id)
+{
+    p[0] = len & 0xff;
+    p[1] = len >> 8;
+    p += 2;
+    for (uint16_t i = 0; i < len; i++)
+        *p++ = 'a' + (id + i) % 26;
+    return p;
+}
+
+uint16_t test_make_notification(uint8_t *buf, uint16_t size, uint32_t id,
+                                uint8_t attr_count, const uint16_t *lens, bool dismiss)
+{
+    uint32_t need = sizeof(cmd_phone_notify_t);
+    for (uint8_t i = 0; i < attr_count; i++)
+        need += sizeof(cmd_phone_attribute_hdr_t) + lens[i];
+    if (dismiss)
+        need += sizeof(cmd_phone_action_hdr_t) + strlen(DISMISS);
+    if (need > size)
+        return 0;
+
+    cmd_phone_notify_t *hdr = (cmd_phone_notify_t *)buf;
+    memset(hdr, 0, sizeof(cmd_phone_notify_t));
+    hdr->id = id;
+    hdr->attr_count = attr_count;
+    hdr->action_count = dismiss;
+
+    uint8_t *p = buf + sizeof(cmd_phone_notify_t);
+    for (uint8_t i = 0; i < attr_count; i++)
+    {
+        *p++ = i + 1;
+        p = _put_string(p, lens[i], id);
+    }
+
+    if (dismiss)
+    {
+        /* id, cmd, attribute count, attribute id */
+        *p++ = 0;
+        *p++ = 4;
+        *p++ = 1;
+        *p++ = 1;
+        p[0] = strlen(DISMISS);
+        p[1] = 0;
+        memcpy(p + 2, DISMISS, strlen(DISMISS));
+        p += 2 + strlen(DISMISS);
+    }
+
+    return p - buf;
+}
+
+uint16_t test_remove_notifications(uint32_t first_id, uint32_t count)
+{
+    list_head *head = message_get_head();
+    uint16_t pinned = 0;
+
+    message_store_lock();
+    list_node *l = list_get_head(head);
+    while (l)
+    {
+        list_node *next = list_get_next(head, l);
+        full_msg_t *msg = list_elem(l, full_msg_t, node);
+        if (msg->header->id - first_id < count)
+        {
+            if (msg->pins)
+                pinned++;
+            else
+                message_remove(msg);
+        }
+        l = next;
+    }
+    message_store_unlock();
+
+    return pinned;
+}
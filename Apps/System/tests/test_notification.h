@@ -0,0 +1,38 @@
+#pragma once
+/**
+ * @file test_notification.h
+ * @brief Phone notification packets for the notification tests
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Build a notification the way the phone sends one
+ *
+ * Each attribute gets a string of letters. The id goes in the header and
+ * picks the letters, so two notifications with different ids differ
+ * @code
+ * uint16_t lens[2] = { 12, 40 };
+ * uint16_t len = test_make_notification(buf, sizeof(buf), n, 2, lens, false);
+ * @endcode
+ * @param buf where to build it
+ * @param size bytes in buf
+ * @param id the notification id
+ * @param attr_count how many attributes, one length each in lens
+ * @param lens the length of each attribute's string
+ * @param dismiss add a dismiss action after the attributes
+ * @return the packet length, or 0 if it won't fit in buf
+ */
+uint16_t test_make_notification(uint8_t *buf, uint16_t size, uint32_t id,
+                                uint8_t attr_count, const uint16_t *lens, bool dismiss);
+
+/**
+ * @brief Take a test's notifications back out of the store
+ *
+ * Those still pinned by a window or a list are left where they are
+ * @param first_id the lowest id the test used
+ * @param count how many ids from there
+ * @return how many were left in, pinned
+ */
+uint16_t test_remove_notifications(uint32_t first_id, uint32_t count);
@@ -0,0 +1,92 @@
+/* text_layout_test.c
+ * Lay out and draw a notification sized body of text over and over,
+ * timing it with and without the TextLayer layout cache
+ * libRebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+
+#define TEXT_LAYOUT_TEST_RUNS 50
+
+/* 300 characters, about what a chatty notification body comes to */
+static const char _body[] =
+    "Running late, the train is stuck outside the station again. "
+    "Can you let everyone know we will be there in about twenty minutes? "
+    "Also pick up some bread and milk on the way home if you get the chance, "
+    "we are out of both. Don't forget the meeting moved to Thursday at ten, "
+    "bring the printed slides and laptop!";
+
+/* the same text somewhere else, so each set looks like new text */
+static char _body_copy[sizeof(_body)];
+static TextLayer *_text_layer;
+static Window *_window;
+
+bool text_layout_test_init(Window *window)
+{
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Init: Text Layout Test");
+    Layer *window_layer = window_get_root_layer(window);
+    GRect bounds = layer_get_bounds(window_layer);
+
+    _window = window;
+    memcpy(_body_copy, _body, sizeof(_body));
+    _text_layer = text_layer_create(bounds);
+    text_layer_set_font(_text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18));
+    text_layer_set_text(_text_layer, _body);
+    layer_add_child(window_layer, text_layer_get_layer(_text_layer));
+
+    return true;
+}
+
+bool text_layout_test_exec(void)
+{
+    APP_LOG("test", APP_LOG_LEVEL_ERROR, "Exec: Text Layout Test");
+
+    /* laid out once, then answered from the cache */
+    TickType_t start = xTaskGetTickCount();
+    GSize size = text_layer_get_content_size(_text_layer);
+    for (int i = 1; i < TEXT_LAYOUT_TEST_RUNS; i++)
+        test_assert(text_layer_get_content_size(_text_layer).h == size.h);
+    TickType_t cached = xTaskGetTickCount();
+
+    /* swapping buffers every time forces it all to be laid out again */
+    for (int i = 0; i < TEXT_LAYOUT_TEST_RUNS; i++)
+    {
+        text_layer_set_text(_text_layer, i & 1 ? _body : _body_copy);
+        test_assert(text_layer_get_content_size(_text_layer).h == size.h);
+    }
+    TickType_t uncached = xTaskGetTickCount();
+
+    if (!test_assert(size.h > 0))
+        return false;
+
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "Content %dx%d. %d sizes: %dms cached, %dms laid out each time",
+            size.w, size.h, TEXT_LAYOUT_TEST_RUNS,
+            (cached - start) * portTICK_PERIOD_MS, (uncached - cached) * portTICK_PERIOD_MS);
+
+    /* and how long the body takes to draw, for comparison */
+    if (!display_buffer_lock_take(portMAX_DELAY))
+        return false;
+
+    start = xTaskGetTickCount();
+    for (int i = 0; i < TEXT_LAYOUT_TEST_RUNS; i++)
+        rbl_window_draw(_window);
+    TickType_t drawn = xTaskGetTickCount();
+
+    display_buffer_lock_give();
+    window_dirty(true);
+
+    APP_LOG("test", APP_LOG_LEVEL_INFO, "%d draws: %dms",
+            TEXT_LAYOUT_TEST_RUNS, (drawn - start) * portTICK_PERIOD_MS);
+
+    return true;
+}
+
+bool text_layout_test_deinit(void)
+{
+    layer_remove_from_parent(text_layer_get_layer(_text_layer));
+    text_layer_destroy(_text_layer);
+    _text_layer = NULL;
+    return true;
+}
@@ -0,0 +1,192 @@
+/* bt_rx_fuzz.c
+ * Host fuzz and throughput test for rcore/bt_rx_stream.c
+ * RebbleOS
+ *
+ * Makes a stream of random frames, cuts it into random chunks and checks
+ * that every frame comes out whole, in order, however it was cut.
+ * Then some garbage, to check a bad length is thrown away and the
+ * stream picks up again at the next chunk.
+ * Then how fast it goes with chunks the size RFCOMM tends to give us.
+ *
+ *   cc -O2 -I rcore -o bt_rx_fuzz Utilities/bt_rx_fuzz.c rcore/bt_rx_stream.c
+ *   ./bt_rx_fuzz [seed]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bt_rx_stream.h"
+
+#define FUZZ_FRAMES 2000
+#define FUZZ_ROUNDS 200
+#define BENCH_BYTES (256 * 1024 * 1024)
+
+typedef struct fuzz_frame {
+    uint16_t endpoint;
+    uint16_t length;
+    uint32_t offset;
+} fuzz_frame;
+
+static fuzz_frame _frames[FUZZ_FRAMES];
+static uint8_t _stream[FUZZ_FRAMES * (PBL_RX_MAX_PAYLOAD + 4)];
+static uint32_t _stream_len;
+static uint8_t _rx_buf[PBL_RX_MAX_PAYLOAD];
+
+static uint32_t _next;
+static uint32_t _failed;
+
+static double _now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* mostly small, like real traffic, now and then as big as allowed */
+static uint16_t _random_length(void)
+{
+    switch (rand() % 4)
+    {
+        case 0: return 1 + rand() % 16;
+        case 1: return 1 + rand() % 256;
+        case 2: return 1 + rand() % 1024;
+        default: return PBL_RX_MAX_PAYLOAD - rand() % 8;
+    }
+}
+
+static void _make_stream(void)
+{
+    _stream_len = 0;
+    for (int i = 0; i < FUZZ_FRAMES; i++)
+    {
+        fuzz_frame *f = &_frames[i];
+        f->endpoint = 1 + rand() % 0xfffe;
+        f->length = _random_length();
+
+        uint8_t *p = _stream + _stream_len;
+        p[0] = f->length >> 8;
+        p[1] = f->length;
+        p[2] = f->endpoint >> 8;
+        p[3] = f->endpoint;
+        f->offset = _stream_len + 4;
+        for (int j = 0; j < f->length; j++)
+            p[4 + j] = rand();
+        _stream_len += 4 + f->length;
+    }
+}
+
+static void _check_frame(pbl_transport_packet *pkt, void *context)
+{
+    fuzz_frame *f = &_frames[_next++];
+
+    if (pkt->endpoint != f->endpoint || pkt->length != f->length ||
+        memcmp(pkt->data, _stream + f->offset, f->length))
+    {
+        if (!_failed++)
+            printf("frame %u wrong: endpoint %04x/%04x length %u/%u\n", _next - 1,
+                   pkt->endpoint, f->endpoint, pkt->length, f->length);
+    }
+}
+
+static void _count_frame(pbl_transport_packet *pkt, void *context)
+{
+    (*(uint32_t *)context) += pkt->data[0];
+}
+
+static void _feed_chunks(bt_rx_stream *rx, uint32_t max_chunk, bt_rx_frame_handler handler, void *context)
+{
+    uint32_t pos = 0;
+    while (pos < _stream_len)
+    {
+        uint32_t n = max_chunk ? 1 + rand() % max_chunk : _stream_len;
+        if (n > _stream_len - pos)
+            n = _stream_len - pos;
+        bt_rx_stream_feed(rx, _stream + pos, n, handler, context);
+        pos += n;
+    }
+}
+
+static void _fuzz(void)
+{
+    static const uint32_t max_chunks[] = { 1, 3, 7, 64, 1020, 5000, 0 };
+    bt_rx_stream rx;
+
+    for (int round = 0; round < FUZZ_ROUNDS; round++)
+    {
+        _make_stream();
+        uint32_t max_chunk = max_chunks[round % (sizeof(max_chunks) / sizeof(max_chunks[0]))];
+
+        bt_rx_stream_init(&rx, _rx_buf);
+        _next = 0;
+        _feed_chunks(&rx, max_chunk, _check_frame, NULL);
+
+        if (_next != FUZZ_FRAMES || rx.errors)
+        {
+            printf("round %d, chunks up to %u: %u of %d frames, %u errors\n",
+                   round, max_chunk, _next, FUZZ_FRAMES, rx.errors);
+            _failed++;
+        }
+    }
+
+    printf("fuzz: %d rounds of %d frames, %s\n", FUZZ_ROUNDS, FUZZ_FRAMES,
+           _failed ? "FAILED" : "ok");
+}
+
+static void _garbage(void)
+{
+    bt_rx_stream rx;
+    uint8_t chunk[64];
+
+    _make_stream();
+    bt_rx_stream_init(&rx, _rx_buf);
+
+    /* too long, and zero padding, neither is a frame */
+    memset(chunk, 0xff, sizeof(chunk));
+    bt_rx_stream_feed(&rx, chunk, sizeof(chunk), _check_frame, NULL);
+    memset(chunk, 0, sizeof(chunk));
+    bt_rx_stream_feed(&rx, chunk, sizeof(chunk), _check_frame, NULL);
+
+    _next = 0;
+    _feed_chunks(&rx, 1020, _check_frame, NULL);
+
+    bool ok = rx.errors == 1 && _next == FUZZ_FRAMES && rx.frames == FUZZ_FRAMES;
+    printf("garbage: %u errors, %u frames after, %s\n", rx.errors, _next, ok ? "ok" : "FAILED");
+    if (!ok)
+        _failed++;
+}
+
+static void _bench(uint32_t max_chunk, const char *name)
+{
+    bt_rx_stream rx;
+    uint32_t sum = 0;
+
+    srand(1);
+    _make_stream();
+    bt_rx_stream_init(&rx, _rx_buf);
+
+    uint32_t runs = BENCH_BYTES / _stream_len + 1;
+    double start = _now();
+    for (uint32_t i = 0; i < runs; i++)
+        _feed_chunks(&rx, max_chunk, _count_frame, &sum);
+    double secs = _now() - start;
+
+    printf("%-22s %8.1f MB/s %10.0f frames/s, %4.1f%% copied\n", name,
+           (double)runs * _stream_len / secs / 1e6, rx.frames / secs,
+           100.0 * rx.reassembled / rx.frames);
+}
+
+int main(int argc, char *argv[])
+{
+    srand(argc > 1 ? atoi(argv[1]) : time(NULL));
+
+    _fuzz();
+    _garbage();
+
+    _bench(0, "one chunk");
+    _bench(1020, "chunks up to 1020");
+    _bench(128, "chunks up to 128");
+
+    return _failed != 0;
+}
@@ -0,0 +1,217 @@
+/* bt_tx_bench.c
+ * Host benchmark for the Bluetooth TX queue in rcore/bt_tx_ring.c
+ * RebbleOS
+ *
+ * A loopback transport thread stands in for the BT thread and the UART:
+ * it takes a packet, sleeps for as long as the bytes would take on the
+ * wire (the UART is DMA, the CPU is free meanwhile), and completes it. Three senders, one per priority, push at it.
+ *
+ * "single" is how it used to be: one slot, and every sender waits for its
+ * own packet to go before it can queue the next.
+ * "ring" is bt_tx_ring with completion callbacks, senders only wait when
+ * their priority is full (the watch drops instead, here we want every
+ * message counted).
+ *
+ * Latency is from asking to send to the transport being done with it.
+ *
+ *   cc -O2 -pthread -I rcore -o bt_tx_bench Utilities/bt_tx_bench.c rcore/bt_tx_ring.c
+ *   ./bt_tx_bench
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "bt_tx_ring.h"
+
+/* the cc256x runs at 460800 baud, 10 bits a byte on the wire */
+#define WIRE_NS_PER_BYTE (10 * 1000000000ull / 460800)
+/* bytes the stack puts around every packet, roughly */
+#define WIRE_OVERHEAD 12
+#define MSGS_MAX 1000
+
+typedef struct bench_sender {
+    const char *name;
+    BluetoothTxPriority priority;
+    uint16_t len;
+    uint16_t count;
+    /* gap between sends, 0 is flat out */
+    uint32_t gap_us;
+} bench_sender;
+
+/* about two seconds each, the logs soak up whatever the wire has left */
+static const bench_sender _senders[BT_TX_PRIORITY_COUNT] = {
+    { "high (replies)",         BT_TX_PRIORITY_HIGH,   16,  400,  5000 },
+    { "normal (notifications)", BT_TX_PRIORITY_NORMAL, 200, 100,  20000 },
+    { "low (logs)",             BT_TX_PRIORITY_LOW,    80,  1000, 0 },
+};
+
+typedef struct bench_msg {
+    uint64_t queued_ns;
+    uint16_t len;
+    BluetoothTxPriority priority;
+    volatile int done;
+} bench_msg;
+
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _cond = PTHREAD_COND_INITIALIZER;
+static bool _ring_mode;
+static bt_tx_ring _ring;
+static bench_msg *_slot;
+static uint32_t _remaining;
+
+static uint64_t _latency[BT_TX_PRIORITY_COUNT][MSGS_MAX];
+static uint32_t _latency_count[BT_TX_PRIORITY_COUNT];
+
+static uint64_t _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void _sleep_ns(uint64_t ns)
+{
+    struct timespec ts = { ns / 1000000000ull, ns % 1000000000ull };
+    nanosleep(&ts, NULL);
+}
+
+/* called with _lock held */
+static void _completed(bool sent, void *context)
+{
+    bench_msg *msg = context;
+    _latency[msg->priority][_latency_count[msg->priority]++] = _now_ns() - msg->queued_ns;
+    msg->done = 1;
+    _remaining--;
+    pthread_cond_broadcast(&_cond);
+}
+
+static void *_transport_thread(void *arg)
+{
+    pthread_mutex_lock(&_lock);
+    while (_remaining)
+    {
+        bench_msg *msg = NULL;
+        bt_tx_entry entry;
+
+        if (_ring_mode && bt_tx_ring_pop(&_ring, &entry))
+            msg = entry.context;
+        else if (!_ring_mode && _slot)
+        {
+            msg = _slot;
+            _slot = NULL;
+        }
+
+        if (!msg)
+        {
+            pthread_cond_wait(&_cond, &_lock);
+            continue;
+        }
+
+        /* a free slot for anyone waiting on one */
+        pthread_cond_broadcast(&_cond);
+        pthread_mutex_unlock(&_lock);
+        _sleep_ns((msg->len + WIRE_OVERHEAD) * WIRE_NS_PER_BYTE);
+        pthread_mutex_lock(&_lock);
+        _completed(true, msg);
+    }
+    pthread_mutex_unlock(&_lock);
+
+    return NULL;
+}
+
+static void *_sender_thread(void *arg)
+{
+    const bench_sender *s = arg;
+    bench_msg *msgs = calloc(s->count, sizeof(bench_msg));
+
+    for (uint32_t i = 0; i < s->count; i++)
+    {
+        bench_msg *msg = &msgs[i];
+        msg->len = s->len;
+        msg->priority = s->priority;
+
+        pthread_mutex_lock(&_lock);
+        msg->queued_ns = _now_ns();
+        if (_ring_mode)
+        {
+            bt_tx_entry entry = { .buf = msg, .callback = _completed, .context = msg };
+            while (!bt_tx_ring_push(&_ring, s->priority, &entry))
+                pthread_cond_wait(&_cond, &_lock);
+        }
+        else
+        {
+            while (_slot)
+                pthread_cond_wait(&_cond, &_lock);
+            _slot = msg;
+        }
+        pthread_cond_broadcast(&_cond);
+
+        if (!_ring_mode)
+            while (!msg->done)
+                pthread_cond_wait(&_cond, &_lock);
+        pthread_mutex_unlock(&_lock);
+
+        if (s->gap_us)
+            _sleep_ns(s->gap_us * 1000ull);
+    }
+
+    /* the transport may still have some, so they stay around until the end */
+    return msgs;
+}
+
+static int _cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double _pct_ms(uint64_t *v, uint32_t n, uint32_t pct)
+{
+    return v[(uint64_t)(n - 1) * pct / 100] / 1e6;
+}
+
+static void _run(const char *name, bool ring_mode)
+{
+    pthread_t transport, senders[BT_TX_PRIORITY_COUNT];
+    void *msgs[BT_TX_PRIORITY_COUNT];
+
+    _ring_mode = ring_mode;
+    bt_tx_ring_init(&_ring);
+    _slot = NULL;
+    _remaining = 0;
+    for (int p = 0; p < BT_TX_PRIORITY_COUNT; p++)
+        _remaining += _senders[p].count;
+    uint32_t total = _remaining;
+    memset(_latency_count, 0, sizeof(_latency_count));
+
+    uint64_t start = _now_ns();
+    pthread_create(&transport, NULL, _transport_thread, NULL);
+    for (int p = 0; p < BT_TX_PRIORITY_COUNT; p++)
+        pthread_create(&senders[p], NULL, _sender_thread, (void *)&_senders[p]);
+    for (int p = 0; p < BT_TX_PRIORITY_COUNT; p++)
+        pthread_join(senders[p], &msgs[p]);
+    pthread_join(transport, NULL);
+    double secs = (_now_ns() - start) / 1e9;
+
+    printf("%s: %.0f msgs/s\n", name, total / secs);
+    for (int p = 0; p < BT_TX_PRIORITY_COUNT; p++)
+    {
+        uint32_t n = _latency_count[p];
+        qsort(_latency[p], n, sizeof(uint64_t), _cmp_u64);
+        printf("  %-24s p50 %7.2f ms  p90 %7.2f ms  p99 %7.2f ms\n", _senders[p].name,
+               _pct_ms(_latency[p], n, 50), _pct_ms(_latency[p], n, 90), _pct_ms(_latency[p], n, 99));
+        free(msgs[p]);
+    }
+}
+
+int main(void)
+{
+    printf("%llu ns a byte on the wire\n\n", (unsigned long long)WIRE_NS_PER_BYTE);
+    _run("single", false);
+    _run("ring", true);
+
+    return 0;
+}
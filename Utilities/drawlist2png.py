@@ -0,0 +1,214 @@
+#!/usr/bin/env python
+
+"""
+Draws the layer draw lists RebbleOS logs (build with DRAW_LIST_LOG) to a PNG.
+RebbleOS
+
+Feed it a log captured from the watch or QEMU. Every list found is drawn,
+in the order it was logged, at the screen position it was recorded for, so
+the output is what those layers put on screen. Good for diffing a frame
+against a known good image on the host.
+
+Shapes are drawn properly. Text, bitmaps and fonts only live on the watch,
+so text comes out as its box and bitmaps as a crossed box. Corner radii
+are ignored.
+"""
+
+import argparse
+import math
+import re
+import struct
+import sys
+import zlib
+
+# must match rwatch/graphics/draw_list.h
+CMD_STATE, CMD_FILL_RECT, CMD_DRAW_RECT, CMD_LINE, CMD_FILL_CIRCLE, CMD_DRAW_CIRCLE, \
+    CMD_PIXEL, CMD_TEXT, CMD_BITMAP, CMD_FILL_PATH, CMD_DRAW_PATH = range(11)
+
+TRIG_MAX_ANGLE = 0x10000
+
+parser = argparse.ArgumentParser(description = "Draw RebbleOS draw list logs to a PNG.")
+parser.add_argument("-s", "--size", default = "144x168", help = "screen size, WxH")
+parser.add_argument("-l", "--list", type = int, default = None, help = "only draw the Nth list logged")
+parser.add_argument("log", help = "log containing DL lines")
+parser.add_argument("png", help = "output PNG file")
+args = parser.parse_args()
+
+WIDTH, HEIGHT = [int(v) for v in args.size.split("x")]
+
+class Canvas:
+    def __init__(self, w, h):
+        self.w = w
+        self.h = h
+        self.pixels = [bytearray(b"\xff" * w * 3) for _ in range(h)]
+
+    def pixel(self, x, y, rgb):
+        if rgb is None or x < 0 or y < 0 or x >= self.w or y >= self.h:
+            return
+        self.pixels[y][x * 3:x * 3 + 3] = bytes(rgb)
+
+    def hline(self, x0, x1, y, rgb):
+        for x in range(x0, x1 + 1):
+            self.pixel(x, y, rgb)
+
+    def fill_rect(self, x, y, w, h, rgb):
+        for row in range(y, y + h):
+            self.hline(x, x + w - 1, row, rgb)
+
+    def draw_rect(self, x, y, w, h, rgb):
+        if w <= 0 or h <= 0:
+            return
+        self.hline(x, x + w - 1, y, rgb)
+        self.hline(x, x + w - 1, y + h - 1, rgb)
+        for row in range(y, y + h):
+            self.pixel(x, row, rgb)
+            self.pixel(x + w - 1, row, rgb)
+
+    def line(self, x0, y0, x1, y1, rgb):
+        dx, dy = abs(x1 - x0), -abs(y1 - y0)
+        sx, sy = (1 if x0 < x1 else -1), (1 if y0 < y1 else -1)
+        err = dx + dy
+        while True:
+            self.pixel(x0, y0, rgb)
+            if x0 == x1 and y0 == y1:
+                return
+            e2 = 2 * err
+            if e2 >= dy:
+                err += dy
+                x0 += sx
+            if e2 <= dx:
+                err += dx
+                y0 += sy
+
+    def circle(self, cx, cy, r, rgb, fill):
+        x, y, err = r, 0, 1 - r
+        while x >= y:
+            if fill:
+                self.hline(cx - x, cx + x, cy + y, rgb)
+                self.hline(cx - x, cx + x, cy - y, rgb)
+                self.hline(cx - y, cx + y, cy + x, rgb)
+                self.hline(cx - y, cx + y, cy - x, rgb)
+            else:
+                for px, py in ((x, y), (y, x), (-y, x), (-x, y), (-x, -y), (-y, -x), (y, -x), (x, -y)):
+                    self.pixel(cx + px, cy + py, rgb)
+            y += 1
+            if err < 0:
+                err += 2 * y + 1
+            else:
+                x -= 1
+                err += 2 * (y - x) + 1
+
+    def polygon(self, points, rgb, fill):
+        if not points:
+            return
+        if not fill:
+            for (x0, y0), (x1, y1) in zip(points, points[1:] + points[:1]):
+                self.line(x0, y0, x1, y1, rgb)
+            return
+        # even-odd scanline fill
+        for y in range(min(p[1] for p in points), max(p[1] for p in points) + 1):
+            xs = []
+            for (x0, y0), (x1, y1) in zip(points, points[1:] + points[:1]):
+                if (y0 <= y < y1) or (y1 <= y < y0):
+                    xs.append(x0 + (y - y0) * (x1 - x0) // (y1 - y0))
+            xs.sort()
+            for a, b in zip(xs[0::2], xs[1::2]):
+                self.hline(a, b, y, rgb)
+
+    def write_png(self, name):
+        def chunk(kind, data):
+            body = kind + data
+            return struct.pack(">I", len(data)) + body + struct.pack(">I", zlib.crc32(body) & 0xffffffff)
+
+        raw = b"".join(b"\x00" + bytes(row) for row in self.pixels)
+        with open(name, "wb") as f:
+            f.write(b"\x89PNG\r\n\x1a\n")
+            f.write(chunk(b"IHDR", struct.pack(">IIBBBBB", self.w, self.h, 8, 2, 0, 0, 0)))
+            f.write(chunk(b"IDAT", zlib.compress(raw, 9)))
+            f.write(chunk(b"IEND", b""))
+
+def argb_to_rgb(argb):
+    """ GColor8 is 2 bits each of alpha, red, green, blue. Clear draws nothing """
+    if (argb >> 6) == 0:
+        return None
+    return (((argb >> 4) & 3) * 85, ((argb >> 2) & 3) * 85, (argb & 3) * 85)
+
+def read_lists(log):
+    """ Yields (x, y, data) for each complete list in the log """
+    begin = re.compile(r"DL begin (-?\d+) (-?\d+) (-?\d+) (-?\d+) (\d+)")
+    hexline = re.compile(r"DL ([0-9a-f]+)\s*$")
+    current = None
+
+    for line in log:
+        m = begin.search(line)
+        if m:
+            current = [int(m.group(1)), int(m.group(2)), int(m.group(5)), bytearray()]
+            continue
+        if current is None:
+            continue
+        if "DL end" in line:
+            x, y, length, data = current
+            if len(data) == length:
+                yield x, y, bytes(data)
+            else:
+                sys.stderr.write("list at %d,%d is %d bytes, expected %d, skipped\n" % (x, y, len(data), length))
+            current = None
+            continue
+        m = hexline.search(line)
+        if m:
+            current[3] += bytes.fromhex(m.group(1))
+
+def draw_list(canvas, ox, oy, data):
+    pos = 0
+    while pos + 4 <= len(data):
+        kind, argb, size = struct.unpack_from("<BBH", data, pos)
+        payload = data[pos + 4:pos + 4 + size]
+        pos += 4 + ((size + 3) & ~3)
+        rgb = argb_to_rgb(argb)
+
+        if kind == CMD_STATE:
+            continue
+        elif kind in (CMD_FILL_RECT, CMD_DRAW_RECT):
+            x, y, w, h = struct.unpack_from("<hhhh", payload)
+            if kind == CMD_FILL_RECT:
+                canvas.fill_rect(ox + x, oy + y, w, h, rgb)
+            else:
+                canvas.draw_rect(ox + x, oy + y, w, h, rgb)
+        elif kind == CMD_LINE:
+            x0, y0, x1, y1 = struct.unpack_from("<hhhh", payload)
+            canvas.line(ox + x0, oy + y0, ox + x1, oy + y1, rgb)
+        elif kind in (CMD_FILL_CIRCLE, CMD_DRAW_CIRCLE):
+            x, y, r = struct.unpack_from("<hhH", payload)
+            canvas.circle(ox + x, oy + y, r, rgb, kind == CMD_FILL_CIRCLE)
+        elif kind == CMD_PIXEL:
+            x, y = struct.unpack_from("<hh", payload)
+            canvas.pixel(ox + x, oy + y, rgb)
+        elif kind == CMD_TEXT:
+            x, y, w, h = struct.unpack_from("<hhhh", payload, 8)
+            canvas.draw_rect(ox + x, oy + y, w, h, rgb)
+        elif kind == CMD_BITMAP:
+            x, y, w, h = struct.unpack_from("<hhhh", payload, 4)
+            grey = (128, 128, 128)
+            canvas.draw_rect(ox + x, oy + y, w, h, grey)
+            canvas.line(ox + x, oy + y, ox + x + w - 1, oy + y + h - 1, grey)
+            canvas.line(ox + x + w - 1, oy + y, ox + x, oy + y + h - 1, grey)
+        elif kind in (CMD_FILL_PATH, CMD_DRAW_PATH):
+            rotation, px, py, count = struct.unpack_from("<ihhH", payload)
+            angle = 2 * math.pi * rotation / TRIG_MAX_ANGLE
+            c, s = math.cos(angle), math.sin(angle)
+            points = []
+            for i in range(count):
+                x, y = struct.unpack_from("<hh", payload, 12 + i * 4)
+                points.append((ox + px + int(round(x * c - y * s)), oy + py + int(round(x * s + y * c))))
+            canvas.polygon(points, rgb, kind == CMD_FILL_PATH)
+        else:
+            sys.stderr.write("unknown command %d, rest of list skipped\n" % kind)
+            return
+
+canvas = Canvas(WIDTH, HEIGHT)
+with open(args.log, "r", errors = "replace") as log:
+    for n, (x, y, data) in enumerate(read_lists(log)):
+        if args.list is None or args.list == n:
+            draw_list(canvas, x, y, data)
+
+canvas.write_png(args.png)
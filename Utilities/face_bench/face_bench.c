@@ -0,0 +1,424 @@
+/* face_bench.c
+ * Host bench for watchfaces in Watchfaces/, drawn through the real
+ * rwatch/ui/layer/layer.c
+ * RebbleOS
+ *
+ * Each face is loaded and ticked once a second, and every tick is drawn
+ * the way window_draw() does it: the damage is grown over the layers it
+ * touches, its background filled, and the tree walked. For each face it
+ * reports, per frame:
+ *  - the damaged area, and the pixels the graphics calls painted
+ *  - the rows, and bytes, that go to the display
+ *  - how long each top level layer took to paint, and how long the walk
+ *    took, with the face's cached layers on and then, if it has any, off
+ *
+ * The graphics calls are plain loops over an 8 bit framebuffer, not
+ * neographics, so times are only good for comparing with each other.
+ *
+ *   cc -O2 -I- -I Utilities/face_bench/host -I rwatch/ui/layer \
+ *      -o face_bench Utilities/face_bench/face_bench.c rwatch/ui/layer/layer.c \
+ *      Watchfaces/nivz.c Watchfaces/simple.c -lm
+ *   ./face_bench
+ *
+ * -I- keeps layer.c from finding the real headers next to it.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include "librebble.h"
+
+#define FRAMES 2000
+#define MAX_TIMED 8
+
+void nivz_init(void);
+void nivz_deinit(void);
+void nivz_tick(struct tm *tick_time, TimeUnits tick_units);
+void simple_init(void);
+void simple_deinit(void);
+void simple_tick(struct tm *tick_time, TimeUnits tick_units);
+
+typedef struct face {
+    const char *name;
+    void (*init)(void);
+    void (*deinit)(void);
+    void (*tick)(struct tm *tick_time, TimeUnits tick_units);
+} face;
+
+static const face _faces[] = {
+    { "nivz", nivz_init, nivz_deinit, nivz_tick },
+    { "simple", simple_init, simple_deinit, simple_tick },
+};
+
+/* a top level layer, with its real update_proc and the time spent in it */
+typedef struct timed_layer {
+    Layer *layer;
+    LayerUpdateProc update_proc;
+    uint64_t ns;
+    uint32_t calls;
+} timed_layer;
+
+static uint8_t _fb[DISPLAY_ROWS * DISPLAY_ROW_BYTES];
+static Window *_window;
+static timed_layer _timed[MAX_TIMED];
+static uint8_t _timed_count;
+static uint64_t _painted;
+
+static uint64_t _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * What layer.c and the faces need from the rest of the OS
+ */
+
+void layer_test_log(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    printf("layer: ");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+}
+
+void *app_calloc(size_t count, size_t size) { return calloc(count, size); }
+void app_free(void *mem) { free(mem); }
+size_t app_heap_bytes_free(void) { return 64 * 1024; }
+TickType_t xTaskGetTickCount(void) { return 0; }
+uint8_t *display_get_buffer(void) { return _fb; }
+void window_scroll_rect(struct Window *window, const Layer *owner, GRect rect, int16_t dy) { }
+void app_event_loop(void) { }
+void tick_timer_service_subscribe(TimeUnits units, TickHandler handler) { }
+TextLayer *text_layer_create(GRect frame) { return calloc(1, sizeof(TextLayer)); }
+
+GRect grect_intersection(GRect a, GRect b)
+{
+    int16_t x0 = MAX(a.origin.x, b.origin.x), y0 = MAX(a.origin.y, b.origin.y);
+    int16_t x1 = MIN(a.origin.x + a.size.w, b.origin.x + b.size.w);
+    int16_t y1 = MIN(a.origin.y + a.size.h, b.origin.y + b.size.h);
+
+    if (x1 <= x0 || y1 <= y0)
+        return GRect(x0, y0, 0, 0);
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+GRect grect_union(GRect a, GRect b)
+{
+    if (a.size.w <= 0 || a.size.h <= 0)
+        return b;
+    if (b.size.w <= 0 || b.size.h <= 0)
+        return a;
+
+    int16_t x0 = MIN(a.origin.x, b.origin.x), y0 = MIN(a.origin.y, b.origin.y);
+    int16_t x1 = MAX(a.origin.x + a.size.w, b.origin.x + b.size.w);
+    int16_t y1 = MAX(a.origin.y + a.size.h, b.origin.y + b.size.h);
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+GPoint n_grect_center_point(const GRect *rect)
+{
+    return GPoint(rect->origin.x + rect->size.w / 2, rect->origin.y + rect->size.h / 2);
+}
+
+int32_t sin_lookup(int32_t angle)
+{
+    return (int32_t)(sin(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle)
+{
+    return (int32_t)(cos(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+/* the window stack has the one window in it */
+
+Window *window_create(void)
+{
+    Window *window = calloc(1, sizeof(Window));
+    window->frame = GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS);
+    window->root_layer = layer_create(window->frame);
+    window->root_layer->window = window;
+    return window;
+}
+
+void window_destroy(Window *window)
+{
+    if (_window == window)
+    {
+        if (window->handlers.unload)
+            window->handlers.unload(window);
+        _window = NULL;
+    }
+    layer_destroy(window->root_layer);
+    free(window->root_layer);
+    free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers)
+{
+    window->handlers = handlers;
+}
+
+void window_stack_push(Window *window, bool animated)
+{
+    _window = window;
+    if (window->handlers.load)
+        window->handlers.load(window);
+    window_dirty(true);
+}
+
+Layer *window_get_root_layer(Window *window)
+{
+    return window->root_layer;
+}
+
+void window_dirty(bool dirty)
+{
+    if (_window && dirty)
+        window_dirty_rect(_window, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+}
+
+void window_dirty_rect(struct Window *window, GRect rect)
+{
+    rect = grect_intersection(rect, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    if (rect.size.w <= 0 || rect.size.h <= 0)
+        return;
+
+    window->damage = grect_union(window->damage, rect);
+    window->is_render_scheduled = true;
+}
+
+/*
+ * Graphics. Everything is clipped to the context offset, and what lands
+ * on screen is counted
+ */
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) { ctx->fill_color = color; }
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) { ctx->stroke_color = color; }
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t width) { ctx->stroke_width = width; }
+
+static GRect _clip(GContext *ctx)
+{
+    return grect_intersection(ctx->offset, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+}
+
+/* a run of pixels on one row, in layer coordinates */
+static void _span(GContext *ctx, GRect clip, int16_t x0, int16_t x1, int16_t y, GColor color)
+{
+    x0 += ctx->offset.origin.x;
+    x1 += ctx->offset.origin.x;
+    y += ctx->offset.origin.y;
+
+    if (y < clip.origin.y || y >= clip.origin.y + clip.size.h)
+        return;
+    x0 = MAX(x0, clip.origin.x);
+    x1 = MIN(x1, clip.origin.x + clip.size.w - 1);
+    if (x1 < x0)
+        return;
+
+    memset(_fb + y * DISPLAY_ROW_BYTES + x0, color.argb, x1 - x0 + 1);
+    _painted += x1 - x0 + 1;
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t radius, GCornerMask corners)
+{
+    GRect clip = _clip(ctx);
+
+    for (int16_t y = rect.origin.y; y < rect.origin.y + rect.size.h; y++)
+        _span(ctx, clip, rect.origin.x, rect.origin.x + rect.size.w - 1, y, ctx->fill_color);
+}
+
+void graphics_fill_circle(GContext *ctx, GPoint center, uint16_t radius)
+{
+    GRect clip = _clip(ctx);
+
+    for (int16_t dy = -radius; dy <= radius; dy++)
+    {
+        int16_t dx = (int16_t)sqrt(radius * radius - dy * dy);
+        _span(ctx, clip, center.x - dx, center.x + dx, center.y + dy, ctx->fill_color);
+    }
+}
+
+/* every pixel in the box within half the stroke width of the shape */
+static void _stroke(GContext *ctx, GRect box, float (*distance)(float x, float y, const void *shape), const void *shape)
+{
+    GRect clip = _clip(ctx);
+    float half = MAX(ctx->stroke_width, 1) / 2.0f;
+
+    for (int16_t y = box.origin.y; y < box.origin.y + box.size.h; y++)
+        for (int16_t x = box.origin.x; x < box.origin.x + box.size.w; x++)
+            if (distance(x, y, shape) <= half)
+                _span(ctx, clip, x, x, y, ctx->stroke_color);
+}
+
+typedef struct { GPoint center; uint16_t radius; } circle;
+typedef struct { GPoint p0, p1; } line;
+
+static float _circle_distance(float x, float y, const void *shape)
+{
+    const circle *c = shape;
+    return fabsf(hypotf(x - c->center.x, y - c->center.y) - c->radius);
+}
+
+static float _line_distance(float x, float y, const void *shape)
+{
+    const line *l = shape;
+    float dx = l->p1.x - l->p0.x, dy = l->p1.y - l->p0.y;
+    float len = dx * dx + dy * dy;
+    float t = len ? ((x - l->p0.x) * dx + (y - l->p0.y) * dy) / len : 0;
+
+    t = t < 0 ? 0 : t > 1 ? 1 : t;
+    return hypotf(x - (l->p0.x + t * dx), y - (l->p0.y + t * dy));
+}
+
+void graphics_draw_circle(GContext *ctx, GPoint center, uint16_t radius)
+{
+    circle c = { center, radius };
+    int16_t r = radius + ctx->stroke_width;
+    _stroke(ctx, GRect(center.x - r, center.y - r, 2 * r + 1, 2 * r + 1), _circle_distance, &c);
+}
+
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1)
+{
+    line l = { p0, p1 };
+    int16_t w = ctx->stroke_width;
+    _stroke(ctx, GRect(MIN(p0.x, p1.x) - w, MIN(p0.y, p1.y) - w,
+                       abs(p1.x - p0.x) + 2 * w + 1, abs(p1.y - p0.y) + 2 * w + 1), _line_distance, &l);
+}
+
+/*
+ * The bench
+ */
+
+static void _timed_update_proc(Layer *layer, GContext *context)
+{
+    for (uint8_t i = 0; i < _timed_count; i++)
+    {
+        if (_timed[i].layer != layer)
+            continue;
+
+        uint64_t start = _now_ns();
+        _timed[i].update_proc(layer, context);
+        _timed[i].ns += _now_ns() - start;
+        _timed[i].calls++;
+        return;
+    }
+}
+
+/* time the face's own layers, the ones on the window's root */
+static void _time_layers(void)
+{
+    _timed_count = 0;
+    for (Layer *l = _window->root_layer->child; l && _timed_count < MAX_TIMED; l = l->sibling)
+    {
+        if (!l->update_proc)
+            continue;
+        _timed[_timed_count++] = (timed_layer) { l, l->update_proc };
+        l->update_proc = _timed_update_proc;
+    }
+}
+
+typedef struct frame_stats {
+    uint64_t damaged;
+    uint64_t painted;
+    uint64_t rows;
+    uint64_t walk_ns;
+} frame_stats;
+
+/* as window_draw() */
+static void _draw_frame(frame_stats *stats)
+{
+    GRect screen = GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS);
+    GRect damage = _window->damage;
+
+    _window->damage = GRect(0, 0, 0, 0);
+    _window->is_render_scheduled = false;
+    if (damage.size.w <= 0 || damage.size.h <= 0)
+        return;
+
+    damage = layer_grow_damage(_window->root_layer, _window->frame.origin, damage);
+    damage = grect_intersection(damage, screen);
+
+    GContext context = { .offset = _window->frame, .fill_color = GColorWhite };
+    uint64_t painted = _painted;
+
+    graphics_fill_rect(&context, damage, 0, GCornerNone);
+    uint64_t start = _now_ns();
+    layer_draw_damage(_window->root_layer, &context, damage);
+
+    stats->walk_ns += _now_ns() - start;
+    stats->painted += _painted - painted;
+    stats->damaged += damage.size.w * damage.size.h;
+    stats->rows += damage.size.h;
+}
+
+/* false if the face has no cached layers to turn off */
+static bool _run(const face *f, bool cached)
+{
+    frame_stats stats = { 0 };
+    struct tm tm = { .tm_hour = 10, .tm_min = 8 };
+    uint8_t n_cached = 0;
+
+    f->init();
+    _time_layers();
+    for (Layer *l = _window->root_layer->child; l; l = l->sibling)
+    {
+        n_cached += l->cached;
+        if (!cached)
+            layer_set_cached(l, false);
+    }
+
+    /* the first frame paints everything, and fills the caches */
+    f->tick(&tm, SECOND_UNIT);
+    _draw_frame(&stats);
+    stats = (frame_stats) { 0 };
+    for (uint8_t i = 0; i < _timed_count; i++)
+        _timed[i].ns = _timed[i].calls = 0;
+
+    for (uint32_t i = 0; i < FRAMES; i++)
+    {
+        if (++tm.tm_sec == 60)
+        {
+            tm.tm_sec = 0;
+            tm.tm_min = (tm.tm_min + 1) % 60;
+        }
+        f->tick(&tm, SECOND_UNIT);
+        _draw_frame(&stats);
+    }
+
+    printf("%s, %s: %llu px damaged, %llu px painted, %llu rows, %llu bytes sent, walk %.1fus per frame\n",
+           f->name, !n_cached ? "no cached layers" : cached ? "cached" : "caches off",
+           (unsigned long long)(stats.damaged / FRAMES), (unsigned long long)(stats.painted / FRAMES),
+           (unsigned long long)(stats.rows / FRAMES),
+           (unsigned long long)(stats.rows * DISPLAY_ROW_BYTES / FRAMES), stats.walk_ns / 1000.0 / FRAMES);
+    uint64_t rest_ns = stats.walk_ns;
+    for (uint8_t i = 0; i < _timed_count; i++)
+    {
+        printf("  layer %u%s: drawn %u times, %.1fus each\n", i, _timed[i].layer->cached ? " (cached)" : "",
+               _timed[i].calls, _timed[i].calls ? _timed[i].ns / 1000.0 / _timed[i].calls : 0.0);
+        rest_ns -= _timed[i].ns;
+    }
+    /* with caches on, this is mostly the blits */
+    printf("  rest of the walk: %.1fus per frame\n", rest_ns / 1000.0 / FRAMES);
+
+    f->deinit();
+    return n_cached > 0;
+}
+
+int main(void)
+{
+    for (uint32_t i = 0; i < sizeof(_faces) / sizeof(_faces[0]); i++)
+    {
+        if (_run(&_faces[i], true))
+            _run(&_faces[i], false);
+    }
+    return 0;
+}
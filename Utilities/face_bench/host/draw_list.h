@@ -0,0 +1,21 @@
+#pragma once
+/* draw_list.h
+ * The faces in the bench don't record, so a draw list is never made
+ * RebbleOS
+ */
+#include "librebble.h"
+
+typedef struct DrawList {
+    GRect rect;
+    uint16_t len;
+    bool complete;
+    bool external;
+} DrawList;
+
+static inline DrawList *draw_list_create(void) { return NULL; }
+static inline void draw_list_destroy(DrawList *list) { }
+static inline bool draw_list_equal(const DrawList *a, const DrawList *b) { return a == b; }
+static inline void draw_list_record_begin(DrawList *list) { }
+static inline void draw_list_record_end(void) { }
+static inline void draw_list_replay(DrawList *list, GContext *context) { }
+static inline void draw_list_log(DrawList *list) { }
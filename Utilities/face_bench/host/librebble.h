@@ -0,0 +1,120 @@
+#pragma once
+/* librebble.h
+ * Just enough of libRebbleOS for rwatch/ui/layer/layer.c and the faces in
+ * Watchfaces/ to build on the host. face_bench.c has the functions behind
+ * it, and the graphics calls count what they paint
+ * RebbleOS
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <time.h>
+
+#define DISPLAY_ROWS 168
+#define DISPLAY_COLS 144
+#define DISPLAY_ROW_BYTES DISPLAY_COLS
+
+typedef uint32_t TickType_t;
+#define portTICK_PERIOD_MS 1
+
+/* named the way neographics does them, macros and all */
+typedef struct n_GPoint { int16_t x, y; } n_GPoint;
+typedef struct n_GSize { int16_t w, h; } n_GSize;
+typedef struct n_GRect { n_GPoint origin; n_GSize size; } n_GRect;
+typedef union n_GColor { uint8_t argb; } n_GColor;
+typedef struct n_GContext {
+    n_GRect offset;
+    n_GColor fill_color;
+    n_GColor stroke_color;
+    uint8_t stroke_width;
+} n_GContext;
+
+#define n_GPoint(x_, y_) ((n_GPoint) { (x_), (y_) })
+#define n_GRect(x_, y_, w_, h_) ((n_GRect) { { (x_), (y_) }, { (w_), (h_) } })
+#define GPoint n_GPoint
+#define GSize n_GSize
+#define GRect n_GRect
+#define GColor n_GColor
+#define GContext n_GContext
+#define POINT_EQ(a, b) ((a).x == (b).x && (a).y == (b).y)
+#define SIZE_EQ(a, b) ((a).w == (b).w && (a).h == (b).h)
+#define RECT_EQ(a, b) (POINT_EQ((a).origin, (b).origin) && SIZE_EQ((a).size, (b).size))
+#ifndef MIN
+#  define MIN(a, b) ((a) < (b) ? (a) : (b))
+#  define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+#define GColorFromRGB(r_, g_, b_) ((GColor) { .argb = 0xC0 | (((r_) >> 6) << 4) | (((g_) >> 6) << 2) | ((b_) >> 6) })
+#define GColorBlack ((GColor) { .argb = 0xC0 })
+#define GColorWhite ((GColor) { .argb = 0xFF })
+#define GColorRed ((GColor) { .argb = 0xF0 })
+typedef enum { GCornerNone = 0 } GCornerMask;
+
+#define TRIG_MAX_RATIO 0xffff
+#define TRIG_MAX_ANGLE 0x10000
+int32_t sin_lookup(int32_t angle);
+int32_t cos_lookup(int32_t angle);
+
+void layer_test_log(const char *fmt, ...);
+#define LOG_ERROR(fmt_, ...) layer_test_log(fmt_, ##__VA_ARGS__)
+#define LOG_INFO(fmt_, ...)
+#define LOG_DEBUG(fmt_, ...)
+#define APP_LOG(module_, level_, fmt_, ...)
+
+#include "layer.h"
+
+typedef struct { void *unused; } TextLayer;
+typedef enum { SECOND_UNIT = 1, MINUTE_UNIT = 2 } TimeUnits;
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+typedef struct Window Window;
+typedef void (*WindowHandler)(Window *window);
+typedef struct WindowHandlers {
+    WindowHandler load;
+    WindowHandler appear;
+    WindowHandler disappear;
+    WindowHandler unload;
+} WindowHandlers;
+
+struct Window {
+    GRect frame;
+    bool is_overlay;
+    bool is_record_pending;
+    bool is_render_scheduled;
+    Layer *root_layer;
+    WindowHandlers handlers;
+    GRect damage;
+};
+
+void *app_calloc(size_t count, size_t size);
+void app_free(void *mem);
+size_t app_heap_bytes_free(void);
+TickType_t xTaskGetTickCount(void);
+uint8_t *display_get_buffer(void);
+GRect grect_intersection(GRect a, GRect b);
+GRect grect_union(GRect a, GRect b);
+GPoint n_grect_center_point(const GRect *rect);
+void window_dirty(bool dirty);
+void window_dirty_rect(struct Window *window, GRect rect);
+void window_scroll_rect(struct Window *window, const Layer *owner, GRect rect, int16_t dy);
+
+Window *window_create(void);
+void window_destroy(Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_stack_push(Window *window, bool animated);
+Layer *window_get_root_layer(Window *window);
+void app_event_loop(void);
+TextLayer *text_layer_create(GRect frame);
+void tick_timer_service_subscribe(TimeUnits units, TickHandler handler);
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_color(GContext *ctx, GColor color);
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t width);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t radius, GCornerMask corners);
+void graphics_fill_circle(GContext *ctx, GPoint center, uint16_t radius);
+void graphics_draw_circle(GContext *ctx, GPoint center, uint16_t radius);
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1);
@@ -0,0 +1,111 @@
+/* fb_bench.c
+ * Host benchmark for the 8 bit framebuffer fills and blits in rwatch/graphics/fb8.c
+ * RebbleOS
+ *
+ * Compares them against a pixel at a time loop, which is roughly what
+ * drawing through ngfx costs, over sizes the UI draws a lot of.
+ * Numbers are for the host CPU, so only the ratios mean much for the watch.
+ *
+ *   cc -O2 -I rwatch/graphics -o fb_bench Utilities/fb_bench.c rwatch/graphics/fb8.c
+ *   ./fb_bench
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "fb8.h"
+
+#define FB_COLS 180
+#define FB_ROWS 180
+#define BENCH_PIXELS (50 * 1000 * 1000)
+
+static uint8_t _fb[FB_ROWS * FB_COLS];
+static uint8_t _bitmap[FB_ROWS * FB_COLS];
+
+typedef struct bench_size {
+    const char *name;
+    uint16_t w, h;
+} bench_size;
+
+static const bench_size _sizes[] = {
+    { "snowy screen", 144, 168 },
+    { "chalk screen", 180, 180 },
+    { "menu row",     144, 44 },
+    { "status bar",   144, 16 },
+    { "icon",         25, 25 },
+};
+
+/* what a per pixel draw looks like: clip, then store */
+__attribute__((noinline))
+static void _set_pixel(uint8_t *fb, int16_t x, int16_t y, uint8_t color)
+{
+    if (x < 0 || y < 0 || x >= FB_COLS || y >= FB_ROWS)
+        return;
+    fb[y * FB_COLS + x] = color;
+}
+
+static void _pixel_fill(uint16_t w, uint16_t h, uint8_t color)
+{
+    for (int16_t y = 0; y < h; y++)
+        for (int16_t x = 0; x < w; x++)
+            _set_pixel(_fb, x, y, color);
+}
+
+static void _pixel_blit(uint16_t w, uint16_t h, uint8_t color)
+{
+    for (int16_t y = 0; y < h; y++)
+        for (int16_t x = 0; x < w; x++)
+        {
+            uint8_t px = _bitmap[y * FB_COLS + x];
+            if (px & 0xC0)
+                _set_pixel(_fb, x, y, px);
+        }
+}
+
+static void _fb8_fill(uint16_t w, uint16_t h, uint8_t color)
+{
+    fb8_fill(_fb, FB_COLS, w, h, color);
+}
+
+static void _fb8_blit(uint16_t w, uint16_t h, uint8_t color)
+{
+    if (fb8_opaque(_bitmap, FB_COLS, w, h))
+        fb8_blit(_fb, FB_COLS, _bitmap, FB_COLS, w, h);
+}
+
+static double _now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double _mpix_per_sec(void (*fn)(uint16_t, uint16_t, uint8_t), uint16_t w, uint16_t h)
+{
+    uint32_t runs = BENCH_PIXELS / (w * h) + 1;
+    double start = _now();
+
+    for (uint32_t i = 0; i < runs; i++)
+        fn(w, h, 0xC0 | (i & 0x3F));
+
+    return (double)runs * w * h / (_now() - start) / 1e6;
+}
+
+int main(void)
+{
+    memset(_bitmap, 0xFF, sizeof(_bitmap));
+
+    printf("%-14s %9s %14s %14s %14s %14s\n", "", "size",
+           "pixel fill", "fb8_fill", "pixel blit", "fb8_blit");
+    for (unsigned i = 0; i < sizeof(_sizes) / sizeof(_sizes[0]); i++)
+    {
+        const bench_size *s = &_sizes[i];
+        printf("%-14s %4dx%-4d %9.1f Mpx/s %9.1f Mpx/s %9.1f Mpx/s %9.1f Mpx/s\n", s->name, s->w, s->h,
+               _mpix_per_sec(_pixel_fill, s->w, s->h), _mpix_per_sec(_fb8_fill, s->w, s->h),
+               _mpix_per_sec(_pixel_blit, s->w, s->h), _mpix_per_sec(_fb8_blit, s->w, s->h));
+    }
+
+    /* keep the compiler from deciding none of it mattered */
+    return _fb[FB_COLS + 2] == 0x42;
+}
@@ -0,0 +1,64 @@
+#pragma once
+/* librebble.h
+ * Just enough of libRebbleOS for rwatch/ui/layer/layer.c to build on the
+ * host. layer_walk_test.c has the few functions behind it
+ * RebbleOS
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+
+#define DISPLAY_ROWS 168
+#define DISPLAY_COLS 144
+#define DISPLAY_ROW_BYTES DISPLAY_COLS
+
+typedef uint32_t TickType_t;
+#define portTICK_PERIOD_MS 1
+
+/* named the way neographics does them, macros and all */
+typedef struct n_GPoint { int16_t x, y; } n_GPoint;
+typedef struct n_GSize { int16_t w, h; } n_GSize;
+typedef struct n_GRect { n_GPoint origin; n_GSize size; } n_GRect;
+typedef struct n_GContext { n_GRect offset; } n_GContext;
+
+#define n_GPoint(x_, y_) ((n_GPoint) { (x_), (y_) })
+#define n_GRect(x_, y_, w_, h_) ((n_GRect) { { (x_), (y_) }, { (w_), (h_) } })
+#define GPoint n_GPoint
+#define GSize n_GSize
+#define GRect n_GRect
+#define GContext n_GContext
+#define POINT_EQ(a, b) ((a).x == (b).x && (a).y == (b).y)
+#define SIZE_EQ(a, b) ((a).w == (b).w && (a).h == (b).h)
+#define RECT_EQ(a, b) (POINT_EQ((a).origin, (b).origin) && SIZE_EQ((a).size, (b).size))
+#ifndef MIN
+#  define MIN(a, b) ((a) < (b) ? (a) : (b))
+#  define MAX(a, b) ((a) > (b) ? (a) : (b))
+#endif
+
+void layer_test_log(const char *fmt, ...);
+#define LOG_ERROR(fmt_, ...) layer_test_log(fmt_, ##__VA_ARGS__)
+#define LOG_INFO(fmt_, ...)
+#define LOG_DEBUG(fmt_, ...)
+
+#include "layer.h"
+
+struct Window {
+    GRect frame;
+    bool is_overlay;
+    bool is_record_pending;
+    bool is_render_scheduled;
+};
+
+void *app_calloc(size_t count, size_t size);
+void app_free(void *mem);
+size_t app_heap_bytes_free(void);
+TickType_t xTaskGetTickCount(void);
+uint8_t *display_get_buffer(void);
+GRect grect_intersection(GRect a, GRect b);
+GRect grect_union(GRect a, GRect b);
+void window_dirty(bool dirty);
+void window_dirty_rect(struct Window *window, GRect rect);
+void window_scroll_rect(struct Window *window, const Layer *owner, GRect rect, int16_t dy);
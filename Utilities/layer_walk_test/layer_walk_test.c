@@ -0,0 +1,288 @@
+/* layer_walk_test.c
+ * Host test for the layer tree walk in rwatch/ui/layer/layer.c
+ * RebbleOS
+ *
+ * layer.c is built as it is, against the stand-in headers in host/.
+ * Checks that:
+ *  - layers are drawn depth first, parents before children, and hidden
+ *    layers take their children with them
+ *  - only layers touching the damage are drawn, and a layer that clips
+ *    and is outside the damage skips its children
+ *  - a layer with a damage proc is drawn where that says it paints, even
+ *    with its frame off screen
+ *  - coming back up out of a subtree, the next sibling is drawn at the
+ *    right offset and with its own clip, not the subtree's
+ *  - the walk uses the same stack for one layer, thousands of siblings
+ *    or a thousand layers nested, and draws every one of them
+ *
+ *   cc -O2 -I- -I Utilities/layer_walk_test/host -I rwatch/ui/layer \
+ *      -o layer_walk_test Utilities/layer_walk_test/layer_walk_test.c rwatch/ui/layer/layer.c
+ *   ./layer_walk_test
+ *
+ * -I- keeps layer.c from finding the real headers next to it.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "librebble.h"
+
+#define DEEP_NESTING 1000
+#define WIDE_SIBLINGS 5000
+#define ROW_HEIGHT 10
+#define ROWS 200
+
+static uint8_t _fb[DISPLAY_ROWS * DISPLAY_ROW_BYTES];
+
+static int _drawn[64];
+static GPoint _drawn_at[64];
+static uint32_t _draw_count;
+static uintptr_t _stack_low;
+static int _failed;
+
+/*
+ * What layer.c needs from the rest of the OS
+ */
+
+void layer_test_log(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    printf("layer: ");
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+}
+
+void *app_calloc(size_t count, size_t size) { return calloc(count, size); }
+void app_free(void *mem) { free(mem); }
+size_t app_heap_bytes_free(void) { return 64 * 1024; }
+TickType_t xTaskGetTickCount(void) { return 0; }
+uint8_t *display_get_buffer(void) { return _fb; }
+void window_dirty(bool dirty) { }
+void window_dirty_rect(struct Window *window, GRect rect) { }
+void window_scroll_rect(struct Window *window, const Layer *owner, GRect rect, int16_t dy) { }
+
+GRect grect_intersection(GRect a, GRect b)
+{
+    int16_t x0 = MAX(a.origin.x, b.origin.x), y0 = MAX(a.origin.y, b.origin.y);
+    int16_t x1 = MIN(a.origin.x + a.size.w, b.origin.x + b.size.w);
+    int16_t y1 = MIN(a.origin.y + a.size.h, b.origin.y + b.size.h);
+
+    if (x1 <= x0 || y1 <= y0)
+        return GRect(x0, y0, 0, 0);
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+GRect grect_union(GRect a, GRect b)
+{
+    int16_t x0 = MIN(a.origin.x, b.origin.x), y0 = MIN(a.origin.y, b.origin.y);
+    int16_t x1 = MAX(a.origin.x + a.size.w, b.origin.x + b.size.w);
+    int16_t y1 = MAX(a.origin.y + a.size.h, b.origin.y + b.size.h);
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+/*
+ * The test
+ */
+
+#define CHECK(cond_, ...) do { if (!(cond_)) { printf("FAIL: " __VA_ARGS__); printf("\n"); _failed++; } } while (0)
+
+/* each layer's data is its id */
+static void _update_proc(Layer *layer, GContext *context)
+{
+    uintptr_t here = (uintptr_t)__builtin_frame_address(0);
+    if (!_stack_low || here < _stack_low)
+        _stack_low = here;
+
+    if (_draw_count < sizeof(_drawn) / sizeof(_drawn[0]))
+    {
+        _drawn[_draw_count] = *(int *)layer_get_data(layer);
+        _drawn_at[_draw_count] = context->offset.origin;
+    }
+    _draw_count++;
+}
+
+static Layer *_layer(Layer *parent, int id, GRect frame)
+{
+    Layer *layer = layer_create_with_data(frame, sizeof(int));
+    *(int *)layer_get_data(layer) = id;
+    layer_set_update_proc(layer, _update_proc);
+    if (parent)
+        layer_add_child(parent, layer);
+    return layer;
+}
+
+static void _destroy(Layer *root)
+{
+    layer_remove_child_layers(root);
+    free(root->callback_data);
+    layer_destroy(root);
+    free(root);
+}
+
+/* draw, and how far down the stack the update procs ran */
+static uintptr_t _draw(Layer *root, GRect damage)
+{
+    GContext context = { GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS) };
+
+    _draw_count = 0;
+    _stack_low = 0;
+    layer_draw_damage(root, &context, damage);
+
+    CHECK(RECT_EQ(context.offset, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS)), "context offset not put back");
+    return _stack_low;
+}
+
+static void _test_order(void)
+{
+    static const int want[] = { 0, 1, 3, 4, 2, 5, 7 };
+    Layer *root = _layer(NULL, 0, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    Layer *a = _layer(root, 1, GRect(0, 0, 50, 50));
+    _layer(root, 2, GRect(0, 50, 50, 50));
+    Layer *b = _layer(root, 5, GRect(50, 0, 50, 50));
+    Layer *c = _layer(a, 3, GRect(0, 0, 10, 10));
+    _layer(c, 4, GRect(0, 0, 10, 10));
+    Layer *hidden = _layer(b, 6, GRect(0, 0, 10, 10));
+    _layer(hidden, 8, GRect(0, 0, 10, 10));
+    _layer(b, 7, GRect(10, 0, 10, 10));
+    layer_set_hidden(hidden, true);
+
+    _draw(root, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+
+    uint32_t n = sizeof(want) / sizeof(want[0]);
+    CHECK(_draw_count == n, "order: drew %u layers, want %u", _draw_count, n);
+    for (uint32_t i = 0; i < n && i < _draw_count; i++)
+        CHECK(_drawn[i] == want[i], "order: layer %u drawn was %d, want %d", i, _drawn[i], want[i]);
+
+    printf("order: %u layers in pre-order, hidden subtree skipped\n", _draw_count);
+    _destroy(root);
+}
+
+static void _test_culling(void)
+{
+    /* a long list, like a menu, mostly off screen */
+    Layer *root = _layer(NULL, 0, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    root->update_proc = NULL;
+    for (int i = 0; i < ROWS; i++)
+        _layer(root, i, GRect(0, i * ROW_HEIGHT, DISPLAY_COLS, ROW_HEIGHT));
+
+    uint32_t on_screen = (DISPLAY_ROWS + ROW_HEIGHT - 1) / ROW_HEIGHT;
+    _draw(root, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    CHECK(_draw_count == on_screen, "cull: full screen drew %u of %d rows, want %u", _draw_count, ROWS, on_screen);
+    uint32_t full = _draw_count;
+
+    _draw(root, GRect(0, 4 * ROW_HEIGHT, DISPLAY_COLS, ROW_HEIGHT));
+    CHECK(_draw_count == 1 && _drawn[0] == 4, "cull: one row of damage drew %u rows", _draw_count);
+    uint32_t one_row = _draw_count;
+
+    /* a clipping parent outside the damage takes its children with it */
+    Layer *clip = _layer(root, 1000, GRect(0, 100, 50, 20));
+    _layer(clip, 1001, GRect(0, -100, 10, 10));
+    layer_set_clips(clip, true);
+    _draw(root, GRect(0, 0, DISPLAY_COLS, 10));
+    CHECK(_draw_count == 1 && _drawn[0] == 0, "clip: drew %u, want only row 0", _draw_count);
+
+    layer_set_clips(clip, false);
+    _draw(root, GRect(0, 0, DISPLAY_COLS, 10));
+    CHECK(_draw_count == 2 && _drawn[1] == 1001, "clip: without clips drew %u, want row 0 and the child", _draw_count);
+
+    printf("cull: %d rows, %u drawn for the full screen, %u for one row of damage\n", ROWS, full, one_row);
+    _destroy(root);
+}
+
+static void _test_climb(void)
+{
+    Layer *root = _layer(NULL, 0, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    Layer *a = _layer(root, 1, GRect(10, 10, 50, 50));
+    Layer *b = _layer(a, 2, GRect(5, 5, 20, 20));
+    _layer(b, 3, GRect(1, 1, 5, 5));
+    _layer(root, 4, GRect(70, 80, 20, 20));
+    layer_set_clips(a, true);
+    layer_set_clips(b, true);
+
+    /* 4 is outside the clips of 1 and 2, but it isn't under them */
+    _draw(root, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    CHECK(_draw_count == 5 && _drawn[4] == 4, "climb: drew %u, want all 5", _draw_count);
+    CHECK(POINT_EQ(_drawn_at[3], GPoint(16, 16)), "climb: 3 drawn at %d,%d", _drawn_at[3].x, _drawn_at[3].y);
+    CHECK(POINT_EQ(_drawn_at[4], GPoint(70, 80)), "climb: 4 drawn at %d,%d", _drawn_at[4].x, _drawn_at[4].y);
+
+    printf("climb: offset and clip put back after a subtree\n");
+    _destroy(root);
+}
+
+/* paints its frame moved down a screen, whole, as a scrolled menu paints its cells */
+static GRect _scrolled_damage_proc(const Layer *layer, GRect damage)
+{
+    GRect content = GRect(0, DISPLAY_ROWS, layer->frame.size.w, layer->frame.size.h);
+    GRect hit = grect_intersection(content, damage);
+    return hit.size.w > 0 && hit.size.h > 0 ? content : hit;
+}
+
+static void _test_damage_proc(void)
+{
+    Layer *root = _layer(NULL, 0, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    root->update_proc = NULL;
+    Layer *menu = _layer(root, 1, GRect(0, -DISPLAY_ROWS, DISPLAY_COLS, DISPLAY_ROWS));
+    layer_set_damage_proc(menu, _scrolled_damage_proc);
+    _layer(root, 2, GRect(0, 0, DISPLAY_COLS, 20));
+
+    /* its frame is off screen, what it paints isn't */
+    _draw(root, GRect(0, 100, DISPLAY_COLS, 10));
+    CHECK(_draw_count == 1 && _drawn[0] == 1, "damage proc: drew %u, want the layer whose frame is off screen", _draw_count);
+
+    /* and what it paints grows the damage, not its frame */
+    GRect grown = layer_grow_damage(root, GPoint(0, 0), GRect(0, 100, DISPLAY_COLS, 10));
+    CHECK(RECT_EQ(grown, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS)), "damage proc: grown to %d,%d %dx%d",
+          grown.origin.x, grown.origin.y, grown.size.w, grown.size.h);
+    CHECK(RECT_EQ(menu->frame, GRect(0, -DISPLAY_ROWS, DISPLAY_COLS, DISPLAY_ROWS)), "damage proc: frame changed");
+
+    printf("damage proc: layer drawn where it paints, outside its frame\n");
+    _destroy(root);
+}
+
+static void _test_stack(void)
+{
+    Layer *root = _layer(NULL, 0, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    uintptr_t one = _draw(root, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+
+    for (int i = 0; i < WIDE_SIBLINGS; i++)
+        _layer(root, i, GRect(0, 0, 1, 1));
+    uintptr_t wide = _draw(root, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    CHECK(_draw_count == WIDE_SIBLINGS + 1, "stack: drew %u of %d siblings", _draw_count, WIDE_SIBLINGS + 1);
+    _destroy(root);
+
+    /* each one a sibling after it too, so the walk has to come back up */
+    root = _layer(NULL, 0, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    Layer *l = root;
+    for (int i = 1; i <= DEEP_NESTING; i++)
+    {
+        Layer *child = _layer(l, i, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+        _layer(l, DEEP_NESTING + i, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+        l = child;
+    }
+    uintptr_t deep = _draw(root, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    CHECK(_draw_count == 2 * DEEP_NESTING + 1, "stack: drew %u nested layers, want %d", _draw_count, 2 * DEEP_NESTING + 1);
+    GRect grown = layer_grow_damage(root, GPoint(0, 0), GRect(0, 0, 1, 1));
+    CHECK(RECT_EQ(grown, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS)), "stack: nested damage grew to %dx%d",
+          grown.size.w, grown.size.h);
+    _destroy(root);
+
+    CHECK(one == wide && one == deep, "stack: update procs ran %ld bytes deeper with %d siblings, %ld nested %d deep",
+          (long)(one - wide), WIDE_SIBLINGS, (long)(one - deep), DEEP_NESTING);
+    printf("stack: same depth for 1 layer, %d siblings and %d nested\n", WIDE_SIBLINGS, DEEP_NESTING);
+}
+
+int main(void)
+{
+    _test_order();
+    _test_culling();
+    _test_climb();
+    _test_damage_proc();
+    _test_stack();
+
+    printf(_failed ? "%d failed\n" : "ok\n", _failed);
+    return _failed != 0;
+}
@@ -0,0 +1,166 @@
+#!/usr/bin/env python
+
+"""
+Turns the binary logs a LOG_TOKENIZED RebbleOS build sends back into text.
+RebbleOS
+
+Give it the dictionary the build left next to the elf and the watch's
+debug UART (a capture file, a serial port, or - for stdin):
+
+    make snowy_qemu | Utilities/logdecode.py build/snowy/tintin_fw.logdict
+
+Anything that isn't a log frame (app logs, panics, plain printf) is passed
+through as it is. --stats says how many bytes each line took on the wire
+against what it would have been as text.
+"""
+
+import argparse
+import json
+import re
+import sys
+
+# must match rcore/log.c
+FRAME_SYNC = 0x1e
+LEVELS = "EWIDV"
+TICK_HZ = 1000
+
+parser = argparse.ArgumentParser(description = "Decode RebbleOS tokenized logs.")
+parser.add_argument("-s", "--stats", action = "store_true", help = "report UART bytes per line at the end")
+parser.add_argument("dict", help = "tintin_fw.logdict from the build")
+parser.add_argument("input", nargs = "?", default = "-", help = "UART capture or serial port, - for stdin")
+args = parser.parse_args()
+
+with open(args.dict, "r") as f:
+    tokens = dict((int(k), v) for k, v in json.load(f).items())
+
+SPEC = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+class Frame:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        self.pos += 1
+        return self.data[self.pos - 1]
+
+    def varint(self):
+        v, shift = 0, 0
+        while True:
+            b = self.byte()
+            v |= (b & 0x7f) << shift
+            shift += 7
+            if b < 0x80:
+                return v
+
+    def number(self):
+        v = self.varint()
+        return (v >> 1) ^ -(v & 1)
+
+    def string(self):
+        n = self.byte()
+        self.pos += n
+        return self.data[self.pos - n:self.pos].decode("utf-8", "replace")
+
+    def done(self):
+        return self.pos >= len(self.data)
+
+def format_c(fmt, frame):
+    """ printf, as far as the watch's minilib does it, reading arguments off the frame """
+    def conversion(m):
+        flags, width, precision, length, conv = m.groups()
+        if conv == "%":
+            return "%"
+        if frame.done():
+            return "<?>"
+        if conv == "s":
+            value = frame.string()
+        else:
+            value = frame.number()
+            if conv in "ouxXp":
+                value &= (1 << 64) - 1 if length == "ll" else (1 << 32) - 1
+        if conv == "p":
+            return "0x%x" % value
+        if conv == "c":
+            return chr(value & 0xff)
+        spec = "%" + flags + width + ("." + precision if precision else "") + ("d" if conv in "iu" else conv)
+        return spec % value
+    return SPEC.sub(conversion, fmt)
+
+def pad(s, n):
+    """ like _log_pad_string: cut from the left, pad on the right """
+    return s[-n:] if len(s) > n else s.ljust(n)
+
+def decode(body):
+    """ One frame, without the sync, length or checksum. Returns the line
+        to print, and what the watch would have printed without tokens """
+    frame = Frame(body)
+    level = frame.byte()
+    thread = frame.byte() - 1
+    ticks = frame.varint()
+    token = frame.varint()
+
+    if token not in tokens:
+        return "%6d.%03d [?] unknown token %d, is the dictionary for this build?" % \
+            (ticks // TICK_HZ, ticks % TICK_HZ, token), ""
+
+    layer, module, filename, line, fmt = tokens[token]
+    text = "[%d][%d][%s][%s][%s][%s:%s] %s" % (level >> 7, thread, LEVELS[level & 0x7f] if (level & 0x7f) < len(LEVELS) else "?",
+                                             pad(layer, 6), pad(module, 6), pad(filename, 13),
+                                             str(line).ljust(5), format_c(fmt, frame))
+    return "%6d.%03d %s" % (ticks // TICK_HZ, ticks % TICK_HZ, text), text
+
+def main():
+    src = sys.stdin.buffer if args.input == "-" else open(args.input, "rb", buffering = 0)
+    read = getattr(src, "read1", src.read)
+    out = sys.stdout
+    buf = bytearray()
+    frames = wire_bytes = text_bytes = 0
+
+    while True:
+        chunk = read(4096)
+        if not chunk:
+            break
+        buf += chunk
+
+        while buf:
+            sync = buf.find(FRAME_SYNC)
+            if sync < 0:
+                out.write(buf.decode("utf-8", "replace"))
+                del buf[:]
+                break
+            if sync:
+                out.write(buf[:sync].decode("utf-8", "replace"))
+                del buf[:sync]
+
+            if len(buf) < 2 or len(buf) < buf[1] + 3:
+                # wait for the rest of it
+                break
+
+            n = buf[1]
+            body = bytes(buf[2:2 + n])
+            if sum(body) & 0xff != buf[2 + n]:
+                # not a frame after all
+                out.write(chr(buf[0]))
+                del buf[:1]
+                continue
+
+            del buf[:n + 3]
+            try:
+                line, text = decode(body)
+            except IndexError:
+                line, text = "<short frame %s>" % body.hex(), ""
+            out.write(line + "\n")
+            out.flush()
+
+            frames += 1
+            wire_bytes += n + 3
+            text_bytes += len(text) + 1
+
+    out.write(buf.decode("utf-8", "replace"))
+
+    if args.stats and frames:
+        sys.stderr.write("%d log lines: %.1f bytes per line on the UART, %.1f as text (%.0f%% saved)\n" %
+                         (frames, wire_bytes / frames, text_bytes / frames, 100.0 - 100.0 * wire_bytes / text_bytes))
+
+main()
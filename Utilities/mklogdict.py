@@ -0,0 +1,78 @@
+#!/usr/bin/env python
+
+"""
+Pulls the tokenized log strings out of a LOG_TOKENIZED firmware elf.
+RebbleOS
+
+Every log call leaves a string in the .log_strings section, which is never
+loaded onto the watch. Its offset in there is the token the watch sends.
+This writes them all out as JSON, token to [layer, module, file, line, fmt],
+for Utilities/logdecode.py. The build does this for you, next to the elf.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+SECTION = ".log_strings"
+
+parser = argparse.ArgumentParser(description = "Extract the RebbleOS tokenized log dictionary from an elf.")
+parser.add_argument("elf", help = "tintin_fw.elf")
+parser.add_argument("dict", help = "output dictionary, usually tintin_fw.logdict")
+args = parser.parse_args()
+
+def read_section(elf, name):
+    """ Returns (address, bytes) of the named section, or None """
+    if elf[:4] != b"\x7fELF":
+        raise ValueError("not an elf")
+    wide = elf[4] == 2
+    order = "<" if elf[5] == 1 else ">"
+
+    if wide:
+        shoff, = struct.unpack_from(order + "Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(order + "HHH", elf, 0x3a)
+    else:
+        shoff, = struct.unpack_from(order + "I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(order + "HHH", elf, 0x2e)
+
+    def header(i):
+        fmt = order + ("IIQQQQIIQQ" if wide else "IIIIIIIIII")
+        h = struct.unpack_from(fmt, elf, shoff + i * shentsize)
+        # name, address, offset, size
+        return h[0], h[3], h[4], h[5]
+
+    _, _, names_off, names_size = header(shstrndx)
+    names = elf[names_off:names_off + names_size]
+
+    for i in range(shnum):
+        name_off, addr, off, size = header(i)
+        if names[name_off:names.index(b"\0", name_off)].decode() == name:
+            return addr, elf[off:off + size]
+    return None
+
+with open(args.elf, "rb") as f:
+    section = read_section(f.read(), SECTION)
+
+tokens = {}
+if section is None:
+    sys.stderr.write("%s has no %s section, was it built with LOG_TOKENIZED?\n" % (args.elf, SECTION))
+else:
+    addr, data = section
+    pos = 0
+    # strings are NUL terminated, and may be padded out with more NULs
+    while pos < len(data):
+        if data[pos] == 0:
+            pos += 1
+            continue
+        end = data.index(b"\0", pos)
+        fields = data[pos:end].decode("utf-8", "replace").split("\x1f", 4)
+        if len(fields) == 5:
+            layer, module, filename, line, fmt = fields
+            tokens[str(addr + pos)] = [layer, module, filename, int(line), fmt]
+        pos = end + 1
+
+with open(args.dict, "w") as f:
+    json.dump(tokens, f, indent = 0, sort_keys = True)
+
+print("%d log strings in %s" % (len(tokens), args.dict))
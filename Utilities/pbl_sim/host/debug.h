@@ -0,0 +1,8 @@
+#pragma once
+/* debug.h
+ * RebbleOS
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#define panic(msg_) do { fprintf(stderr, "panic: %s\n", msg_); abort(); } while (0)
@@ -0,0 +1,318 @@
+/* freertos_host.c
+ * Just enough of FreeRTOS on pthreads for the protocol simulator
+ * RebbleOS
+ *
+ * Priorities are ignored, the host schedules the threads however it
+ * likes. That is fine for finding out what the protocol code does with
+ * a lot of traffic, not for how long it takes on the watch.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include "FreeRTOS.h"
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *param;
+    const char *name;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_value;
+    bool notified;
+};
+
+struct host_sem {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max;
+    /* recursive mutexes only */
+    TaskHandle_t holder;
+    UBaseType_t depth;
+};
+
+static pthread_mutex_t _critical;
+static pthread_once_t _critical_once = PTHREAD_ONCE_INIT;
+static __thread struct host_task *_current;
+
+static void _critical_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&_critical, &attr);
+}
+
+void vPortEnterCritical(void)
+{
+    pthread_once(&_critical_once, _critical_init);
+    pthread_mutex_lock(&_critical);
+}
+
+void vPortExitCritical(void)
+{
+    pthread_mutex_unlock(&_critical);
+}
+
+static struct timespec _deadline(TickType_t ticks)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ticks / 1000;
+    ts.tv_nsec += (ticks % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+/* wait on cond until done() or the ticks run out. Called with lock held */
+#define _WAIT_UNTIL(cond_, lock_, ticks_, done_) ({ \
+            struct timespec _ts = _deadline(ticks_); \
+            int _err = 0; \
+            while (!(done_) && _err != ETIMEDOUT && (ticks_)) \
+                _err = (ticks_) == portMAX_DELAY ? pthread_cond_wait(cond_, lock_) \
+                                                 : pthread_cond_timedwait(cond_, lock_, &_ts); \
+            (done_); \
+        })
+
+static struct host_task *_task_new(const char *name)
+{
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    task->name = name;
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    return task;
+}
+
+static void *_task_entry(void *arg)
+{
+    struct host_task *task = arg;
+    _current = task;
+    task->fn(task->param);
+    return NULL;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                               void *param, UBaseType_t priority,
+                               StackType_t *stack, StaticTask_t *task_buf)
+{
+    struct host_task *task = _task_new(name);
+    task->fn = fn;
+    task->param = param;
+    if (pthread_create(&task->thread, NULL, _task_entry, task))
+    {
+        fprintf(stderr, "can't start task %s\n", name);
+        exit(1);
+    }
+    pthread_detach(task->thread);
+    return task;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task || task == _current)
+        pthread_exit(NULL);
+    /* only ever used by a task on itself */
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = { ticks / 1000, (ticks % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    /* threads the shim didn't start get a handle the first time they ask */
+    if (!_current)
+        _current = _task_new("host");
+    return _current;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+
+    pthread_mutex_lock(&task->lock);
+    _WAIT_UNTIL(&task->cond, &task->lock, ticks, task->notify_value);
+    uint32_t value = task->notify_value;
+    if (value)
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    task->notified = false;
+    pthread_mutex_unlock(&task->lock);
+
+    return value;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    BaseType_t ret = pdPASS;
+
+    pthread_mutex_lock(&task->lock);
+    switch (action)
+    {
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notified)
+                ret = pdFALSE;
+            else
+                task->notify_value = value;
+            break;
+        default:
+            break;
+    }
+    task->notified = true;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+
+    return ret;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+                           uint32_t *value, TickType_t ticks)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+
+    pthread_mutex_lock(&task->lock);
+    if (!task->notified)
+        task->notify_value &= ~clear_on_entry;
+    bool got = _WAIT_UNTIL(&task->cond, &task->lock, ticks, task->notified);
+    if (value)
+        *value = task->notify_value;
+    if (got)
+        task->notify_value &= ~clear_on_exit;
+    task->notified = false;
+    pthread_mutex_unlock(&task->lock);
+
+    return got ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xTaskNotifyStateClear(TaskHandle_t task)
+{
+    if (!task)
+        task = xTaskGetCurrentTaskHandle();
+
+    pthread_mutex_lock(&task->lock);
+    BaseType_t was = task->notified;
+    task->notified = false;
+    pthread_mutex_unlock(&task->lock);
+
+    return was;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCountingStatic(UBaseType_t max, UBaseType_t initial,
+                                                 StaticSemaphore_t *buf)
+{
+    struct host_sem *sem = calloc(1, sizeof(struct host_sem));
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->count = initial;
+    sem->max = max;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buf)
+{
+    return xSemaphoreCreateCountingStatic(1, 0, buf);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    pthread_mutex_lock(&sem->lock);
+    bool got = _WAIT_UNTIL(&sem->cond, &sem->lock, ticks, sem->count);
+    if (got)
+        sem->count--;
+    pthread_mutex_unlock(&sem->lock);
+
+    return got ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count < sem->max)
+    {
+        sem->count++;
+        ret = pdTRUE;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+
+    return ret;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t *buf)
+{
+    return xSemaphoreCreateCountingStatic(1, 1, buf);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    bool got = true;
+
+    pthread_mutex_lock(&sem->lock);
+    if (sem->holder != self)
+    {
+        got = _WAIT_UNTIL(&sem->cond, &sem->lock, ticks, sem->count);
+        if (got)
+        {
+            sem->count--;
+            sem->holder = self;
+        }
+    }
+    if (got)
+        sem->depth++;
+    pthread_mutex_unlock(&sem->lock);
+
+    return got ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+    BaseType_t ret = pdFALSE;
+
+    pthread_mutex_lock(&sem->lock);
+    if (sem->holder == xTaskGetCurrentTaskHandle())
+    {
+        if (!--sem->depth)
+        {
+            sem->holder = NULL;
+            sem->count++;
+            pthread_cond_signal(&sem->cond);
+        }
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+
+    return ret;
+}
@@ -0,0 +1,29 @@
+#pragma once
+/* log.h
+ * Logging for the host simulator. Everything goes to stderr through
+ * host_log in pbl_sim.c, which drops what is below the level asked for
+ * RebbleOS
+ */
+#include <stdint.h>
+
+typedef enum LogLevel {
+    APP_LOG_LEVEL_ERROR,
+    APP_LOG_LEVEL_WARNING,
+    APP_LOG_LEVEL_INFO,
+    APP_LOG_LEVEL_DEBUG,
+    APP_LOG_LEVEL_DEBUG_VERBOSE
+} LogLevel;
+
+/* no format checking, the formats are written for a 32 bit watch */
+void host_log(const char *layer, const char *module, uint8_t level, const char *fmt, ...);
+
+#define NULL_LOG(module_, lvl_, fmt_, ...) {;}
+#define SYS_LOG(module_, lvl_, fmt_, ...) host_log("SYS", module_, lvl_, fmt_, ##__VA_ARGS__)
+#define KERN_LOG(module_, lvl_, fmt_, ...) host_log("KERN", module_, lvl_, fmt_, ##__VA_ARGS__)
+#define DRV_LOG(module_, lvl_, fmt_, ...) host_log("DRIVER", module_, lvl_, fmt_, ##__VA_ARGS__)
+#define APP_LOG(module_, lvl_, fmt_, ...) host_log("APP", module_, lvl_, fmt_, ##__VA_ARGS__)
+
+#define LOG_INFO(fmt_, ...) host_log(MODULE_TYPE, MODULE_NAME, APP_LOG_LEVEL_INFO, fmt_, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt_, ...) host_log(MODULE_TYPE, MODULE_NAME, APP_LOG_LEVEL_DEBUG, fmt_, ##__VA_ARGS__)
+#define LOG_WARN(fmt_, ...) host_log(MODULE_TYPE, MODULE_NAME, APP_LOG_LEVEL_WARNING, fmt_, ##__VA_ARGS__)
+#define LOG_ERROR(fmt_, ...) host_log(MODULE_TYPE, MODULE_NAME, APP_LOG_LEVEL_ERROR, fmt_, ##__VA_ARGS__)
@@ -0,0 +1,8 @@
+#pragma once
+/* minilib.h
+ * The host has a libc
+ * RebbleOS
+ */
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
@@ -0,0 +1,10 @@
+#pragma once
+/* notification_manager.h
+ * No overlays in the host simulator. Notifications are parsed into the
+ * message store for real, and pbl_sim.c counts the ones that would be shown
+ * RebbleOS
+ */
+#include "protocol_notification.h"
+#include "notification_message.h"
+
+void notification_show_message(full_msg_t *msg, uint32_t timeout_ms);
@@ -0,0 +1,7 @@
+#pragma once
+/* rebble_memory.h
+ * Stands in for the OS header of the same name, rebbleos.h has all the
+ * simulator needs
+ * RebbleOS
+ */
+#include "rebbleos.h"
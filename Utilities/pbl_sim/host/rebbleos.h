@@ -0,0 +1,33 @@
+#pragma once
+/* rebbleos.h
+ * The parts of the OS the protocol code leans on, for the host simulator.
+ * Everything here that isn't in the OS headers themselves is in pbl_sim.c
+ * RebbleOS
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "log.h"
+#include "node_list.h"
+#include "qalloc.h"
+#include "rbl_bluetooth.h"
+
+#define INIT_RESP_OK            0
+#define INIT_RESP_ASYNC_WAIT    1
+#define INIT_RESP_NOT_SUPPORTED 2
+#define INIT_RESP_ERROR         3
+
+/* no core coupled memory on the host */
+#define CCRAM
+
+#define system_calloc calloc
+
+void os_module_init_complete(uint8_t state);
+void connection_service_update(bool connected);
+bool bt_device_request_tx(uint8_t *data, uint16_t len);
+bool bt_device_cancel_tx(void);
@@ -0,0 +1,6 @@
+#pragma once
+/* stm32_usart.h
+ * No UART on the host, the simulator talks over a socket
+ * RebbleOS
+ */
+typedef struct stm32_usart_t stm32_usart_t;
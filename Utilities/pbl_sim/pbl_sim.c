@@ -0,0 +1,351 @@
+/* pbl_sim.c
+ * Host simulator for the Pebble protocol side of RebbleOS
+ * RebbleOS
+ *
+ * rcore/bluetooth.c, the RX stream, the TX ring, the endpoint worker and
+ * the protocol handlers are built as they are, on a pthread FreeRTOS
+ * (host/freertos_host.c). Where the cc256x and btstack would be there is
+ * a TCP socket: whatever a client writes is fed to bluetooth_data_rx, and
+ * whatever the watch sends is written back. The framing on the socket is
+ * the Pebble protocol as it comes over RFCOMM, a 4 byte header of length
+ * and endpoint, big endian, then the payload.
+ *
+ * One client at a time. When it hangs up, what each endpoint did with
+ * that client's traffic is printed, and the next one can connect. The
+ * max depth and wait are since pbl_sim started, the rest are per client.
+ * Utilities/pbl_sim/pbl_sim_client.py replays phone traffic at it.
+ *
+ * Nothing here knows about the watch's timing. -b makes the socket as slow
+ * as the UART to the BT chip, so queues fill the way they would, but
+ * handler times are the host's.
+ *
+ *   cc -O2 -pthread -D_FORTIFY_SOURCE=0 \
+ *      -Dsprintf=bt_sprintf -Dstrncpy=bt_strncpy -Dsscanf=bt_sscanf \
+ *      -I- -I Utilities/pbl_sim/host -I rcore -I rcore/protocol -I lib/minilib/inc \
+ *      -o pbl_sim Utilities/pbl_sim/pbl_sim.c Utilities/pbl_sim/host/freertos_host.c \
+ *      rcore/bluetooth.c rcore/bt_rx_stream.c rcore/bt_tx_ring.c \
+ *      rcore/protocol/endpoint.c rcore/protocol/protocol_system.c \
+ *      rcore/protocol/protocol_notification.c rcore/notification_message.c \
+ *      lib/minilib/qalloc.c
+ *   ./pbl_sim [-p port] [-b baud] [-n clients] [-v]
+ *
+ * -I- stops "log.h" and friends coming from next to the .c file, so the
+ * ones in host/ are used instead. bluetooth.c has its own sprintf, strncpy
+ * and sscanf for btstack, the -D's keep them out of the way of the host's.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "rebbleos.h"
+#include "pebble_protocol.h"
+#include "notification_manager.h"
+
+#define SIM_PORT 47527
+/* about what RFCOMM hands us at a time */
+#define SIM_RX_CHUNK 1020
+/* how long the endpoint worker gets to finish once the client has gone */
+#define SIM_DRAIN_MS 2000
+
+/* no handler for these on the watch yet, the simulator stands in for an app */
+#define ENDPOINT_APP_MESSAGE 0x30
+#define APP_MESSAGE_PUSH 0x01
+#define APP_MESSAGE_ACK  0xff
+
+static const uint16_t _endpoints[] = {
+    ENDPOINT_SET_TIME,
+    ENDPOINT_FIRMWARE_VERSION,
+    ENDPOINT_PHONE_MSG,
+    ENDPOINT_APP_MESSAGE,
+};
+#define SIM_ENDPOINT_COUNT (sizeof(_endpoints) / sizeof(_endpoints[0]))
+
+static int _log_level = APP_LOG_LEVEL_WARNING;
+static uint32_t _baud;
+static int _client = -1;
+static uint16_t _port = SIM_PORT;
+
+static SemaphoreHandle_t _init_done;
+static StaticSemaphore_t _init_done_buf;
+static SemaphoreHandle_t _session_done;
+static StaticSemaphore_t _session_done_buf;
+
+/* for this client */
+typedef struct sim_session {
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+    uint32_t tx_packets;
+    uint32_t notifications;
+    double start;
+    double end;
+} sim_session;
+
+static sim_session _session;
+static EndpointStats _stats_before[SIM_ENDPOINT_COUNT];
+
+static double _now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* as long as len bytes take on a UART at _baud, 10 bits a byte */
+static void _wire_wait(size_t len)
+{
+    if (!_baud)
+        return;
+
+    uint64_t ns = (uint64_t)len * 10 * 1000000000ull / _baud;
+    struct timespec ts = { ns / 1000000000ull, ns % 1000000000ull };
+    nanosleep(&ts, NULL);
+}
+
+/*
+ * What the OS would otherwise do
+ */
+
+void host_log(const char *layer, const char *module, uint8_t level, const char *fmt, ...)
+{
+    static const char levels[] = "EWIDV";
+    va_list ap;
+
+    if (level > _log_level)
+        return;
+
+    va_start(ap, fmt);
+    fprintf(stderr, "[%c] %s %s: ", levels[level % 5], layer, module);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+/* bluetooth.c's sprintf wants it */
+int vsfmt(char *buf, unsigned int len, const char *fmt, va_list ap)
+{
+    return vsnprintf(buf, len, fmt, ap);
+}
+
+void os_module_init_complete(uint8_t state)
+{
+    xSemaphoreGive(_init_done);
+}
+
+void connection_service_update(bool connected)
+{
+}
+
+/* there are no overlays, the message just goes in the store */
+void notification_show_message(full_msg_t *msg, uint32_t timeout_ms)
+{
+    message_add(msg);
+    _session.notifications++;
+}
+
+/*
+ * App messages. Push gets an ack, the way an app that took it would
+ */
+
+static void _sim_app_message(uint8_t *data, uint16_t len)
+{
+    if (len < 2 || data[0] != APP_MESSAGE_PUSH)
+        return;
+
+    uint8_t ack[2] = { APP_MESSAGE_ACK, data[1] };
+    bluetooth_send_packet(ENDPOINT_APP_MESSAGE, ack, sizeof(ack));
+}
+
+/*
+ * Reporting
+ */
+
+static bool _endpoints_idle(void)
+{
+    for (uint8_t i = 0; i < SIM_ENDPOINT_COUNT; i++)
+    {
+        EndpointStats s;
+        if (endpoint_get_stats(_endpoints[i], &s) && s.depth)
+            return false;
+    }
+
+    return true;
+}
+
+static const char *_endpoint_name(uint16_t endpoint)
+{
+    switch (endpoint)
+    {
+        case ENDPOINT_SET_TIME: return "time";
+        case ENDPOINT_FIRMWARE_VERSION: return "version";
+        case ENDPOINT_PHONE_MSG: return "notification";
+        case ENDPOINT_APP_MESSAGE: return "app message";
+        default: return "?";
+    }
+}
+
+static void _session_report(void)
+{
+    double secs = _session.end - _session.start;
+    if (secs <= 0)
+        secs = 1e-9;
+
+    printf("client: %.2fs, rx %llu bytes (%.1f kB/s), tx %u packets %llu bytes\n",
+           secs, (unsigned long long)_session.rx_bytes, _session.rx_bytes / secs / 1000,
+           _session.tx_packets, (unsigned long long)_session.tx_bytes);
+    printf("%-13s %8s %9s %8s %9s %10s %10s %10s\n",
+           "endpoint", "handled", "per sec", "dropped", "max depth", "wait max", "run avg", "run max");
+
+    for (uint8_t i = 0; i < SIM_ENDPOINT_COUNT; i++)
+    {
+        EndpointStats s, *b = &_stats_before[i];
+        if (!endpoint_get_stats(_endpoints[i], &s))
+            continue;
+
+        uint32_t handled = s.handled - b->handled;
+        uint32_t run_ms = s.run_ms_total - b->run_ms_total;
+        printf("%-13s %8u %9.1f %8u %9u %8ums %8.2fms %8ums\n",
+               _endpoint_name(s.endpoint), handled, handled / secs, s.dropped - b->dropped,
+               s.depth_max, s.wait_ms_max, handled ? (double)run_ms / handled : 0.0, s.run_ms_max);
+        *b = s;
+    }
+
+    MessageStoreStats ms;
+    message_store_stats(&ms);
+    printf("notifications: %u shown, store has %u in %u bytes, %u evicted, %u failed\n\n",
+           _session.notifications, ms.count, ms.bytes, ms.evicted, ms.failed);
+    fflush(stdout);
+}
+
+/*
+ * The BT device, over a socket
+ */
+
+bool bt_device_request_tx(uint8_t *data, uint16_t len)
+{
+    _wire_wait(len);
+
+    if (_client >= 0 && send(_client, data, len, MSG_NOSIGNAL) == len)
+    {
+        _session.tx_bytes += len;
+        _session.tx_packets++;
+    }
+
+    /* the stack has it, as far as anyone can tell */
+    bluetooth_tx_complete();
+    return true;
+}
+
+/* sends are done before request_tx returns, so never anything to cancel */
+bool bt_device_cancel_tx(void)
+{
+    return false;
+}
+
+static int _listen(uint16_t port)
+{
+    int one = 1;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 1))
+    {
+        perror("pbl_sim: listen");
+        exit(1);
+    }
+
+    return fd;
+}
+
+/* the BT thread runs this, like it would the btstack runloop */
+uint8_t hw_bluetooth_init(void)
+{
+    static uint8_t chunk[SIM_RX_CHUNK];
+    int one = 1;
+
+    int fd = _listen(_port);
+    printf("pbl_sim: listening on 127.0.0.1:%d\n", _port);
+    fflush(stdout);
+    bluetooth_init_complete(INIT_RESP_OK);
+
+    for (;;)
+    {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0)
+            continue;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        memset(&_session, 0, sizeof(_session));
+        _session.start = _now();
+        _client = client;
+        bluetooth_device_connected();
+
+        ssize_t n;
+        while ((n = recv(client, chunk, sizeof(chunk), 0)) > 0)
+        {
+            _wire_wait(n);
+            _session.rx_bytes += n;
+            bluetooth_data_rx(chunk, n);
+        }
+
+        _session.end = _now();
+
+        /* let the endpoint worker finish what the client left it */
+        TickType_t start = xTaskGetTickCount();
+        while (!_endpoints_idle() && xTaskGetTickCount() - start < SIM_DRAIN_MS)
+            vTaskDelay(1);
+
+        bluetooth_device_disconnected();
+        _client = -1;
+        close(client);
+        _session_report();
+        xSemaphoreGive(_session_done);
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    int clients = 0, opt;
+
+    while ((opt = getopt(argc, argv, "p:b:n:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p': _port = atoi(optarg); break;
+            case 'b': _baud = atoi(optarg); break;
+            case 'n': clients = atoi(optarg); break;
+            case 'v': _log_level++; break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-b baud] [-n clients] [-v]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    _init_done = xSemaphoreCreateBinaryStatic(&_init_done_buf);
+    _session_done = xSemaphoreCreateCountingStatic(16, 0, &_session_done_buf);
+
+    messages_init();
+    bluetooth_init();
+    xSemaphoreTake(_init_done, portMAX_DELAY);
+    endpoint_register(ENDPOINT_APP_MESSAGE, _sim_app_message, ENDPOINT_QUEUE_MAX);
+
+    for (int n = 0; !clients || n < clients; n++)
+        xSemaphoreTake(_session_done, portMAX_DELAY);
+
+    return 0;
+}
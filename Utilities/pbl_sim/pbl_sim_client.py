@@ -0,0 +1,205 @@
+#!/usr/bin/env python
+
+"""
+Plays the phone to Utilities/pbl_sim, replaying Pebble protocol traffic.
+RebbleOS
+
+Time sets, version requests, notifications and app messages each go at
+their own rate, for as long as you ask. Version requests and app messages
+get an answer, so their round trip through the watch side (RX stream,
+endpoint queue and worker, handler, TX ring) is timed. The others are
+fire and forget; pbl_sim prints what each endpoint did with them when
+this hangs up.
+
+    ./pbl_sim -n 1 &
+    Utilities/pbl_sim/pbl_sim_client.py --seconds 5 --notification 20 --appmsg 50
+
+--burst sends that many of each up front as fast as the socket takes
+them, to see what the queues drop.
+"""
+
+import argparse
+import socket
+import struct
+import threading
+import time
+
+# must match rcore/protocol/endpoint.h
+ENDPOINT_SET_TIME = 0x0b
+ENDPOINT_FIRMWARE_VERSION = 0x10
+ENDPOINT_PHONE_MSG = 0xbc2
+ENDPOINT_APP_MESSAGE = 0x30
+
+APP_MESSAGE_PUSH = 0x01
+APP_MESSAGE_ACK = 0xff
+APP_UUID = bytes(range(16))
+
+parser = argparse.ArgumentParser(description = "Replay phone traffic at the RebbleOS protocol simulator.")
+parser.add_argument("--host", default = "127.0.0.1")
+parser.add_argument("--port", type = int, default = 47527)
+parser.add_argument("--seconds", type = float, default = 5, help = "how long to send for")
+parser.add_argument("--time", type = float, default = 1, help = "time sets a second")
+parser.add_argument("--version", type = float, default = 5, help = "version requests a second")
+parser.add_argument("--notification", type = float, default = 5, help = "notifications a second")
+parser.add_argument("--appmsg", type = float, default = 20, help = "app messages a second")
+parser.add_argument("--body", type = int, default = 120, help = "notification body bytes")
+parser.add_argument("--burst", type = int, default = 0, help = "send this many of each first, back to back")
+parser.add_argument("--grace", type = float, default = 2, help = "seconds to wait for answers at the end")
+args = parser.parse_args()
+
+def frame(endpoint, payload):
+    return struct.pack(">HH", len(payload), endpoint) + payload
+
+def time_packet(n):
+    tz = b"Europe/London"
+    return frame(ENDPOINT_SET_TIME, struct.pack(">BIhB", 3, int(time.time()), 0, len(tz)) + tz)
+
+def version_packet(n):
+    return frame(ENDPOINT_FIRMWARE_VERSION, b"\x00")
+
+def notification_packet(n):
+    """ A title and a body, and a dismiss action, like Gadgetbridge sends """
+    title = ("Message %d" % n).encode()
+    body = (b"lorem ipsum dolor sit amet " * (args.body // 27 + 1))[:args.body]
+    attrs = [(1, title), (3, body)]
+    p = struct.pack("<BBIIIIBBB", 0, 1, 0, n, 0, int(time.time()), 1, len(attrs), 1)
+    for idx, s in attrs:
+        p += struct.pack("<BH", idx, len(s)) + s
+    p += struct.pack("<BBBBH", 0, 4, 1, 1, 7) + b"Dismiss"
+    return frame(ENDPOINT_PHONE_MSG, p)
+
+def appmsg_packet(n):
+    """ One uint32 and one short string, the usual sort of thing """
+    tuples = struct.pack("<IBHI", 0, 2, 4, n)
+    tuples += struct.pack("<IBH", 1, 1, 8) + b"weather\x00"
+    return frame(ENDPOINT_APP_MESSAGE, struct.pack("<BB", APP_MESSAGE_PUSH, n & 0xff) + APP_UUID + b"\x02" + tuples)
+
+class Stream:
+    def __init__(self, name, endpoint, rate, make, answered):
+        self.name = name
+        self.endpoint = endpoint
+        self.rate = rate
+        self.make = make
+        self.answered = answered
+        self.sent = 0
+        self.bytes = 0
+        self.answers = 0
+        self.rtts = []
+        self.waiting = {}
+        self.next = 0
+
+streams = [
+    Stream("time", ENDPOINT_SET_TIME, args.time, time_packet, False),
+    Stream("version", ENDPOINT_FIRMWARE_VERSION, args.version, version_packet, True),
+    Stream("notification", ENDPOINT_PHONE_MSG, args.notification, notification_packet, False),
+    Stream("app message", ENDPOINT_APP_MESSAGE, args.appmsg, appmsg_packet, True),
+]
+by_endpoint = {s.endpoint: s for s in streams}
+lock = threading.Lock()
+done = threading.Event()
+
+def send(sock, s):
+    data = s.make(s.sent)
+    with lock:
+        if s.endpoint == ENDPOINT_FIRMWARE_VERSION:
+            # answers have nothing to match them by, so only one is timed
+            # at once. If it was dropped, the next one is timed instead
+            if not s.waiting or time.monotonic() - s.waiting[None][0] > args.grace:
+                s.waiting[None] = [time.monotonic()]
+        elif s.answered:
+            s.waiting.setdefault(s.sent & 0xff, []).append(time.monotonic())
+    sock.sendall(data)
+    s.sent += 1
+    s.bytes += len(data)
+
+def answered(s, key):
+    with lock:
+        s.answers += 1
+        sent = s.waiting.get(key)
+        if not sent:
+            return
+        # an older one with the same id was dropped, 256 messages ago
+        s.rtts.append(time.monotonic() - sent.pop())
+        if not sent:
+            del s.waiting[key]
+
+def receive(sock):
+    buf = b""
+    while not done.is_set():
+        try:
+            data = sock.recv(4096)
+        except (socket.timeout, OSError):
+            continue
+        if not data:
+            break
+        buf += data
+        while len(buf) >= 4:
+            length, endpoint = struct.unpack(">HH", buf[:4])
+            if len(buf) < 4 + length:
+                break
+            payload, buf = buf[4:4 + length], buf[4 + length:]
+            s = by_endpoint.get(endpoint)
+            if s is None:
+                continue
+            if endpoint == ENDPOINT_FIRMWARE_VERSION:
+                answered(s, None)
+            elif endpoint == ENDPOINT_APP_MESSAGE and len(payload) >= 2 and payload[0] == APP_MESSAGE_ACK:
+                answered(s, payload[1])
+
+def outstanding():
+    with lock:
+        return sum(s.sent - s.answers for s in streams if s.answered)
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+sock = socket.create_connection((args.host, args.port))
+sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+sock.settimeout(0.1)
+rx = threading.Thread(target = receive, args = (sock,))
+rx.start()
+
+start = time.monotonic()
+for s in streams:
+    if s.rate > 0:
+        for i in range(args.burst):
+            send(sock, s)
+        s.next = time.monotonic()
+
+end = start + args.seconds
+while True:
+    live = [s for s in streams if s.rate > 0]
+    if not live:
+        break
+    s = min(live, key = lambda s: s.next)
+    if s.next >= end:
+        break
+    delay = s.next - time.monotonic()
+    if delay > 0:
+        time.sleep(delay)
+    send(sock, s)
+    s.next += 1 / s.rate
+sent_secs = time.monotonic() - start
+
+grace = time.monotonic() + args.grace
+while outstanding() and time.monotonic() < grace:
+    time.sleep(0.01)
+
+done.set()
+rx.join()
+sock.close()
+
+print("sent for %.2fs" % sent_secs)
+print("%-13s %6s %9s %9s %8s %6s %9s %9s %9s" %
+      ("endpoint", "sent", "per sec", "kB/s", "answers", "lost", "rtt p50", "rtt p90", "rtt max"))
+for s in streams:
+    if not s.sent:
+        continue
+    line = "%-13s %6d %9.1f %9.2f" % (s.name, s.sent, s.sent / sent_secs, s.bytes / sent_secs / 1000)
+    if s.answered:
+        line += " %8d %6d" % (s.answers, s.sent - s.answers)
+    if s.rtts:
+        ms = [r * 1000 for r in s.rtts]
+        line += " %7.2fms %7.2fms %7.2fms" % (percentile(ms, 50), percentile(ms, 90), max(ms))
+    print(line)
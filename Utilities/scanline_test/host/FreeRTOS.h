@@ -0,0 +1,8 @@
+#pragma once
+/* FreeRTOS.h
+ * Stands in for FreeRTOS, platform.h and the rest, so snowy_scanlines.c
+ * builds on the host. DISPLAY_ROWS and DISPLAY_COLS come from the command line
+ * RebbleOS
+ */
+#include <stdint.h>
+#include <assert.h>
@@ -0,0 +1,136 @@
+/* scanline_test.c
+ * Host test and benchmark for the scanline conversion in
+ * hw/platform/snowy_family/snowy_scanlines.c
+ * RebbleOS
+ *
+ * Checks the word at a time kernels come out bit for bit the same as the
+ * byte at a time reference ones, for random frames, every column and row.
+ * Then times whole frames through each. The numbers are for the host CPU,
+ * so only the ratio means much for the watch.
+ *
+ * The kernels are built for one display size, so build this for each:
+ * 168x144 is snowy (columns), 180x180 is chalk (rows).
+ *
+ *   cc -O2 -DDISPLAY_ROWS=168 -DDISPLAY_COLS=144 -I Utilities/scanline_test/host \
+ *      -o scanline_test Utilities/scanline_test/scanline_test.c \
+ *      hw/platform/snowy_family/snowy_scanlines.c
+ *   ./scanline_test [seed]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEST_FRAMES 50
+#define BENCH_FRAMES 2000
+
+/* not in a header, the display driver only calls scanline_convert */
+void _scanline_convert_row(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t row_index);
+void _scanline_convert_column(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t column_index);
+void _scanline_convert_row_fast(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t row_index);
+void _scanline_convert_column_fast(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t column_index);
+
+typedef void (*scanline_kernel)(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t index);
+
+typedef struct scanline_pair {
+    const char *name;
+    scanline_kernel reference;
+    scanline_kernel fast;
+    uint16_t count; // lines in a frame
+    uint16_t bytes; // bytes out per line
+} scanline_pair;
+
+static const scanline_pair _pairs[] = {
+#if (DISPLAY_ROWS % 8) == 0
+    { "column", _scanline_convert_column, _scanline_convert_column_fast, DISPLAY_COLS, DISPLAY_ROWS },
+#endif
+#if (DISPLAY_COLS % 4) == 0
+    { "row", _scanline_convert_row, _scanline_convert_row_fast, DISPLAY_ROWS, DISPLAY_COLS },
+#endif
+};
+#define PAIR_COUNT (sizeof(_pairs) / sizeof(_pairs[0]))
+
+static uint8_t _fb[DISPLAY_ROWS * DISPLAY_COLS] __attribute__((aligned(4)));
+static uint8_t _want[256] __attribute__((aligned(4)));
+static uint8_t _got[256] __attribute__((aligned(4)));
+
+static double _now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void _random_frame(void)
+{
+    for (uint32_t i = 0; i < sizeof(_fb); i++)
+        _fb[i] = rand();
+}
+
+static int _check(const scanline_pair *p)
+{
+    for (int f = 0; f < TEST_FRAMES; f++)
+    {
+        _random_frame();
+
+        for (uint16_t i = 0; i < p->count; i++)
+        {
+            /* different fill, so a byte the fast one misses shows up */
+            memset(_want, 0x00, sizeof(_want));
+            memset(_got, 0xff, sizeof(_got));
+            p->reference(_want, _fb, i);
+            p->fast(_got, _fb, i);
+
+            if (memcmp(_want, _got, p->bytes))
+            {
+                printf("%s %d of frame %d differs from the reference\n", p->name, i, f);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static double _frames_per_sec(const scanline_pair *p, scanline_kernel kernel)
+{
+    double start = _now();
+    for (int f = 0; f < BENCH_FRAMES; f++)
+        for (uint16_t i = 0; i < p->count; i++)
+            kernel(_got, _fb, i);
+    return BENCH_FRAMES / (_now() - start);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned seed = argc > 1 ? atoi(argv[1]) : time(NULL);
+    int failed = 0;
+
+    srand(seed);
+    printf("%dx%d, seed %u\n", DISPLAY_ROWS, DISPLAY_COLS, seed);
+
+    if (!PAIR_COUNT)
+    {
+        printf("no fast kernels at this size, nothing to check\n");
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < PAIR_COUNT; i++)
+    {
+        const scanline_pair *p = &_pairs[i];
+        if (_check(p))
+        {
+            failed++;
+            continue;
+        }
+
+        double ref = _frames_per_sec(p, p->reference);
+        double fast = _frames_per_sec(p, p->fast);
+        printf("%-6s bit exact over %d frames. frames/s: reference %.0f, fast %.0f (%.2fx)\n",
+               p->name, TEST_FRAMES, ref, fast, fast / ref);
+    }
+
+    return failed;
+}
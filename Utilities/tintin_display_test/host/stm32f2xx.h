@@ -0,0 +1,131 @@
+#pragma once
+/* stm32f2xx.h
+ * Stands in for the STM32 headers, stm32_spi, stm32_power and the rest of
+ * what tintin_display.c includes, so the driver builds on the host.
+ * The other headers in here just include this one. The SPI and power
+ * calls are in tintin_display_test.c, which watches what goes out
+ * RebbleOS
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* registers and peripherals are only ever passed along */
+#define SPI2 ((void *)0)
+#define GPIOB ((void *)0)
+#define DMA1_Stream3 ((void *)0)
+#define DMA1_Stream4 ((void *)0)
+#define DMA_Channel_0 0
+#define DMA1_Stream3_IRQn 0
+#define DMA1_Stream4_IRQn 0
+#define DMA_IT_TCIF3 0
+#define DMA_IT_TCIF4 0
+#define RCC_AHB1Periph_DMA1 0
+#define RCC_AHB1Periph_GPIOB 0x1
+#define RCC_AHB1Periph_GPIOC 0x2
+#define RCC_APB1Periph_SPI2 0x4000
+#define GPIO_AF_SPI2 0
+#define GPIO_AF_TIM3 0
+#define SPI_BaudRatePrescaler_8 0
+#define SPI_CPOL_Low 0
+#define GPIO_Mode_OUT 0
+#define GPIO_Mode_AF 0
+#define GPIO_Speed_50MHz 0
+#define GPIO_OType_PP 0
+#define GPIO_OType_OD 0
+#define GPIO_PuPd_NOPULL 0
+
+typedef struct {
+    uint32_t GPIO_Pin;
+    uint32_t GPIO_Mode;
+    uint32_t GPIO_Speed;
+    uint32_t GPIO_OType;
+    uint32_t GPIO_PuPd;
+} GPIO_InitTypeDef;
+
+static inline void GPIO_Init(void *gpio, GPIO_InitTypeDef *init) { }
+static inline void GPIO_WriteBit(void *gpio, uint32_t pin, int value) { }
+static inline void GPIO_PinAFConfig(void *gpio, uint32_t pin, uint32_t af) { }
+static inline void delay_us(uint32_t us) { }
+
+static inline uint32_t __REV(uint32_t v)
+{
+    return __builtin_bswap32(v);
+}
+
+static inline uint32_t __RBIT(uint32_t v)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < 32; i++, v >>= 1)
+        r = (r << 1) | (v & 1);
+    return r;
+}
+
+/* stm32_power.h */
+typedef enum {
+    STM32_POWER_AHB1,
+    STM32_POWER_APB1,
+} stm32_power_register_t;
+
+void stm32_power_request(stm32_power_register_t reg, uint32_t domain);
+void stm32_power_release(stm32_power_register_t reg, uint32_t domain);
+
+/* stm32_spi.h */
+#define STM32_SPI_DIR_TX 0
+#define STM32_DMA_MK_FLAGS(n_) (n_)
+
+typedef void (*dma_callback)(void);
+
+typedef struct {
+    void *spi;
+    uint32_t spi_periph_bus;
+    uint32_t gpio_pin_miso_num;
+    uint32_t gpio_pin_mosi_num;
+    uint32_t gpio_pin_sck_num;
+    void *gpio_ptr;
+    uint32_t gpio_clock;
+    uint32_t spi_clock;
+    uint32_t af;
+    uint32_t txrx_dir;
+    uint32_t spi_prescaler;
+    uint32_t crc_poly;
+    uint32_t line_polarity;
+} stm32_spi_config_t;
+
+typedef struct {
+    uint32_t dma_clock;
+    void *dma_tx_stream;
+    void *dma_rx_stream;
+    uint32_t dma_tx_channel;
+    uint32_t dma_rx_channel;
+    uint32_t dma_irq_tx_pri;
+    uint32_t dma_irq_rx_pri;
+    uint32_t dma_irq_tx_channel;
+    uint32_t dma_irq_rx_channel;
+    uint32_t dma_tx_channel_flags;
+    uint32_t dma_rx_channel_flags;
+    uint32_t dma_tx_irq_flag;
+    uint32_t dma_rx_irq_flag;
+} stm32_dma_t;
+
+typedef struct {
+    const stm32_spi_config_t *spi;
+    const stm32_dma_t *dma;
+} stm32_spi_t;
+
+/* the test calls this when it finishes a DMA, as the interrupt would */
+#define STM32_SPI_MK_TX_IRQ_HANDLER(spi_, dma_channel_, stream_, callback_) \
+    void tintin_test_dma_done(void) { callback_(); }
+
+void stm32_spi_init_device(stm32_spi_t *spi);
+void stm32_spi_write(stm32_spi_t *spi, unsigned char c);
+void stm32_spi_send_dma(stm32_spi_t *spi, uint8_t *data, size_t len);
+
+/* rebbleos.h */
+#define DRV_LOG(...)
+#define APP_LOG_LEVEL_INFO 0
+#define APP_LOG_LEVEL_DEBUG 0
+
+void display_done_isr(uint8_t cmd);
+void display_done(void);
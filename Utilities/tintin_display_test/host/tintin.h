@@ -0,0 +1,12 @@
+#pragma once
+#include "stm32f2xx.h"
+
+/* the driver's half of hw/platform/tintin/tintin.h */
+void hw_display_init(void);
+void hw_display_reset(void);
+void hw_display_start(void);
+void hw_display_start_frame(uint8_t xoffset, uint8_t yoffset);
+void hw_display_start_frame_rows(uint16_t first_row, uint16_t last_row);
+uint8_t hw_display_get_state(void);
+uint8_t *hw_display_get_buffer(void);
+uint8_t hw_display_process_isr(void);
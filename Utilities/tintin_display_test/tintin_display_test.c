@@ -0,0 +1,270 @@
+/* tintin_display_test.c
+ * Host test for the tintin memory LCD driver, hw/platform/tintin/tintin_display.c
+ * RebbleOS
+ *
+ * The driver is built as it is, against the stand-in headers in host/.
+ * Everything it puts on the SPI bus is kept, and each frame is driven the
+ * way rcore/display.c does it: start the frame, then each time the DMA
+ * finishes, ask the driver for more until it says it is done.
+ *
+ * What went out is played into a model of the panel, which has to end up
+ * matching the framebuffer. And only changed rows may go: a frame costs
+ * the frame start byte, 20 bytes a line and the trailing byte, and a frame
+ * with nothing changed costs nothing, not even powering up SPI2.
+ *
+ *   cc -O2 -I- -I Utilities/tintin_display_test/host \
+ *      -o tintin_display_test Utilities/tintin_display_test/tintin_display_test.c \
+ *      hw/platform/tintin/tintin_display.c
+ *   ./tintin_display_test [seed]
+ *
+ * -I- keeps the driver from finding the real tintin.h next to it.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tintin.h"
+
+#define ROWS 168
+#define ROW_BYTES 20
+#define PIXEL_BYTES 18
+/* frame start, then the 0 after the last line */
+#define FRAME_OVERHEAD 2
+#define FULL_FRAME (FRAME_OVERHEAD + ROWS * ROW_BYTES)
+#define RANDOM_FRAMES 500
+
+void tintin_test_dma_done(void);
+
+static uint8_t _wire[FULL_FRAME * 2];
+static uint32_t _wire_len;
+static uint32_t _dma_count;
+static bool _dma_busy;
+static bool _given;
+static int _spi_powered;
+static bool _spi_woken;
+
+/* what the glass shows */
+static uint8_t _panel[ROWS][PIXEL_BYTES];
+static int _failed;
+
+#define CHECK(cond_, ...) do { if (!(cond_)) { printf("FAIL: " __VA_ARGS__); printf("\n"); _failed++; } } while (0)
+
+/*
+ * The hardware, as far as the driver can tell
+ */
+
+void stm32_power_request(stm32_power_register_t reg, uint32_t domain)
+{
+    if (reg == STM32_POWER_APB1 && domain == RCC_APB1Periph_SPI2)
+    {
+        _spi_powered++;
+        _spi_woken = true;
+    }
+}
+
+void stm32_power_release(stm32_power_register_t reg, uint32_t domain)
+{
+    if (reg == STM32_POWER_APB1 && domain == RCC_APB1Periph_SPI2)
+        _spi_powered--;
+}
+
+void stm32_spi_init_device(stm32_spi_t *spi)
+{
+}
+
+static void _wire_put(const uint8_t *data, size_t len)
+{
+    CHECK(_spi_powered > 0, "sent %zu bytes with SPI2 off", len);
+    if (_wire_len + len > sizeof(_wire))
+    {
+        CHECK(0, "more than two full frames in one");
+        return;
+    }
+    memcpy(_wire + _wire_len, data, len);
+    _wire_len += len;
+}
+
+void stm32_spi_write(stm32_spi_t *spi, unsigned char c)
+{
+    _wire_put(&c, 1);
+}
+
+void stm32_spi_send_dma(stm32_spi_t *spi, uint8_t *data, size_t len)
+{
+    CHECK(!_dma_busy, "DMA started while one is running");
+    _wire_put(data, len);
+    _dma_count++;
+    _dma_busy = true;
+}
+
+/* rcore/display.c's side */
+void display_done_isr(uint8_t cmd)
+{
+    CHECK(_dma_busy, "display_done_isr with no DMA running, so not from an interrupt");
+    _given = true;
+}
+
+void display_done(void)
+{
+    CHECK(!_dma_busy, "display_done while a DMA is running");
+    _given = true;
+}
+
+/*
+ * The test
+ */
+
+static uint8_t _reverse(uint8_t b)
+{
+    uint8_t r = 0;
+    for (int i = 0; i < 8; i++, b >>= 1)
+        r = (r << 1) | (b & 1);
+    return r;
+}
+
+/* one frame, as display.c sends it. Returns the bytes that went out */
+static uint32_t _frame(uint16_t first_row, uint16_t last_row)
+{
+    _wire_len = 0;
+    _dma_count = 0;
+    _spi_woken = false;
+    _given = false;
+
+    hw_display_start_frame_rows(first_row, last_row);
+    for (;;)
+    {
+        /* the interrupt runs while the DMA is still the one that finished */
+        if (_dma_busy)
+        {
+            tintin_test_dma_done();
+            _dma_busy = false;
+        }
+        if (!_given)
+        {
+            CHECK(0, "frame stalled: no DMA running and nothing given");
+            break;
+        }
+        _given = false;
+        if (hw_display_process_isr())
+            break;
+    }
+
+    CHECK(_spi_powered == 0, "SPI2 left powered %d times after the frame", _spi_powered);
+    CHECK(!_wire_len || !_dma_busy, "frame done with a DMA running");
+
+    /* and onto the glass */
+    if (!_wire_len)
+        return 0;
+
+    CHECK(_wire[0] == 0x80, "frame doesn't start with the frame start byte");
+    CHECK(_wire[_wire_len - 1] == 0, "frame doesn't end with a 0");
+    CHECK((_wire_len - FRAME_OVERHEAD) % ROW_BYTES == 0, "%u bytes isn't whole lines", _wire_len);
+
+    for (uint32_t at = 1; at + ROW_BYTES <= _wire_len - 1; at += ROW_BYTES)
+    {
+        uint8_t *line = _wire + at;
+        int row = ROWS - _reverse(line[0]);
+        CHECK(row >= 0 && row < ROWS, "line address %02x is off the panel", line[0]);
+        CHECK(line[ROW_BYTES - 1] == 0, "line for row %d doesn't end with a 0", row);
+        if (row < 0 || row >= ROWS)
+            continue;
+        for (int j = 0; j < PIXEL_BYTES; j++)
+            _panel[row][PIXEL_BYTES - 1 - j] = line[1 + j];
+    }
+
+    return _wire_len;
+}
+
+static bool _panel_matches(void)
+{
+    uint8_t *fb = hw_display_get_buffer();
+
+    for (int row = 0; row < ROWS; row++)
+        if (memcmp(_panel[row], fb + row * ROW_BYTES, PIXEL_BYTES))
+        {
+            printf("row %d on the panel isn't what is in the framebuffer\n", row);
+            return false;
+        }
+    return true;
+}
+
+static void _scribble(int row)
+{
+    uint8_t *fb = hw_display_get_buffer();
+    fb[row * ROW_BYTES + rand() % PIXEL_BYTES] ^= 1 << (rand() % 8);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned seed = argc > 1 ? atoi(argv[1]) : time(NULL);
+    uint8_t *fb = hw_display_get_buffer();
+    uint32_t bytes;
+
+    srand(seed);
+    printf("seed %u\n", seed);
+    hw_display_init();
+    for (int i = 0; i < ROWS * ROW_BYTES; i++)
+        fb[i] = rand();
+
+    /* the panel could be showing anything, so all of it goes, whatever the range */
+    bytes = _frame(10, 20);
+    CHECK(bytes == FULL_FRAME, "first frame sent %u bytes, want %u", bytes, FULL_FRAME);
+    CHECK(_panel_matches(), "after the first frame");
+
+    bytes = _frame(0, ROWS - 1);
+    CHECK(bytes == 0 && !_spi_woken, "unchanged frame sent %u bytes, SPI2 %s", bytes, _spi_woken ? "woken" : "asleep");
+
+    _scribble(42);
+    bytes = _frame(0, ROWS - 1);
+    CHECK(bytes == FRAME_OVERHEAD + ROW_BYTES && _dma_count == 1, "one row sent %u bytes in %u DMAs", bytes, _dma_count);
+
+    /* adjacent rows go in one DMA */
+    _scribble(5);
+    _scribble(100);
+    _scribble(101);
+    bytes = _frame(0, ROWS - 1);
+    CHECK(bytes == FRAME_OVERHEAD + 3 * ROW_BYTES && _dma_count == 2, "three rows sent %u bytes in %u DMAs", bytes, _dma_count);
+    CHECK(_panel_matches(), "after changing rows");
+
+    /* changes outside the range wait for a frame that covers them */
+    _scribble(60);
+    bytes = _frame(0, 30);
+    CHECK(bytes == 0, "row outside the range sent %u bytes", bytes);
+    bytes = _frame(0, ROWS - 1);
+    CHECK(bytes == FRAME_OVERHEAD + ROW_BYTES, "row left from before sent %u bytes", bytes);
+
+    hw_display_reset();
+    bytes = _frame(0, 0);
+    CHECK(bytes == FULL_FRAME, "frame after a reset sent %u bytes, want %u", bytes, FULL_FRAME);
+
+    uint64_t sent = 0, full = 0;
+    for (int f = 0; f < RANDOM_FRAMES; f++)
+    {
+        bool changed[ROWS] = { false };
+        int count = 0, n = rand() % 8 ? rand() % 6 : rand() % ROWS;
+
+        for (int i = 0; i < n; i++)
+        {
+            int row = rand() % ROWS;
+            _scribble(row);
+            changed[row] = true;
+        }
+        /* a bit flipped twice comes out the same, so count what really changed */
+        for (int row = 0; row < ROWS; row++)
+            count += changed[row] && memcmp(_panel[row], fb + row * ROW_BYTES, PIXEL_BYTES) != 0;
+
+        bytes = _frame(0, ROWS - 1);
+        CHECK(bytes == (count ? FRAME_OVERHEAD + count * ROW_BYTES : 0),
+              "frame %d: %d rows changed, sent %u bytes", f, count, bytes);
+        sent += bytes;
+        full += FULL_FRAME;
+    }
+    CHECK(_panel_matches(), "after %d random frames", RANDOM_FRAMES);
+    printf("%d random frames: sent %llu bytes, %.1f%% of sending every row\n",
+           RANDOM_FRAMES, (unsigned long long)sent, 100.0 * sent / full);
+
+    printf(_failed ? "%d failed\n" : "ok\n", _failed);
+    return _failed != 0;
+}
@@ -15,12 +15,14 @@
 // const char *app_name = "Simple";
 
 static void nivz_update_proc(Layer *layer, GContext *ctx);
+static void nivz_background_update_proc(Layer *layer, GContext *ctx);
 void nivz_main(void);
 void nivz_init(void);
 void nivz_deinit(void);
 void nivz_tick(struct tm *tick_time, TimeUnits tick_units);
 
 static Window *s_main_window;
+static Layer *s_background_layer;
 static Layer *s_canvas_layer;
 static TextLayer *s_text_layer;
 
@@ -37,6 +39,13 @@ static void nivz_window_load(Window *window)
     Layer *window_layer = window_get_root_layer(s_main_window);
     GRect bounds = layer_get_unobstructed_bounds(window_layer);
 
+    // the digits get new colours every second, but what is under them never
+    // changes, so keep a copy of that rather than repaint it
+    s_background_layer = layer_create(bounds);
+    layer_set_update_proc(s_background_layer, nivz_background_update_proc);
+    layer_set_cached(s_background_layer, true);
+    layer_add_child(window_layer, s_background_layer);
+
     s_canvas_layer = layer_create(bounds);
     layer_set_update_proc(s_canvas_layer, nivz_update_proc);
     layer_add_child(window_layer, s_canvas_layer);
@@ -55,6 +64,7 @@ static void nivz_window_load(Window *window)
 static void nivz_window_unload(Window *window)
 {
     layer_destroy(s_canvas_layer);
+    layer_destroy(s_background_layer);
 }
 
 // tick
@@ -182,6 +192,14 @@ void draw_digit(GContext *nGContext, uint8_t d, uint8_t x, uint8_t y)
 }
 
 
+static void nivz_background_update_proc(Layer *layer, GContext *nGContext)
+{
+  // Clear the screen
+  graphics_context_set_fill_color(nGContext, GColorBlack);
+  graphics_fill_rect(nGContext, layer_get_bounds(layer), 0, GCornerNone);
+}
+
+
 static void nivz_update_proc(Layer *layer, GContext *nGContext)
 {
   // Get the time
@@ -189,9 +207,6 @@ static void nivz_update_proc(Layer *layer, GContext *nGContext)
   uint8_t minute = s_last_time.minutes;
   
   GRect full_bounds = layer_get_bounds(layer);
-  // Clear the screen
-  graphics_context_set_fill_color(nGContext, GColorBlack);
-  graphics_fill_rect(nGContext, full_bounds, 0, GCornerNone);
   
   // Draw the Hours 
   draw_digit(nGContext, (int)(hour/10), (full_bounds.size.w/2) - 52, (full_bounds.size.h/2) - 82);
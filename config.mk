@@ -34,6 +34,12 @@ CFLAGS_all += -O0 -ggdb -Wall -ffunction-sections -fdata-sections -mthumb -mlitt
 # CFLAGS_all += -Wno-implicit-function-declaration
 CFLAGS_all += -Wno-unused-variable -Wno-unused-function
 
+# Set LOG_TOKENIZED = 1 in localconfig.mk to send system logs as tokens
+# rather than text. It saves the flash the strings take and most of the
+# UART time; read the output with
+#   Utilities/logdecode.py build/<platform>/tintin_fw.logdict
+CFLAGS_all += $(if $(LOG_TOKENIZED),-DLOG_TOKENIZED)
+
 LDFLAGS_all += -nostartfiles -nostdlib
 LIBS_all += -lgcc
 
@@ -90,6 +96,8 @@ SRCS_all += rcore/appmanager_app_runloop.c
 SRCS_all += rcore/appmanager_app_timer.c
 SRCS_all += rcore/backlight.c
 SRCS_all += rcore/bluetooth.c
+SRCS_all += rcore/bt_rx_stream.c
+SRCS_all += rcore/bt_tx_ring.c
 SRCS_all += rcore/buttons.c
 SRCS_all += rcore/display.c
 SRCS_all += rcore/debug.c
@@ -111,6 +119,7 @@ SRCS_all += rcore/watchdog.c
 SRCS_all += rcore/overlay_manager.c
 SRCS_all += rcore/rebble_util.c
 
+SRCS_all += rcore/protocol/endpoint.c
 SRCS_all += rcore/protocol/protocol_notification.c
 SRCS_all += rcore/protocol/protocol_system.c
 
@@ -129,6 +138,8 @@ SRCS_all += rwatch/ui/window.c
 SRCS_all += rwatch/ui/action_menu.c
 SRCS_all += rwatch/graphics/gbitmap.c
 SRCS_all += rwatch/graphics/graphics.c
+SRCS_all += rwatch/graphics/draw_list.c
+SRCS_all += rwatch/graphics/fb8.c
 SRCS_all += rwatch/graphics/font_loader.c
 SRCS_all += rwatch/event/tick_timer_service.c
 SRCS_all += rwatch/event/app_timer.c
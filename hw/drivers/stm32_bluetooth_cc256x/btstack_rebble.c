@@ -28,6 +28,7 @@
 #endif
 
 static uint16_t  rfcomm_channel_id;
+static uint16_t  rfcomm_mtu;
 static uint8_t   spp_service_buffer[98];
 static uint8_t   le_notification_enabled;
 static hci_con_handle_t att_con_handle;
@@ -38,9 +39,15 @@ static int att_write_callback(hci_con_handle_t con_handle, uint16_t att_handle,
 static uint8_t _bt_enabled = 0;
 static btstack_packet_callback_registration_t hci_event_callback_registration;
 
-/* TX outboung buffer pointer.  */
+/* TX outboung buffer pointer. Only good until we say the TX is complete,
+ * or the sender cancels. The BT thread holds the lock while it sends from
+ * it, so a cancel can't land halfway through.
+ * Only RFCOMM completes a TX. LE notifies and leaves the buffer up for the
+ * phone to read the rest of, as it always did */
 static uint8_t *_tx_buf = NULL;
-static uint8_t _tx_buf_len = 0;
+static uint16_t _tx_buf_len = 0;
+static SemaphoreHandle_t _tx_buf_mutex;
+static StaticSemaphore_t _tx_buf_mutex_buf;
 
 /* BTStack handlers */
 static void dummy_handler(void);
@@ -91,6 +98,8 @@ uint8_t adv_data_len = sizeof(adv_data);
  */
 void bt_device_init(void)
 {
+    _tx_buf_mutex = xSemaphoreCreateMutexStatic(&_tx_buf_mutex_buf);
+
 #if BLUETOOTH_MODULE_TYPE==BLUETOOTH_MODULE_TYPE_NONE
     return;
 #endif
@@ -170,18 +179,27 @@ void bt_device_init(void)
 
 /*
  * Request we send some data over bluetooth
- * This will return immediately, it wil then be sent async
+ * This will return immediately, it wil then be sent async.
+ * False if it is too big to ever go, and won't be completed
  */
-void bt_device_request_tx(uint8_t *data, uint16_t len)
+bool bt_device_request_tx(uint8_t *data, uint16_t len)
 {
     if (len > HCI_ACL_PAYLOAD_SIZE)
     {
         SYS_LOG("BTSPP", APP_LOG_LEVEL_ERROR, "Data size %d > buffer size %d", len, HCI_ACL_PAYLOAD_SIZE);
-        return;
+        return false;
+    }
+
+    if (rfcomm_channel_id && len > rfcomm_mtu)
+    {
+        SYS_LOG("BTSPP", APP_LOG_LEVEL_ERROR, "Data size %d > RFCOMM frame size %d", len, rfcomm_mtu);
+        return false;
     }
 
+    xSemaphoreTake(_tx_buf_mutex, portMAX_DELAY);
     _tx_buf = data;
     _tx_buf_len = len;
+    xSemaphoreGive(_tx_buf_mutex);
     
     /*
      * Call up BTStack and tell it to tell us we can send
@@ -195,6 +213,24 @@ void bt_device_request_tx(uint8_t *data, uint16_t len)
     {
         att_server_request_can_send_now_event(att_con_handle);
     }
+
+    return true;
+}
+
+/*
+ * The sender has given up waiting and wants its buffer back. Once this
+ * returns the BT thread won't send from it. False if it was too late
+ * and the stack already has it, in which case it was completed as usual
+ */
+bool bt_device_cancel_tx(void)
+{
+    xSemaphoreTake(_tx_buf_mutex, portMAX_DELAY);
+    bool pending = _tx_buf_len != 0;
+    _tx_buf = NULL;
+    _tx_buf_len = 0;
+    xSemaphoreGive(_tx_buf_mutex);
+
+    return pending;
 }
 
 /*
@@ -290,13 +326,24 @@ void bluetooth_power_cycle(void)
  */
 
 /* TX Was completed. 
- * Call the BTStack implementation callback
- * Call the bluetooth handler tx callback
+ * Call the BTStack implementation callback.
+ * This is any block to the chip, HCI included, so it says nothing
+ * about our packets; they are done when the stack takes its copy
  */
 void bt_stack_tx_done()
 {
     (*tx_done_handler)();
-    bluetooth_tx_complete_from_isr();
+}
+
+/*
+ * The stack has copied the packet out, the sender can have it back.
+ * Call with _tx_buf_mutex held
+ */
+static void _tx_taken(void)
+{
+    _tx_buf = NULL;
+    _tx_buf_len = 0;
+    bluetooth_tx_complete();
 }
 
 /*
@@ -330,7 +377,10 @@ static uint16_t att_read_callback(hci_con_handle_t con_handle, uint16_t att_hand
 
     if (att_handle == ATT_CHARACTERISTIC_0000FF11_0000_1000_8000_00805F9B34FB_01_VALUE_HANDLE)
     {
-        return att_read_callback_handle_blob((const uint8_t *)_tx_buf, _tx_buf_len, offset, buffer, buffer_size);
+        xSemaphoreTake(_tx_buf_mutex, portMAX_DELAY);
+        uint16_t n = att_read_callback_handle_blob((const uint8_t *)_tx_buf, _tx_buf_len, offset, buffer, buffer_size);
+        xSemaphoreGive(_tx_buf_mutex);
+        return n;
     }
     return 0;
 }
@@ -367,8 +417,6 @@ static int att_write_callback(hci_con_handle_t con_handle, uint16_t att_handle,
 static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size)
 {
     bd_addr_t event_addr;
-    uint16_t  mtu;
-    int i;
     uint8_t event;
 
     if (packet_type == HCI_EVENT_PACKET)
@@ -416,9 +464,12 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packe
                 case ATT_EVENT_CAN_SEND_NOW:
                     SYS_LOG("BTSPP", APP_LOG_LEVEL_INFO, "ATT %d %d", packet_type, channel);
                     
-                    if (_tx_buf_len == 0)
-                        break;
-                    att_server_notify(att_con_handle, ATT_CHARACTERISTIC_0000FF11_0000_1000_8000_00805F9B34FB_01_VALUE_HANDLE, (uint8_t*)  _tx_buf, _tx_buf_len);
+                    /* A notify only carries the first MTU-3 bytes, the phone
+                     * reads the rest, so the buffer has to stay where it is */
+                    xSemaphoreTake(_tx_buf_mutex, portMAX_DELAY);
+                    if (_tx_buf_len)
+                        att_server_notify(att_con_handle, ATT_CHARACTERISTIC_0000FF11_0000_1000_8000_00805F9B34FB_01_VALUE_HANDLE, (uint8_t*)  _tx_buf, _tx_buf_len);
+                    xSemaphoreGive(_tx_buf_mutex);
                     break;
 
                 case RFCOMM_EVENT_INCOMING_CONNECTION:
@@ -440,20 +491,37 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packe
                     else
                     {
                         rfcomm_channel_id = rfcomm_event_channel_opened_get_rfcomm_cid(packet);
-                        mtu = rfcomm_event_channel_opened_get_max_frame_size(packet);
-                        SYS_LOG("BTSPP", APP_LOG_LEVEL_INFO, "RFCOMM channel open succeeded. New RFCOMM Channel ID %d, max frame size %d", rfcomm_channel_id, mtu);
+                        rfcomm_mtu = rfcomm_event_channel_opened_get_max_frame_size(packet);
+                        SYS_LOG("BTSPP", APP_LOG_LEVEL_INFO, "RFCOMM channel open succeeded. New RFCOMM Channel ID %d, max frame size %d", rfcomm_channel_id, rfcomm_mtu);
                         bluetooth_device_connected();
                     }
                     break;
 
                 case RFCOMM_EVENT_CAN_SEND_NOW:
                     /* We have been instructed to send data safely. We;re ready */
-                    rfcomm_send(rfcomm_channel_id, _tx_buf, _tx_buf_len);
+                    xSemaphoreTake(_tx_buf_mutex, portMAX_DELAY);
+                    if (_tx_buf_len)
+                    {
+                        uint8_t err = rfcomm_send(rfcomm_channel_id, _tx_buf, _tx_buf_len);
+                        if (!err)
+                        {
+                            _tx_taken();
+                        }
+                        else
+                        {
+                            /* still ours, try again. If it never goes the sender
+                             * times out and cancels */
+                            SYS_LOG("BTSPP", APP_LOG_LEVEL_ERROR, "RFCOMM send failed %d", err);
+                            rfcomm_request_can_send_now_event(rfcomm_channel_id);
+                        }
+                    }
+                    xSemaphoreGive(_tx_buf_mutex);
                     break;
 
                 case RFCOMM_EVENT_CHANNEL_CLOSED:
                     SYS_LOG("BTSPP", APP_LOG_LEVEL_INFO, "RFCOMM channel closed");
                     rfcomm_channel_id = 0;
+                    rfcomm_mtu = 0;
                     bluetooth_device_disconnected();
                     break;
                 
@@ -463,12 +531,8 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packe
             break;
                 
         case RFCOMM_DATA_PACKET:
-            SYS_LOG("BTSPP", APP_LOG_LEVEL_INFO, "RCV: '");
-            for (i = 0; i < size; i++)
-            {
-                SYS_LOG("BTSPP", APP_LOG_LEVEL_INFO, "0x%x", packet[i]);
-            }
-            
+            SYS_LOG("BTSPP", APP_LOG_LEVEL_DEBUG, "RCV: %d bytes", size);
+
             /* pack the packet onto the bluetooth generic handler */
             bluetooth_data_rx(packet, size);
             break;
@@ -9,5 +9,10 @@ uint8_t hw_bluetooth_init() {
     
 }
 
-void bt_device_request_tx() {
+bool bt_device_request_tx(uint8_t *data, uint16_t len) {
+    return false;
+}
+
+bool bt_device_cancel_tx(void) {
+    return false;
 }
@@ -14,6 +14,10 @@
 //We are a square device
 #define PBL_RECT
 
+/* Render to a back buffer while the last frame is sent.
+ * Chalk has no room for the second buffer, and stays single buffered */
+#define DISPLAY_DOUBLE_BUFFER
+
 extern unsigned char _binary_Resources_snowy_fpga_bin_size;
 extern unsigned char _binary_Resources_snowy_fpga_bin_start;
 #define DISPLAY_FPGA_ADDR &_binary_Resources_snowy_fpga_bin_start
@@ -58,8 +58,10 @@
  * This does mean we can't (not that we could) dma from CCRAM to the SPI.
  * It's an unsupported hardware config for stm32 at least
  */
-static uint8_t _frame_buffer[DISPLAY_ROWS * DISPLAY_COLS] CCRAM;
-static uint8_t _column_buffer[DISPLAY_ROWS];
+static uint8_t _frame_buffer[DISPLAY_ROWS * DISPLAY_COLS] CCRAM __attribute__((aligned(4)));
+/* Ping-pong column buffers. One is on the wire while the next
+ * column is converted into the other */
+static uint8_t _column_buffer[2][DISPLAY_ROWS] __attribute__((aligned(4)));
 static uint8_t _display_ready;
 
 void _snowy_display_start_frame(uint8_t xoffset, uint8_t yoffset);
@@ -293,12 +295,16 @@ void _snowy_display_cs(uint8_t enabled)
 }
 
 /*
- * Given a column index, start the conversion of the display data and dma it
+ * Given a column index, dma its already converted data, then
+ * convert the next column while that goes out.
+ * Column 0 is converted by _snowy_display_send_frame
  */
 void _snowy_display_next_column(uint8_t col_index)
 {   
-    scanline_convert(_column_buffer, _frame_buffer, col_index);
-    stm32_spi_send_dma(&_spi6, _column_buffer, DISPLAY_ROWS);
+    stm32_spi_send_dma(&_spi6, _column_buffer[col_index & 1], DISPLAY_ROWS);
+    
+    if (col_index + 1 < DISPLAY_COLS)
+        scanline_convert(_column_buffer[(col_index + 1) & 1], _frame_buffer, col_index + 1);
 }
 
 /*
@@ -421,6 +427,7 @@ void _snowy_display_send_frame()
      * we are only going to send one single column at a time
      * the dma engine completion will trigger the next lot of data to go
      */
+    scanline_convert(_column_buffer[0], _frame_buffer, 0);
     _snowy_display_next_column(0);
     /* we return immediately and let the system take care of the rest */
 }
@@ -443,9 +450,9 @@ void _snowy_display_send_frame_slow()
     /* send via standard SPI */
     for(uint8_t x = 0; x < DISPLAY_COLS; x++)
     {
-        scanline_convert(_column_buffer, _frame_buffer, x);
+        scanline_convert(_column_buffer[0], _frame_buffer, x);
         for (uint8_t j = 0; j < DISPLAY_ROWS; j++)
-            stm32_spi_write(&_spi6, _column_buffer[j]);
+            stm32_spi_write(&_spi6, _column_buffer[0][j]);
     }   
     
     _snowy_display_cs(0);
@@ -475,7 +482,7 @@ uint8_t _snowy_display_wait_FPGA_ready(void)
         if (!--i)
         {
             char *err = "Timed out waiting for ready";
-            DRV_LOG("FPGA", APP_LOG_LEVEL_ERROR, err);
+            DRV_LOG("FPGA", APP_LOG_LEVEL_ERROR, "%s", err);
             return 0;
         }
         delay_us(100);
@@ -571,6 +578,15 @@ void hw_display_start_frame(uint8_t xoffset, uint8_t yoffset)
     _snowy_display_start_frame(xoffset, yoffset);
 }
 
+/*
+ * The FPGA only knows how to draw a whole frame, so the rows
+ * hint can't save us anything here
+ */
+void hw_display_start_frame_rows(uint16_t first_row, uint16_t last_row)
+{
+    _snowy_display_start_frame(0, 0);
+}
+
 uint8_t *hw_display_get_buffer(void)
 {
     return _frame_buffer;
@@ -10,6 +10,8 @@
 #include "platform.h"
 
 #define MAX_FRAMEBUFFER_SIZE DISPLAY_ROWS * DISPLAY_COLS
+#define DISPLAY_ROW_BYTES DISPLAY_COLS
+#define DISPLAY_FRAMEBUFFER_SIZE (DISPLAY_ROWS * DISPLAY_ROW_BYTES)
 
 void hw_display_init(void);
 void hw_display_reset(void);
@@ -20,6 +22,7 @@ uint8_t hw_display_process_isr(void);
 
 void hw_display_on();
 void hw_display_start_frame(uint8_t xoffset, uint8_t yoffset);
+void hw_display_start_frame_rows(uint16_t first_row, uint16_t last_row);
 
 // TODO: move to scanline
 void scanline_convert(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t column_index);
@@ -10,6 +10,7 @@
 #include "string.h"
 #include "display.h"
 #include "snowy_display.h"
+#include "stm32f4xx.h"
 
 /*
  * Bulk convert the buffer from its native format for a sigle column
@@ -82,12 +83,91 @@ void _scanline_convert_column(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_
     }
 }
 
+/*
+ * Word at a time versions of the above. The mask and shift never carry
+ * a bit across a byte, so 4 pixels can go through in one 32 bit op.
+ * The plain versions above are the reference; build with
+ * -DSCANLINE_REFERENCE to use them instead.
+ *
+ * Both need the framebuffer and out_buffer word aligned.
+ */
+#define _LSB_MASK 0x2A2A2A2AUL
+#define _MSB_MASK 0x15151515UL
+
+#if (DISPLAY_ROWS % 8) == 0
+/*
+ * Row pair k (rows 2k and 2k+1) lands at halfy = halfrows - 1 - k,
+ * so four pairs fill one output word, backwards.
+ * The word is built with the highest pair in the lowest byte so a
+ * straight store puts them in order
+ */
+void _scanline_convert_column_fast(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t column_index)
+{
+    const uint16_t halfrows = DISPLAY_ROWS / 2;
+    uint32_t *out_lsb = (uint32_t *)out_buffer;
+    uint32_t *out_msb = (uint32_t *)(out_buffer + halfrows);
+    const uint8_t *col = frame_buffer + column_index;
+
+    for (uint16_t k = 0; k < halfrows; k += 4)
+    {
+        const uint8_t *p = col + 2 * k * DISPLAY_COLS;
+        uint32_t r0 = p[6 * DISPLAY_COLS] | p[4 * DISPLAY_COLS] << 8 |
+                      p[2 * DISPLAY_COLS] << 16 | p[0] << 24;
+        uint32_t r1 = p[7 * DISPLAY_COLS] | p[5 * DISPLAY_COLS] << 8 |
+                      p[3 * DISPLAY_COLS] << 16 | p[1 * DISPLAY_COLS] << 24;
+        uint16_t w = (halfrows - 4 - k) / 4;
+
+        out_lsb[w] = (r0 & _LSB_MASK) >> 1 | (r1 & _LSB_MASK);
+        out_msb[w] = (r0 & _MSB_MASK) | (r1 & _MSB_MASK) << 1;
+    }
+}
+#endif
+
+#if (DISPLAY_COLS % 4) == 0
+/*
+ * A word load gets two pixel pairs [r1 r0 r1 r0].
+ * Split out each half into 16 bit lanes, then fold the lanes
+ * back into two bytes of output
+ */
+void _scanline_convert_row_fast(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t row_index)
+{
+    const uint32_t *in = (const uint32_t *)(frame_buffer + row_index * DISPLAY_COLS);
+    uint16_t *out_lsb = (uint16_t *)out_buffer;
+    uint16_t *out_msb = (uint16_t *)(out_buffer + DISPLAY_COLS / 2);
+
+    for (uint16_t i = 0; i < DISPLAY_COLS / 4; i++)
+    {
+        uint32_t w = in[i];
+#if defined(__ARM_FEATURE_DSP)
+        uint32_t r1 = __UXTB16(w);
+        uint32_t r0 = __UXTB16(w >> 8);
+#else
+        uint32_t r1 = w & 0x00FF00FFUL;
+        uint32_t r0 = (w >> 8) & 0x00FF00FFUL;
+#endif
+        uint32_t lsb = (r0 & _LSB_MASK) >> 1 | (r1 & _LSB_MASK);
+        uint32_t msb = (r0 & _MSB_MASK) | (r1 & _MSB_MASK) << 1;
+        
+        out_lsb[i] = (lsb | lsb >> 8) & 0xFFFF;
+        out_msb[i] = (msb | msb >> 8) & 0xFFFF;
+    }
+}
+#endif
+
 void scanline_convert(uint8_t *out_buffer, uint8_t *frame_buffer, uint8_t index)
 {
 #if defined(REBBLE_PLATFORM_CHALK)
+#  if (DISPLAY_COLS % 4) == 0 && !defined(SCANLINE_REFERENCE)
+    _scanline_convert_row_fast(out_buffer, frame_buffer, index);
+#  else
     _scanline_convert_row(out_buffer, frame_buffer, index);
+#  endif
 #elif defined(REBBLE_PLATFORM_SNOWY)
+#  if (DISPLAY_ROWS % 8) == 0 && !defined(SCANLINE_REFERENCE)
+    _scanline_convert_column_fast(out_buffer, frame_buffer, index);
+#  else
     _scanline_convert_column(out_buffer, frame_buffer, index);
+#  endif
 #else
     assert(!"I don't know how to drive this platform!");
 #endif
@@ -8,6 +8,12 @@
 #define DISPLAY_ROWS 168
 #define DISPLAY_COLS 144
 
+/* 18 bytes of pixels, padded to 20 per row */
+#define DISPLAY_ROW_BYTES 20
+#define DISPLAY_FRAMEBUFFER_SIZE (DISPLAY_ROWS * DISPLAY_ROW_BYTES)
+/* Render to a back buffer while the last frame is sent */
+#define DISPLAY_DOUBLE_BUFFER
+
 #define REGION_PRF_START    0x200000
 #define REGION_PRF_SIZE     0x1000000
 // DO NOT WRITE TO THIS REGION
@@ -25,6 +25,7 @@ void hw_display_init();
 void hw_display_reset();
 void hw_display_start();
 void hw_display_start_frame(uint8_t xoffset, uint8_t yoffset);
+void hw_display_start_frame_rows(uint16_t first_row, uint16_t last_row);
 uint8_t hw_display_get_state();
 uint8_t *hw_display_get_buffer(void);
 uint8_t hw_display_process_isr(void);
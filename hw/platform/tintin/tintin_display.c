@@ -23,13 +23,6 @@
 /* comment out of you don't want DMA */
 #define DMA_ENABLED
 
-/* How many rows do we want to send at once 
- * NOTE: This is going to use more buffer ram the biggger you go
- * also make sure its divisible by 168 lest you be doomed to 
- * sending too many bytes and having to fix it.
- */
-#define _DMA_ROW_COUNT 8
-
 static const stm32_spi_config_t _spi2_config = {
     .spi                  = SPI2,
     .spi_periph_bus       = STM32_POWER_APB1,
@@ -71,7 +64,7 @@ static stm32_spi_t _spi2 = {
 #endif
 };
 
-static void _send_next(uint32_t row);
+static void _send_next(void);
 static void _spi_tx_done(void);
 
 /* TX ISR for DMA */
@@ -87,9 +80,33 @@ STM32_SPI_MK_TX_IRQ_HANDLER(&_spi2, 1, 4, _spi_tx_done)
 static uint8_t _display_fb[168][20];
 static void _hw_display_start_frame_dma(uint8_t x, uint8_t y);
 
+/* The next row to send, and the last row of this update */
+static uint16_t _row_next;
+static uint16_t _row_last;
+
+/* What the panel is currently showing, already in wire order.
+ * Each row is [line address][18 bytes, reversed][0], so a run of rows
+ * can be DMAed straight out of here. Rows that still match aren't sent */
+static uint8_t _wire_fb[168][20];
+static uint8_t _shadow_valid;
+
+/* One bit per row to send in this update, and how many are left */
+static uint32_t _dirty_rows[(168 + 31) / 32];
+static uint16_t _dirty_count;
+static uint8_t _sending;
+
+#define _ROW_IS_DIRTY(row) (_dirty_rows[(row) >> 5] & (1UL << ((row) & 31)))
+
 void hw_display_init() {
     DRV_LOG("Display", APP_LOG_LEVEL_INFO, "tintin: hw_display_init");
 
+    /* the line addresses never change, so work them out once */
+    for (int i = 0; i < 168; i++)
+    {
+        _wire_fb[i][0] = __RBIT(__REV(168 - i));
+        _wire_fb[i][19] = 0;
+    }
+
     stm32_power_request(STM32_POWER_AHB1, RCC_AHB1Periph_GPIOB);
     stm32_power_request(STM32_POWER_AHB1, RCC_AHB1Periph_GPIOC);
 
@@ -121,6 +138,8 @@ void hw_display_init() {
 
 void hw_display_reset() {
     DRV_LOG("Display", APP_LOG_LEVEL_INFO, "tintin: hw_display_reset");
+    /* we no longer know what the panel shows */
+    _shadow_valid = 0;
 }
 
 void hw_display_start() {
@@ -128,22 +147,84 @@ void hw_display_start() {
 }
 
 void hw_display_start_frame(uint8_t x, uint8_t y) {
+    hw_display_start_frame_rows(0, 167);
+}
+
+/*
+ * Pack the rows in the range into wire order, noting which ones
+ * differ from what the panel shows.
+ * This happens once per frame in the display thread, not in the DMA path
+ */
+static void _diff_rows(uint16_t first_row, uint16_t last_row) {
+    uint8_t packed[18];
+
+    memset(_dirty_rows, 0, sizeof(_dirty_rows));
+    _dirty_count = 0;
+    
+    for (uint16_t row = first_row; row <= last_row; row++)
+    {
+        for (int j = 0; j < 18; j++)
+            packed[j] = _display_fb[row][17 - j];
+
+        if (_shadow_valid && !memcmp(&_wire_fb[row][1], packed, 18))
+            continue;
+        
+        memcpy(&_wire_fb[row][1], packed, 18);
+        _dirty_rows[row >> 5] |= 1UL << (row & 31);
+        _dirty_count++;
+    }
+    _shadow_valid = 1;
+}
+
+/*
+ * The panel takes any set of lines after a frame start,
+ * so only send the rows in the range that have changed
+ */
+void hw_display_start_frame_rows(uint16_t first_row, uint16_t last_row) {
+    /* Until we know what is on the panel, everything is sent */
+    if (!_shadow_valid)
+    {
+        first_row = 0;
+        last_row = 167;
+    }
+    _row_next = first_row;
+    _row_last = last_row > 167 ? 167 : last_row;
+
+#ifdef DISPLAY_DEBUG_STATS
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    uint32_t cycles = DWT->CYCCNT;
+    _diff_rows(_row_next, _row_last);
+    DRV_LOG("Display", APP_LOG_LEVEL_DEBUG, "tintin: %d rows changed, packed in %d cycles",
+            _dirty_count, DWT->CYCCNT - cycles);
+#else
+    _diff_rows(_row_next, _row_last);
+#endif
+    
+    if (_dirty_count == 0)
+    {
+        /* nothing to say. Don't even wake the SPI */
+        _sending = 0;
+        display_done();
+        return;
+    }
+    _sending = 1;
 #ifdef DMA_ENABLED
-    _hw_display_start_frame_dma(x, y);
+    _hw_display_start_frame_dma(0, 0);
     return;
 #else
     stm32_power_request(STM32_POWER_AHB1, RCC_AHB1Periph_GPIOB);
     stm32_power_request(STM32_POWER_APB1, RCC_APB1Periph_SPI2);
 
-    DRV_LOG("Display", APP_LOG_LEVEL_DEBUG, "tintin: here we go, slowly blitting %d %d", x, y);
+    DRV_LOG("Display", APP_LOG_LEVEL_DEBUG, "tintin: here we go, slowly blitting %d rows", _dirty_count);
     GPIO_WriteBit(GPIOB, 1 << DISPLAY_CS, 1);
     delay_us(7);
     stm32_spi_write(&_spi2, DISPLAY_FRAME_START);
     for (int i = 0; i < 168; i++) {
-        stm32_spi_write(&_spi2, __RBIT(__REV(168-i)));
-        for (int j = 0; j < 18; j++)
-            stm32_spi_write(&_spi2, _display_fb[i][17-j]);
-        stm32_spi_write(&_spi2, 0);
+        if (!_ROW_IS_DIRTY(i))
+            continue;
+        for (int j = 0; j < 20; j++)
+            stm32_spi_write(&_spi2, _wire_fb[i][j]);
     }
     stm32_spi_write(&_spi2, 0);
     delay_us(7);
@@ -152,7 +233,9 @@ void hw_display_start_frame(uint8_t x, uint8_t y) {
     stm32_power_release(STM32_POWER_APB1, RCC_APB1Periph_SPI2);
     stm32_power_release(STM32_POWER_AHB1, RCC_AHB1Periph_GPIOB);
 
-    display_done_isr(0);
+    _dirty_count = 0;
+    _sending = 0;
+    display_done();
 #endif
 }
 
@@ -166,25 +249,27 @@ static void _hw_display_start_frame_dma(uint8_t x, uint8_t y) {
     stm32_spi_write(&_spi2, DISPLAY_FRAME_START);
     
     /* Start the transfer */
-    _send_next(0);
+    _send_next();
 }
 
-static void _send_next(uint32_t row)
+/*
+ * DMA the next run of adjacent dirty rows straight out of the
+ * wire order buffer. No packing happens here.
+ */
+static void _send_next(void)
 {
-    static uint8_t row_buf[20 * _DMA_ROW_COUNT];
-    uint16_t len = 20 * _DMA_ROW_COUNT;
+    uint16_t row = _row_next;
+    uint16_t count = 0;
     
-    for (int i = 0; i < _DMA_ROW_COUNT; i++)
-    {
-        uint32_t rp = i * 20;
-        row_buf[rp] = __RBIT(__REV(168 - row - i));
-        for (int j = 0; j < 18; j++) {
-            row_buf[rp + j + 1] = _display_fb[row + i][17-j];
-        }
-        row_buf[rp + 19] = 0;
-    }
+    while (row <= _row_last && !_ROW_IS_DIRTY(row))
+        row++;
+
+    while (row + count <= _row_last && _ROW_IS_DIRTY(row + count))
+        count++;
 
-    stm32_spi_send_dma(&_spi2, row_buf, len);
+    _row_next = row + count;
+    _dirty_count -= count;
+    stm32_spi_send_dma(&_spi2, _wire_fb[row], 20 * count);
 }
 
 uint8_t *hw_display_get_buffer(void) {
@@ -202,15 +287,15 @@ static void _spi_tx_done(void)
 
 uint8_t hw_display_process_isr(void)
 {
-    static uint8_t row_index = 0;
+    if (!_sending)
+        return 1;
     
-    if (row_index < 168 - _DMA_ROW_COUNT)
+    if (_dirty_count)
     {
-        row_index += _DMA_ROW_COUNT;
-        _send_next(row_index);
+        _send_next();
         return 0;
     }
-    row_index = 0;
+    _sending = 0;
 
     /* if we are finished sending each column, then reset and stop */
     stm32_spi_write(&_spi2, 0);
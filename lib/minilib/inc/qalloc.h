@@ -19,4 +19,5 @@ extern void *qrealloc(qarena_t *arena, void *ptr, unsigned size);
 extern void qfree(qarena_t *arena, void *ptr);
 uint32_t qusedbytes(qarena_t *arena);
 extern uint32_t qfreebytes(qarena_t *arena);
+extern uint32_t qlargestfree(qarena_t *arena);
 #endif /* !QALLOC_H */
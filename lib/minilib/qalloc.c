@@ -177,6 +177,21 @@ uint32_t qfreebytes(qarena_t *arena) {
 	return arena->size - qusedbytes(arena);
 }
 
+/* the biggest allocation that would fit, headers and all */
+uint32_t qlargestfree(qarena_t *arena) {
+	qblock_t *blk = BLK(arena+1);
+	qblock_t *end = BLK((char *)arena + arena->size);
+	uint32_t max = 0;
+	
+	while (blk && blk < end) {
+		if (BLK_ISFREE(blk) && BLK_SZ(blk) > max) {
+			max = BLK_SZ(blk);
+		}
+		blk = BLK_NEXT(blk);
+	}
+	return max;
+}
+
 void qfree(qarena_t *arena, void *ptr) {
 	if (!ptr)
 		return;
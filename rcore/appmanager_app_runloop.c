@@ -16,7 +16,7 @@
 /* Configure Logging */
 #define MODULE_NAME "apploop"
 #define MODULE_TYPE "APLOOP"
-#define LOG_LEVEL RBL_LOG_LEVEL_DEBUG //RBL_LOG_LEVEL_ERROR
+#define LOG_MODULE APPLOOP
 
 void back_long_click_handler(ClickRecognizerRef recognizer, void *context);
 void back_long_click_release_handler(ClickRecognizerRef recognizer, void *context);
@@ -96,17 +96,27 @@ static void _draw(uint8_t force_draw)
     /* Request a draw. This is mostly from an app invalidating something */
     if (display_buffer_lock_take(0))
     {
+#ifdef DISPLAY_DEBUG_STATS
+        TickType_t start = xTaskGetTickCount();
+#endif
         if (force_draw)
             window_dirty(true);
         
+        /* Re-render any overlay that changed, before the app paints under it */
+        overlay_window_plane_update();
         bool force = window_draw();
         
         if (overlay_window_count() > 0)
         {
-            overlay_window_draw(true);
+            overlay_window_composite();
             force = true;
         }
         
+#ifdef DISPLAY_DEBUG_STATS
+        LOG_DEBUG("app frame %dms, %d overlays %s", (xTaskGetTickCount() - start) * portTICK_PERIOD_MS,
+                  overlay_window_count(), overlay_window_plane_valid() ? "composited" : "drawn over");
+#endif
+        
         if (force)
         {
             display_draw();
@@ -8,15 +8,19 @@
  * General flow:
  * 
  * TX
- * A packet is genreated and posted to the cmd thread
- * btstack_rebble takes a ref to this data,
- * and waits for a ready to send message fromt he bt stack.
+ * A packet is put in a bt_buf and posted to the TX ring at a priority.
+ * Callers don't wait, unless they use bluetooth_send.
+ * The cmd thread takes the most important packet waiting, hands it to
+ * btstack_rebble and waits until the stack has taken it, then calls the
+ * sender's callback and drops its reference.
  *  * NOTE the memory is not copied, it is sent with supplied buf
  * 
  * RX
- * An incoming packet is collected in btstack_rebble
- * once we have some data, we look over the buffer and check for packet header
- * If we have packets, we recombine them and process as required.
+ * btstack_rebble gives us data as it arrives, in whatever sized chunks.
+ * bt_rx_stream finds the frames in it and we process each one as it is
+ * finished, still on the BT thread. Frames that come in one chunk are
+ * processed from the stack's buffer, ones split over chunks from _rx_buf.
+ * Processing is a copy onto the endpoint's queue, see protocol/endpoint.c
  *  
  * NOTES:
  * we have locking and whatnot. Test it.
@@ -48,16 +52,14 @@
 /* Bit commands for the binary semaphore */
 #define TX_NOTIFY_COMPLETE 1
 
-extern int vsfmt(char *buf, unsigned int len, const char *ifmt, va_list ap);
+/* how long the stack gets to take a packet before we give up on it */
+#define BT_TX_SEND_TIMEOUT_MS 200
+
+/* bt_buf flags */
+#define BT_BUF_WRAPPED 1 // data belongs to the caller
 
+extern int vsfmt(char *buf, unsigned int len, const char *ifmt, va_list ap);
 
-/* a packet to go on the queue to process a command */
-typedef struct rebble_bt_packet_t {
-    uint8_t packet_type;
-    size_t length;
-    uint8_t *data;
-    tx_complete_callback callback;
-} rebble_bt_packet;
 
 
 /* BT runloop */
@@ -70,32 +72,25 @@ static TaskHandle_t _bt_cmd_task;
 static StackType_t _bt_cmd_task_stack[STACK_SZ_CMD];
 static StaticTask_t _bt_cmd_task_buf;
 
-/* Processing Queue */
-#define _CMD_QUEUE_LENGTH 1
-#define _CMD_QUEUE_SIZE sizeof(rebble_bt_packet)
-static QueueHandle_t _bt_cmd_queue;
-static StaticQueue_t _bt_cmd_queue_ptr;
-static uint8_t _bt_cmd_queue_buf[_CMD_QUEUE_LENGTH * _CMD_QUEUE_SIZE];
-
-static SemaphoreHandle_t _bt_tx_mutex;
-static StaticSemaphore_t _bt_tx_mutex_buf;
+/* Packets waiting to go, and a count of them for the cmd thread to sleep on.
+ * The ring is only touched in a critical section */
+static bt_tx_ring _bt_tx_ring;
+static SemaphoreHandle_t _bt_tx_pending;
+static StaticSemaphore_t _bt_tx_pending_buf;
 
-/* When a TX is complete, this will hold the orig task */
-static TaskHandle_t _tx_task_to_notify = NULL;
+/* Frames in from the phone. The handlers are done with a frame before
+ * the next chunk is fed in, so one buffer to put them together is enough */
+static bt_rx_stream _bt_rx_stream;
+static uint8_t _rx_buf[PBL_RX_MAX_PAYLOAD];
 
 static bool _enabled;
 static bool _connected;
 
 
-/* Packet command types */
-#define PACKET_TYPE_RX 0
-#define PACKET_TYPE_TX 1
-
 static void _bt_thread(void *pvParameters);
 static void _bt_cmd_thread(void *pvParameters);
-static bool _parse_packet(pbl_transport_packet *pkt, uint8_t *data, size_t len);
-static void _process_packet(pbl_transport_packet *pkt);
-static uint8_t _bluetooth_tx(uint8_t *data, uint16_t len);
+static void _process_packet(pbl_transport_packet *pkt, void *context);
+static bool _bluetooth_tx(uint8_t *data, uint16_t len);
 
 // #define BT_LOG_ENABLED
 #ifdef BT_LOG_ENABLED
@@ -107,8 +102,10 @@ static uint8_t _bluetooth_tx(uint8_t *data, uint16_t len);
 /* Initialise the bluetooth module */
 uint8_t bluetooth_init(void)
 {
-    _bt_cmd_queue = xQueueCreateStatic(_CMD_QUEUE_LENGTH, _CMD_QUEUE_SIZE, _bt_cmd_queue_buf, &_bt_cmd_queue_ptr);
-    _bt_tx_mutex = xSemaphoreCreateMutexStatic(&_bt_tx_mutex_buf);
+    bt_tx_ring_init(&_bt_tx_ring);
+    bt_rx_stream_init(&_bt_rx_stream, _rx_buf);
+    endpoint_init();
+    _bt_tx_pending = xSemaphoreCreateCountingStatic(BT_TX_PRIORITY_COUNT * BT_TX_SLOTS, 0, &_bt_tx_pending_buf);
     _bt_task = xTaskCreateStatic(_bt_thread, 
                                      "BT", STACK_SZ_BT, NULL, 
                                      tskIDLE_PRIORITY + 3UL, 
@@ -130,31 +127,34 @@ void bluetooth_init_complete(uint8_t state)
 }
 
 /*
- * Just send some raw data
- * returns bytes sent
- * DO NOT CALL FROM ISR
+ * Send some raw data, blocking until the stack has it.
+ * Only the cmd thread sends, so there is only ever one in flight
  */
-uint32_t bluetooth_send_serial_raw(uint8_t *data, size_t len)
+static bool _bluetooth_tx(uint8_t *data, uint16_t len)
 {
-    xSemaphoreTake(_bt_tx_mutex, portMAX_DELAY);
+    /* anything left over from a send that timed out */
+    ulTaskNotifyTake(pdTRUE, 0);
 
-    bt_device_request_tx(data, len);
-    
-    // block this thread until we are done
-    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(200)))
+    if (!bt_device_request_tx(data, len))
+        return false;
+
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(BT_TX_SEND_TIMEOUT_MS)))
     {
-        // clean unlock
         BT_LOG("BT", APP_LOG_LEVEL_DEBUG, "Sent %d bytes", len);
+        return true;
     }
-    else
+
+    /* the buffer is freed or handed back once we return, so the stack
+     * mustn't still be holding on to it */
+    if (!bt_device_cancel_tx())
     {
-        // timed out
-        BT_LOG("BT", APP_LOG_LEVEL_ERROR, "Timed out sending!");
+        /* it went just as we gave up */
+        ulTaskNotifyTake(pdTRUE, 0);
+        return true;
     }
-    
-    xSemaphoreGive(_bt_tx_mutex);
-    
-    return len;
+
+    BT_LOG("BT", APP_LOG_LEVEL_ERROR, "Timed out sending!");
+    return false;
 }
 
 /*
@@ -167,31 +167,20 @@ uint32_t bluetooth_send_serial_raw(uint8_t *data, size_t len)
  */
 void bluetooth_data_rx(uint8_t *data, size_t len)
 {
-    static pbl_transport_packet pkt;
-    uint8_t *buf_p;  /* pointer to the message in the buffer */
-    return;
-    if (!_parse_packet(&pkt, data, len))
-        return; // we are done, no point looking as we have no data left
-    
-    // seems legit
-    _process_packet(&pkt);
+    uint32_t errors = _bt_rx_stream.errors;
+
+    bt_rx_stream_feed(&_bt_rx_stream, data, len, _process_packet, NULL);
+
+    if (_bt_rx_stream.errors != errors)
+        BT_LOG("BT", APP_LOG_LEVEL_ERROR, "RX: bad frame, dropped the rest of %d bytes", len);
 }
 
 /*
- * We sent a packet. it was sent.
+ * We sent a packet. The stack has its own copy, so the buffer is free
  */
-void bluetooth_tx_complete_from_isr(void)
+void bluetooth_tx_complete(void)
 {
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-
-    // Notify the task that the transmission is complete.
-    vTaskNotifyGiveFromISR(_bt_cmd_task, &xHigherPriorityTaskWoken);
-
-    /* If xHigherPriorityTaskWoken is now set to pdTRUE then a context switch
-    should be performed to ensure the interrupt returns directly to the highest
-    priority task.  The macro used for this purpose is dependent on the port in
-    use and may be called portEND_SWITCHING_ISR(). */
-    portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+    xTaskNotifyGive(_bt_cmd_task);
 }
 
 /*
@@ -199,66 +188,14 @@ void bluetooth_tx_complete_from_isr(void)
  */
 
 
-/*
- * Parse a packet in the buffer. Will fill the given pbl_transport with
- * the parsed data
- * 
- * Returns false when done or on completion errors
- */
-static bool _parse_packet(pbl_transport_packet *pkt, uint8_t *data, size_t len)
-{
-    uint16_t pkt_length = (data[0] << 8) | (data[1] & 0xff);
-    uint16_t pkt_endpoint = (data[2] << 8) | (data[3] & 0xff);
-
-    /* done! (usually) */
-    if (pkt_length == 0)
-        return false;
-
-    /* Seems sensible */
-    if (pkt_length > 2048)
-    {
-        BT_LOG("BT", APP_LOG_LEVEL_ERROR, "RX: payload length %d. Seems suspect!", pkt_length);
-        return false;
-    }   
-    
-    BT_LOG("BT", APP_LOG_LEVEL_INFO, "RX: GOOD packet. len %d end %d", pkt_length, pkt_endpoint);
-
-    /* it's a valid packet. fill out passed packet and finish up */
-    pkt->length = pkt_length;
-    pkt->endpoint = pkt_endpoint;
-    pkt->data = data + 4;
-    
-    BT_LOG("BT", APP_LOG_LEVEL_INFO, "RX: Done");
-        
-    return true;
-}
-
 /* 
- * Given a packet, process it and call the relevant function
+ * Given a packet, hand it to its endpoint. This holds up RX, so the
+ * handlers themselves run on the endpoint worker
  */
-static void _process_packet(pbl_transport_packet *pkt)
+static void _process_packet(pbl_transport_packet *pkt, void *context)
 {
-    /*
-     * We should be fast in this function!
-     * Work out which message needs to be processed, and escape from here fast
-     * This will likely be holding up RX otherwise.
-     */
-    BT_LOG("BT", APP_LOG_LEVEL_INFO, "BT Got Data L:%d", pkt->length);
-        
-    // Endpoint Firmware Version
-    switch(pkt->endpoint) {
-        case ENDPOINT_FIRMWARE_VERSION:
-            process_version_packet(pkt->data);
-            break;
-        case ENDPOINT_SET_TIME:
-            process_set_time_packet(pkt->data);
-            break;
-        case ENDPOINT_PHONE_MSG:
-            process_notification_packet(pkt->data);
-            break;
-        default:
-            BT_LOG("BT", APP_LOG_LEVEL_INFO, "XXX Unimplemented Endpoint %d", pkt->endpoint);
-    }
+    BT_LOG("BT", APP_LOG_LEVEL_INFO, "BT Got Data L:%d E:%d", pkt->length, pkt->endpoint);
+    endpoint_dispatch(pkt->endpoint, pkt->data, pkt->length);
 }
 
 
@@ -283,7 +220,6 @@ static void _bt_thread(void *pvParameters)
 
 static void _bt_cmd_thread(void *pvParameters)
 {
-    rebble_bt_packet pkt;
     BT_LOG("BT", APP_LOG_LEVEL_INFO, "BT CMD Thread started");
     
     uint8_t noty_data[] = {/* test nofy data ripped from gb */
@@ -294,34 +230,24 @@ static void _bt_cmd_thread(void *pvParameters)
     
     for( ;; )
     {
-        /* We are going to wait for a message. This is mostly going to be TX messages
-         * We have a queue size of one, which blocks and serialises all callers
-         */
-        if (xQueueReceive(_bt_cmd_queue, &pkt, portMAX_DELAY))
-        {
-            if (pkt.packet_type == PACKET_TYPE_TX)
-            {
-//                 BT_LOG("BT", APP_LOG_LEVEL_INFO, "TX %d byte", pkt.length);
-                /* Do a blocking send. The thread will be asleep while the data is DMAed */
-                bluetooth_send_serial_raw(pkt.data, pkt.length);
-                
-                /* Use our semaphore to notify the calling thread that we are TX done */
-                if (!xTaskNotify(_tx_task_to_notify, TX_NOTIFY_COMPLETE, eSetBits))
-                {
-                    BT_LOG("BT", APP_LOG_LEVEL_ERROR, "TX Timed out after %dms", TX_TIMEOUT_MS);
-                    xTaskNotify(_tx_task_to_notify, TX_NOTIFY_COMPLETE, eSetBits);
-                    continue;
-                }
-                
-                /* We might have been given a TX callback function to call */
-//                 if (pkt.callback != NULL)
-//                     pkt.callback();
-            }
-        }
-        else
-        {
-            
-        }
+        /* Sleep until something is waiting, then send the most important
+         * thing first. Senders never wait on each other, just on the ring */
+        xSemaphoreTake(_bt_tx_pending, portMAX_DELAY);
+
+        bt_tx_entry entry;
+        taskENTER_CRITICAL();
+        bool have = bt_tx_ring_pop(&_bt_tx_ring, &entry);
+        taskEXIT_CRITICAL();
+
+        if (!have)
+            continue;
+
+        bt_buf *buf = entry.buf;
+        bool sent = _connected && _bluetooth_tx(buf->data, buf->len);
+
+        if (entry.callback)
+            entry.callback(sent, entry.context);
+        bluetooth_buf_unref(buf);
     }
 }
 
@@ -331,48 +257,164 @@ static void _bt_cmd_thread(void *pvParameters)
 
 
 /*
- * Send a Pebble packet right now
+ * Packet buffers
  */
-void bluetooth_send_packet(uint16_t endpoint, uint8_t *data, uint16_t len)
+
+/*
+ * A buffer for len bytes, header and data in one allocation.
+ * You get the one reference
+ */
+bt_buf *bluetooth_buf_alloc(uint16_t len)
+{
+    bt_buf *buf = system_calloc(1, sizeof(bt_buf) + len);
+    if (!buf)
+        return NULL;
+
+    buf->data = (uint8_t *)(buf + 1);
+    buf->len = len;
+    buf->refs = 1;
+    return buf;
+}
+
+/*
+ * Send data you already have without copying it. It has to stay put
+ * until the completion callback, and it isn't freed with the buf
+ */
+bt_buf *bluetooth_buf_wrap(uint8_t *data, uint16_t len)
+{
+    bt_buf *buf = system_calloc(1, sizeof(bt_buf));
+    if (!buf)
+        return NULL;
+
+    buf->data = data;
+    buf->len = len;
+    buf->refs = 1;
+    buf->flags = BT_BUF_WRAPPED;
+    return buf;
+}
+
+/*
+ * A Pebble protocol packet with the header filled in.
+ * Write the len bytes of payload from data + 4
+ */
+bt_buf *bluetooth_packet_alloc(uint16_t endpoint, uint16_t len)
+{
+    bt_buf *buf = bluetooth_buf_alloc(len + 4);
+    if (!buf)
+        return NULL;
+
+    buf->data[0] = ((uint8_t)(len >> 8));
+    buf->data[1] = ((uint8_t)(len & 0xff));
+    buf->data[2] = ((uint8_t)(endpoint >> 8));
+    buf->data[3] = ((uint8_t)(endpoint & 0xff));
+    return buf;
+}
+
+bt_buf *bluetooth_buf_ref(bt_buf *buf)
+{
+    __atomic_fetch_add(&buf->refs, 1, __ATOMIC_RELAXED);
+    return buf;
+}
+
+void bluetooth_buf_unref(bt_buf *buf)
 {
-    uint8_t tx_buf[len + 4];
-    tx_buf[0] = ((uint8_t)(len >> 8));
-    tx_buf[1] = ((uint8_t)(len & 0xff));
-    tx_buf[2] = ((uint8_t)(endpoint >> 8));
-    tx_buf[3] = ((uint8_t)(endpoint & 0xff));
-
-    memcpy(&tx_buf[4], data, len);
-    bluetooth_send(tx_buf, len + 4);
+    if (__atomic_sub_fetch(&buf->refs, 1, __ATOMIC_ACQ_REL))
+        return;
+
+    /* a wrapped buf's data lives somewhere else, but either way it's one free */
+    free(buf);
+}
+
+/*
+ * Queue a packet to go. Takes your reference, so once this is called the
+ * buffer isn't yours. Doesn't wait: false, and the callback told so, if
+ * it can't be sent or there is no room at that priority.
+ * DO NOT CALL FROM ISR
+ */
+bool bluetooth_send_buf(bt_buf *buf, BluetoothTxPriority priority, tx_complete_callback callback, void *context)
+{
+    bt_tx_entry entry = {
+        .buf = buf,
+        .callback = callback,
+        .context = context,
+    };
+    bool queued = false;
+
+    if (_enabled && _connected)
+    {
+        taskENTER_CRITICAL();
+        queued = bt_tx_ring_push(&_bt_tx_ring, priority, &entry);
+        taskEXIT_CRITICAL();
+    }
+
+    if (!queued)
+    {
+        BT_LOG("BT", APP_LOG_LEVEL_ERROR, "TX dropped %d bytes at priority %d", buf->len, priority);
+        if (callback)
+            callback(false, context);
+        bluetooth_buf_unref(buf);
+        return false;
+    }
+
+    xSemaphoreGive(_bt_tx_pending);
+    return true;
 }
 
 /* 
- * Request a TX through the outboud thread mechanism
+ * Utility
  */
-void bluetooth_send_async(uint8_t *data, size_t len, tx_complete_callback cb)
+
+/*
+ * Send a Pebble packet. It is copied once, into its buffer, and this
+ * returns without waiting for it to go
+ */
+void bluetooth_send_packet(uint16_t endpoint, uint8_t *data, uint16_t len)
 {
     if (!_enabled || !_connected)
         return;
-    
-    rebble_bt_packet packet = {
-        .length = len,
-        .packet_type = PACKET_TYPE_TX,
-        .data = data,
-        .callback = cb
-    };
 
-    xQueueSendToBack(_bt_cmd_queue, &packet, portMAX_DELAY);
+    bt_buf *buf = bluetooth_packet_alloc(endpoint, len);
+    if (!buf)
+        return;
+
+    memcpy(buf->data + 4, data, len);
+    bluetooth_send_buf(buf, BT_TX_PRIORITY_HIGH, NULL, NULL);
 }
-    
-inline uint8_t bluetooth_send(uint8_t *data, size_t len)
+
+static void _bluetooth_send_done(bool sent, void *context)
+{
+    xTaskNotify((TaskHandle_t)context, sent ? TX_NOTIFY_COMPLETE : 0, eSetValueWithOverwrite);
+}
+
+/*
+ * Send data and wait until it has gone. Returns the bytes sent
+ */
+uint8_t bluetooth_send(uint8_t *data, size_t len)
 {
+    uint32_t notif_value = 0;
+
     if (!_enabled || !_connected)
         return len;
 
-    return _bluetooth_tx(data, len);
+    bt_buf *buf = bluetooth_buf_wrap(data, len);
+    if (!buf)
+        return 0;
+
+    xTaskNotifyStateClear(NULL);
+    bluetooth_send_buf(buf, BT_TX_PRIORITY_NORMAL, _bluetooth_send_done, xTaskGetCurrentTaskHandle());
+    xTaskNotifyWait(0, 0xffffffff, &notif_value, portMAX_DELAY);
+
+    if (!(notif_value & TX_NOTIFY_COMPLETE))
+        return 0;
+
+    BT_LOG("BT", APP_LOG_LEVEL_INFO, "TX Sent %d bytes", len);
+    return len;
 }
 
 void bluetooth_device_connected(void)
 {
+    /* whatever was half way in is from the last phone */
+    bt_rx_stream_reset(&_bt_rx_stream);
     _connected = true;
     connection_service_update(true);
 }
@@ -381,6 +423,7 @@ void bluetooth_device_disconnected(void)
 {
     _connected = false;
     connection_service_update(false);
+    endpoint_stats_dump();
 }
 
 bool bluetooth_is_device_connected(void)
@@ -388,40 +431,6 @@ bool bluetooth_is_device_connected(void)
     return _connected;
 }
 
-static uint8_t _bluetooth_tx(uint8_t *data, uint16_t len)
-{
-    BaseType_t result;
-    uint32_t notif_value;
-    
-    /* Grab the callee's task handle so we can sleep on it */
-     _tx_task_to_notify = xTaskGetCurrentTaskHandle();
-     
-    /* This will block if there is something in progress already (queue size 1) */
-    bluetooth_send_async(data, len, NULL);
-    
-    /* We sleep block again waiting for TX complete */
-    result = xTaskNotifyWait(pdFALSE,    /* Don't clear bits on entry. */
-                         0xffffffff,        /* Clear all bits on exit. */
-                         &notif_value, /* Stores the notified value. */
-                         pdMS_TO_TICKS(TX_TIMEOUT_MS));
-
-    if(result == pdPASS)
-    {
-        if ((notif_value & TX_NOTIFY_COMPLETE) != 0)
-        {
-            BT_LOG("BT", APP_LOG_LEVEL_INFO, "TX Sent %d bytes", len);
-        }
-    }
-    else
-    {
-        BT_LOG("BT", APP_LOG_LEVEL_ERROR, "TX Timed out after %dms", TX_TIMEOUT_MS);
-        return 0;
-    }
-
-
-    return len;
-}
-
 
 
 // Ugh compat with btstack
@@ -0,0 +1,118 @@
+/* bt_rx_stream.c
+ * Pebble protocol frames out of whatever chunks the transport gives us
+ * RebbleOS
+ *
+ * A frame is a 4 byte header, length and endpoint both big endian,
+ * then length bytes of payload. RFCOMM doesn't care where frames start
+ * and end, so a chunk can hold several, or the end of one and the start
+ * of the next, or a bit of the middle of a big one.
+ */
+
+#include <string.h>
+#include "bt_rx_stream.h"
+
+void bt_rx_stream_init(bt_rx_stream *rx, uint8_t *buf)
+{
+    memset(rx, 0, sizeof(bt_rx_stream));
+    rx->buf = buf;
+}
+
+void bt_rx_stream_reset(bt_rx_stream *rx)
+{
+    rx->header_len = 0;
+    rx->have = 0;
+}
+
+static void _dispatch(bt_rx_stream *rx, uint8_t *data, bt_rx_frame_handler handler, void *context)
+{
+    pbl_transport_packet pkt = {
+        .length = rx->length,
+        .endpoint = rx->endpoint,
+        .data = data,
+    };
+
+    rx->frames++;
+    handler(&pkt, context);
+    bt_rx_stream_reset(rx);
+}
+
+/*
+ * The header is all here. false if it makes no sense.
+ * An empty frame is taken as padding, so that is false too
+ */
+static bool _header(bt_rx_stream *rx, const uint8_t *header)
+{
+    rx->length = (header[0] << 8) | header[1];
+    rx->endpoint = (header[2] << 8) | header[3];
+    rx->header_len = 4;
+    rx->have = 0;
+
+    return rx->length && rx->length <= PBL_RX_MAX_PAYLOAD;
+}
+
+void bt_rx_stream_feed(bt_rx_stream *rx, const uint8_t *data, size_t len,
+                       bt_rx_frame_handler handler, void *context)
+{
+    while (len)
+    {
+        /* whole frames in the chunk go straight from it */
+        if (rx->header_len == 0 && len >= 4)
+        {
+            if (!_header(rx, data))
+                goto bad_frame;
+
+            if (len - 4 >= rx->length)
+            {
+                _dispatch(rx, (uint8_t *)data + 4, handler, context);
+                data += 4 + rx->length;
+                len -= 4 + rx->length;
+                continue;
+            }
+
+            data += 4;
+            len -= 4;
+        }
+
+        /* a header in pieces */
+        if (rx->header_len < 4)
+        {
+            uint8_t n = 4 - rx->header_len;
+            if (n > len)
+                n = len;
+            memcpy(rx->header + rx->header_len, data, n);
+            rx->header_len += n;
+            data += n;
+            len -= n;
+
+            if (rx->header_len < 4)
+                return;
+
+            if (!_header(rx, rx->header))
+                goto bad_frame;
+        }
+
+        /* and the payload */
+        uint16_t n = rx->length - rx->have;
+        if (n > len)
+            n = len;
+        memcpy(rx->buf + rx->have, data, n);
+        rx->have += n;
+        data += n;
+        len -= n;
+
+        if (rx->have == rx->length)
+        {
+            rx->reassembled++;
+            _dispatch(rx, rx->buf, handler, context);
+        }
+    }
+
+    return;
+
+bad_frame:
+    /* the chunk was zero padded, or we lost our place.
+     * Either way hope the next chunk starts a frame */
+    if (rx->length)
+        rx->errors++;
+    bt_rx_stream_reset(rx);
+}
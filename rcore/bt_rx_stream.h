@@ -0,0 +1,46 @@
+#pragma once
+/* bt_rx_stream.h
+ * Pebble protocol frames out of whatever chunks the transport gives us
+ * RebbleOS
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* biggest payload the phone is allowed to send us */
+#define PBL_RX_MAX_PAYLOAD 2048
+
+typedef struct pbl_transport_packet_t {
+    uint16_t length;
+    uint16_t endpoint;
+    uint8_t *data;
+} __attribute__((__packed__)) pbl_transport_packet;
+
+/* The packet, and its data, are only good until this returns */
+typedef void (*bt_rx_frame_handler)(pbl_transport_packet *pkt, void *context);
+
+typedef struct bt_rx_stream {
+    /* PBL_RX_MAX_PAYLOAD bytes for frames split over chunks */
+    uint8_t *buf;
+    uint8_t header[4];
+    uint8_t header_len;
+    uint16_t length;
+    uint16_t endpoint;
+    uint16_t have;
+    /* frames seen, how many of those had to be put together in buf,
+     * and chunks thrown away because they made no sense */
+    uint32_t frames;
+    uint32_t reassembled;
+    uint32_t errors;
+} bt_rx_stream;
+
+/* These don't lock, feed a stream from one thread. */
+void bt_rx_stream_init(bt_rx_stream *rx, uint8_t *buf);
+/* Forget any half a frame, for a new connection */
+void bt_rx_stream_reset(bt_rx_stream *rx);
+/* Calls handler for every frame finished by this chunk. A frame that is
+ * all in the chunk is handed over where it is, only frames split over
+ * chunks are copied */
+void bt_rx_stream_feed(bt_rx_stream *rx, const uint8_t *data, size_t len,
+                       bt_rx_frame_handler handler, void *context);
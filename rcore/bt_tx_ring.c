@@ -0,0 +1,48 @@
+/* bt_tx_ring.c
+ * Bluetooth packets waiting to go out, by priority
+ * RebbleOS
+ */
+
+#include <string.h>
+#include "bt_tx_ring.h"
+
+void bt_tx_ring_init(bt_tx_ring *ring)
+{
+    memset(ring, 0, sizeof(bt_tx_ring));
+}
+
+bool bt_tx_ring_push(bt_tx_ring *ring, BluetoothTxPriority priority, const bt_tx_entry *entry)
+{
+    if (priority >= BT_TX_PRIORITY_COUNT || ring->count[priority] == BT_TX_SLOTS)
+        return false;
+
+    uint8_t slot = (ring->head[priority] + ring->count[priority]) % BT_TX_SLOTS;
+    ring->slots[priority][slot] = *entry;
+    ring->count[priority]++;
+
+    return true;
+}
+
+bool bt_tx_ring_pop(bt_tx_ring *ring, bt_tx_entry *entry)
+{
+    for (uint8_t p = 0; p < BT_TX_PRIORITY_COUNT; p++)
+    {
+        if (!ring->count[p])
+            continue;
+
+        *entry = ring->slots[p][ring->head[p]];
+        ring->head[p] = (ring->head[p] + 1) % BT_TX_SLOTS;
+        ring->count[p]--;
+        return true;
+    }
+
+    return false;
+}
+
+uint16_t bt_tx_ring_count(const bt_tx_ring *ring)
+{
+    uint16_t n = 0;
+    for (uint8_t p = 0; p < BT_TX_PRIORITY_COUNT; p++)
+        n += ring->count[p];
+    return n;
+}
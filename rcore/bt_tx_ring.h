@@ -0,0 +1,43 @@
+#pragma once
+/* bt_tx_ring.h
+ * Bluetooth packets waiting to go out, by priority
+ * RebbleOS
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Highest first. The TX thread always sends the most important packet
+ * waiting, so a burst of logs can't hold up a reply the phone is
+ * waiting on */
+typedef enum BluetoothTxPriority {
+    BT_TX_PRIORITY_HIGH,   // protocol replies
+    BT_TX_PRIORITY_NORMAL, // notifications, apps
+    BT_TX_PRIORITY_LOW,    // logs, bulk data
+    BT_TX_PRIORITY_COUNT
+} BluetoothTxPriority;
+
+/* how many packets each priority can have waiting */
+#ifndef BT_TX_SLOTS
+#  define BT_TX_SLOTS 8
+#endif
+
+typedef struct bt_tx_entry {
+    void *buf;
+    void (*callback)(bool sent, void *context);
+    void *context;
+} bt_tx_entry;
+
+typedef struct bt_tx_ring {
+    bt_tx_entry slots[BT_TX_PRIORITY_COUNT][BT_TX_SLOTS];
+    uint8_t head[BT_TX_PRIORITY_COUNT];
+    uint8_t count[BT_TX_PRIORITY_COUNT];
+} bt_tx_ring;
+
+/* These don't lock, that is up to the caller. */
+void bt_tx_ring_init(bt_tx_ring *ring);
+/* false if that priority is full */
+bool bt_tx_ring_push(bt_tx_ring *ring, BluetoothTxPriority priority, const bt_tx_entry *entry);
+/* the oldest entry of the highest priority waiting. false if empty */
+bool bt_tx_ring_pop(bt_tx_ring *ring, bt_tx_entry *entry);
+uint16_t bt_tx_ring_count(const bt_tx_ring *ring);
@@ -8,13 +8,16 @@
 #include <stdio.h>
 #include "debug.h"
 #include "platform.h"
+#include "log.h"
 
-#define PANIC_STACK_SIZE (224 / 2)
+#define PANIC_STACK_SIZE (640 / 2) /* room to format the log on the way down */
 
 static StackType_t _panic_stack[PANIC_STACK_SIZE] CCRAM;
 
 __attribute__((__noreturn__)) static void _panic(const char *s) {
     portDISABLE_INTERRUPTS();
+    /* whatever was logged on the way here */
+    log_flush();
     puts("*** PANIC ***");
     puts(s);
     while (1)
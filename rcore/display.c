@@ -10,10 +10,19 @@
  * Calling display_draw starts the draw process.
  * display_draw => until hw is done => semaphore wait on isr
  * NOTES 
- *   The draw is run in the caller's thread context.
- *   This is a blocking process until a complete frame is drawn.
  *   This must be run in the scheduler, not before.
- *  
+ *
+ *   Single buffered (default):
+ *     The draw is run in the caller's thread context.
+ *     This is a blocking process until a complete frame is drawn.
+ *
+ *   Double buffered (DISPLAY_DOUBLE_BUFFER set by the platform):
+ *     The renderer owns a back buffer, the driver owns the front buffer.
+ *     display_draw waits for the previous frame to leave the front buffer,
+ *     copies the back buffer over and hands the frame to the display thread.
+ *     The caller is free to render the next frame while this one is sent.
+ *     The back buffer keeps its contents between frames, so partial
+ *     redraws still work.
  */
  
 #include "rebbleos.h"
@@ -23,13 +32,38 @@
 static SemaphoreHandle_t _display_start_sem;
 static StaticSemaphore_t _display_start_sem_buf;
 
-static void _display_start_frame(uint8_t offset_x, uint8_t offset_y);
+static void _display_start_frame(uint16_t first_row, uint16_t last_row);
 static void _display_cmd(uint8_t cmd, char *data);
+static void _display_send_frame(uint16_t first_row, uint16_t last_row);
 
 /* A mutex to use for locking buffers */
 static StaticSemaphore_t _draw_mutex_buf;
 static SemaphoreHandle_t _draw_mutex;
 
+/* Rows touched by the renderer since the last frame.
+ * first > last means nobody told us, so the whole frame goes */
+static uint16_t _dirty_first_row = DISPLAY_ROWS;
+static uint16_t _dirty_last_row = 0;
+
+#ifdef DISPLAY_DOUBLE_BUFFER
+/* The renderer draws here. Kept out of CCRAM, it is already spoken for */
+static uint8_t _back_buffer[DISPLAY_FRAMEBUFFER_SIZE];
+
+/* Given when the front buffer is free for the next frame */
+static SemaphoreHandle_t _display_done_sem;
+static StaticSemaphore_t _display_done_sem_buf;
+
+#define STACK_SIZE_DISPLAY configMINIMAL_STACK_SIZE
+static TaskHandle_t _display_task;
+static StaticTask_t _display_task_buf;
+static StackType_t _display_task_stack[STACK_SIZE_DISPLAY];
+static void _display_thread(void *pvParameters);
+
+/* Rows of the frame being handed to the display thread */
+static uint16_t _frame_first_row;
+static uint16_t _frame_last_row;
+#endif
+
 /*
  * Start the display driver and tasks
  */
@@ -37,6 +71,13 @@ uint8_t display_init(void)
 {
     _display_start_sem = xSemaphoreCreateBinaryStatic(&_display_start_sem_buf);
     _draw_mutex        = xSemaphoreCreateMutexStatic(&_draw_mutex_buf);
+
+#ifdef DISPLAY_DOUBLE_BUFFER
+    _display_done_sem  = xSemaphoreCreateBinaryStatic(&_display_done_sem_buf);
+    xSemaphoreGive(_display_done_sem);
+    _display_task = xTaskCreateStatic(_display_thread, "Display", STACK_SIZE_DISPLAY, NULL, 
+                                      tskIDLE_PRIORITY + 5UL, _display_task_stack, &_display_task_buf);
+#endif
     
     hw_display_init();
     os_module_init_complete(0);
@@ -58,6 +99,15 @@ void display_done_isr(uint8_t cmd)
     portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
 }
 
+/*
+ * The same, for a driver that finished without an interrupt,
+ * i.e. from the display thread in hw_display_start_frame_rows
+ */
+void display_done(void)
+{
+    xSemaphoreGive(_display_start_sem);
+}
+
 /*
  * Brutally and forcefully reset the display. This will
  * reset, but it will leave you dead in the water. Make sure to init.
@@ -70,10 +120,30 @@ void display_reset(uint8_t enabled)
 
 /*
  * Begin rendering a frame from the framebuffer into the display
+ * Drivers that can't do partial updates send the lot
  */
-static void _display_start_frame(uint8_t xoffset, uint8_t yoffset)
+static void _display_start_frame(uint16_t first_row, uint16_t last_row)
 {
-    hw_display_start_frame(xoffset, yoffset);
+    hw_display_start_frame_rows(first_row, last_row);
+}
+
+/*
+ * Push the given rows of the front buffer out to the panel.
+ * Blocks until every row/col of the frame is sent
+ */
+static void _display_send_frame(uint16_t first_row, uint16_t last_row)
+{
+    uint8_t done = 0;
+    _display_start_frame(first_row, last_row);
+
+    /* A frame is requested. Sit and await frame draw completion */
+    while(!done)
+    {
+        /* block wait for the draw one a single row/col to finish
+         * this is invoked via the ISR */
+        xSemaphoreTake(_display_start_sem, portMAX_DELAY);
+        done = hw_display_process_isr();
+    }
 }
 
 /*
@@ -81,29 +151,85 @@ static void _display_start_frame(uint8_t xoffset, uint8_t yoffset)
  */
 uint8_t *display_get_buffer(void)
 {
+#ifdef DISPLAY_DOUBLE_BUFFER
+    return _back_buffer;
+#else
     return hw_display_get_buffer();
+#endif
+}
+
+/*
+ * Tell the display which rows of the buffer have been drawn to.
+ * Called by the renderer before display_draw. If it isn't called
+ * the full frame is sent
+ */
+void display_mark_dirty_rows(uint16_t first_row, uint16_t last_row)
+{
+    if (last_row >= DISPLAY_ROWS)
+        last_row = DISPLAY_ROWS - 1;
+    if (first_row > last_row)
+        return;
+
+    if (first_row < _dirty_first_row)
+        _dirty_first_row = first_row;
+    if (last_row > _dirty_last_row)
+        _dirty_last_row = last_row;
 }
 
 /*
  * Queue a draw when available
- * This function starts the draw, and then sits and waits in 
+ * Single buffered, this starts the draw, and then sits and waits in 
  * a poll waiting for all frames to finish.
+ * Double buffered, this only waits for the previous frame to be sent.
  * To be called from an rtos thread only
  */
 void display_draw(void)
 {
-    uint8_t done = 0;
-    _display_start_frame(0, 0);
+    uint16_t first_row = 0;
+    uint16_t last_row = DISPLAY_ROWS - 1;
+    
+    if (_dirty_first_row <= _dirty_last_row)
+    {
+        first_row = _dirty_first_row;
+        last_row = _dirty_last_row;
+    }
+    _dirty_first_row = DISPLAY_ROWS;
+    _dirty_last_row = 0;
 
-    /* A frame is requested. Sit and await frame draw completion */
-    while(!done)
+#ifdef DISPLAY_DEBUG_STATS
+    SYS_LOG("display", APP_LOG_LEVEL_DEBUG, "frame: rows %d-%d, %d bytes",
+            first_row, last_row, (last_row - first_row + 1) * DISPLAY_ROW_BYTES);
+#endif
+
+#ifdef DISPLAY_DOUBLE_BUFFER
+    xSemaphoreTake(_display_done_sem, portMAX_DELAY);
+    /* Untouched rows in the front buffer already match the back buffer */
+    memcpy(hw_display_get_buffer() + first_row * DISPLAY_ROW_BYTES,
+           _back_buffer + first_row * DISPLAY_ROW_BYTES,
+           (last_row - first_row + 1) * DISPLAY_ROW_BYTES);
+    _frame_first_row = first_row;
+    _frame_last_row = last_row;
+    xTaskNotifyGive(_display_task);
+#else
+    _display_send_frame(first_row, last_row);
+#endif
+}
+
+#ifdef DISPLAY_DOUBLE_BUFFER
+/*
+ * Sends each frame handed over by display_draw, then frees
+ * the front buffer for the next one
+ */
+static void _display_thread(void *pvParameters)
+{
+    for( ;; )
     {
-        /* block wait for the draw one a single row/col to finish
-         * this is invoked via the ISR */
-        xSemaphoreTake(_display_start_sem, portMAX_DELAY);
-        done = hw_display_process_isr();
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        _display_send_frame(_frame_first_row, _frame_last_row);
+        xSemaphoreGive(_display_done_sem);
     }
 }
+#endif
 
 inline bool display_buffer_lock_take(uint32_t timeout)
 {
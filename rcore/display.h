@@ -10,8 +10,10 @@
 
 uint8_t display_init(void);
 void display_done_isr(uint8_t cmd);
+void display_done(void);
 void display_reset(uint8_t enabled);
 void display_draw(void);
+void display_mark_dirty_rows(uint16_t first_row, uint16_t last_row);
 uint8_t *display_get_buffer(void);
 
 bool display_buffer_lock_give(void);
@@ -2,6 +2,16 @@
  * routines for logging apps and system
  * RebbleOS
  *
+ * Logging is deferred. A log call copies its arguments into a ring buffer
+ * and returns; a low priority task formats them and writes them out.
+ * Any number of tasks and interrupts can log at once without locks, and
+ * nothing ever waits. If the ring is full, the message is dropped and
+ * counted, and the drain task says how many went missing.
+ * Until the scheduler is running, messages are written out straight away.
+ *
+ * Built with LOG_TOKENIZED, system logs go out as small binary frames
+ * instead of text; see log.h and Utilities/logdecode.py.
+ *
  * Author: Barry Carter <barry.carter@gmail.com>
  */
 
@@ -10,18 +20,101 @@
 
 extern int vsfmt(char *buf, unsigned int len, const char *ifmt, va_list ap);
 
-static SemaphoreHandle_t _log_mutex = NULL;
-static StaticSemaphore_t _log_mutex_buf;
+/* must be a power of 2 */
+#ifndef LOG_RING_SIZE
+#  define LOG_RING_SIZE 2048
+#endif
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+/* the most argument bytes a message can carry, and the longest %s copied */
+#define LOG_MAX_ARG_BYTES 96
+#define LOG_MAX_STRING 40
+#define LOG_SPEC_LEN 12
+#define LOG_LINE_LEN 128
+/* as much of an app's file name as _log_emit prints */
+#define LOG_APP_FILENAME_LEN 13
+
+#define LOG_ALIGN(n) (((n) + 3) & ~3)
+
+enum {
+    LOG_RECORD_EMPTY = 0, // not written yet, the drain waits here
+    LOG_RECORD_MESSAGE,   // fmt and raw arguments
+    LOG_RECORD_TEXT,      // already formatted, the file name then the text are in args
+    LOG_RECORD_PAD,       // skip to the start of the ring
+    LOG_RECORD_TOKEN,     // fmt is a token, args start with the types and ticks
+};
+
+#ifndef LOG_TOKENIZED
+#  define LOG_ARG_NONE   0
+#  define LOG_ARG_INT32  1
+#  define LOG_ARG_INT64  2
+#  define LOG_ARG_STRING 3
+#endif
+
+/* A tokenized log on the wire. Nothing we print as text has a 0x1e in it,
+ * so the decoder can find frames amongst ordinary lines.
+ *   0x1e, length of what follows up to the checksum,
+ *   level (bit 7 set in an ISR), thread + 1 (0 for none),
+ *   ticks, token, then each argument: numbers zigzag encoded,
+ *   strings as a length byte and the bytes. Numbers are all varints.
+ *   Last, the low byte of the sum of everything after the length */
+#define LOG_FRAME_SYNC 0x1e
+#define LOG_FRAME_MAX 160
+
+/* The first word is written last, so a record is all there
+ * by the time the drain sees it isn't empty */
+typedef struct log_record {
+    uint16_t size; // bytes, this header included
+    uint8_t kind;
+    uint8_t level;
+    const char *layer;
+    const char *module;
+    const char *filename;
+    const char *fmt;
+    uint32_t line_no;
+    int8_t thread;
+    uint8_t isr;
+    uint16_t arg_bytes;
+    uint32_t args[];
+} log_record;
+
+static uint8_t _ring[LOG_RING_SIZE] __attribute__((aligned(4)));
+static volatile uint32_t _head; // bytes reserved by writers, ever
+static volatile uint32_t _tail; // bytes drained, ever
+static volatile uint32_t _dropped;
+static uint32_t _dropped_reported;
+
+#define _LOG_MODULE_BUILT(name_) [LOG_MODULE_##name_] = LOG_LEVEL_##name_,
+
+/* levels each module was built with, and what they are logging now */
+static const uint8_t _log_module_built[LOG_MODULE_COUNT] = { LOG_MODULE_LIST(_LOG_MODULE_BUILT) };
+uint8_t log_module_levels[LOG_MODULE_COUNT] = { LOG_MODULE_LIST(_LOG_MODULE_BUILT) };
+
+static TaskHandle_t _log_task;
+static StaticTask_t _log_task_buf;
+static StackType_t _log_task_stack[configMINIMAL_STACK_SIZE + 256];
+
+static void _log_thread(void *pvParameters);
+static void _log(uint8_t kind, const char *layer, const char *module, uint8_t level, const char *filename,
+                 uint32_t line_no, const char *fmt, uint32_t types, va_list ar);
+static void _log_drain(void);
 static void _log_pad_string(const char *in_str, char *padded_str, uint16_t pad_len);
 
+void log_init(void)
+{
+    _log_task = xTaskCreateStatic(_log_thread, "Log", configMINIMAL_STACK_SIZE + 256, NULL,
+                                  tskIDLE_PRIORITY + 1UL, _log_task_stack, &_log_task_buf);
+}
+
 /*
  * Print log output (like APP_LOG:   INFO filename.c message)
+ * App strings can be gone by the time the drain gets to them,
+ * so these are formatted up front, and the file name copied
  */
 void app_log_trace(uint8_t level, const char *filename, uint32_t line_no, const char *fmt, ...)
 {
     va_list ar;
     va_start(ar, fmt);
-    log_printf("APP", "APP", level, filename, line_no, fmt, ar);
+    _log(LOG_RECORD_TEXT, "APP", "APP", level, filename, line_no, fmt, 0, ar);
     va_end(ar);
 }
 
@@ -33,48 +126,360 @@ void log_printf_to_ar(const char *layer, const char *module, uint8_t level, cons
     va_end(ar);
 }
 
-// NOTE Probably shouldn't use from an ISR or it'll likely lock
-
+/*
+ * Safe from anywhere, interrupts included. It never blocks
+ */
 void log_printf(const char *layer, const char *module, uint8_t level, const char *filename, uint32_t line_no, const char *fmt, va_list ar)
 {
-    uint8_t interrupt_set = 0;
-    static BaseType_t xHigherPriorityTaskWoken;
-    char buf[128];
-    char tbuf[16];
-    
-    // XXX: this means that log_printf *must* be called first from a non-threaded context, for this check is not thread-safe!
-    // XXX: verify this here.
-    if (_log_mutex == NULL)
-        _log_mutex = xSemaphoreCreateMutexStatic(&_log_mutex_buf);
-    
-    if(is_interrupt_set())
-    {
-        xHigherPriorityTaskWoken = pdFALSE;
-        xSemaphoreTakeFromISR(_log_mutex, &xHigherPriorityTaskWoken);
-        interrupt_set = 1;
+    _log(LOG_RECORD_MESSAGE, layer, module, level, filename, line_no, fmt, 0, ar);
+}
+
+/*
+ * SYS_LOG and friends when built with LOG_TOKENIZED. types says what
+ * the arguments are, as the format string isn't on the watch to ask
+ */
+void log_token(uint8_t level, const char *token, uint32_t types, ...)
+{
+    va_list ar;
+    va_start(ar, types);
+    _log(LOG_RECORD_TOKEN, NULL, NULL, level, NULL, 0, token, types, ar);
+    va_end(ar);
+}
+
+/*
+ * Change what a LOG_MODULE logs, using the RBL_LOG_LEVEL_ masks.
+ * Levels that weren't built in stay off
+ */
+void log_module_set_level(LogModule module, uint8_t level)
+{
+    if (module >= LOG_MODULE_COUNT)
+        return;
+    log_module_levels[module] = level & _log_module_built[module];
+}
+
+uint8_t log_module_get_level(LogModule module)
+{
+    return module < LOG_MODULE_COUNT ? log_module_levels[module] : RBL_LOG_LEVEL_NONE;
+}
+
+uint32_t log_dropped_count(void)
+{
+    return _dropped;
+}
+
+/*
+ * Write out whatever is waiting, right now. For when we are about to die
+ */
+void log_flush(void)
+{
+    _log_drain();
+}
+
+/* flags, width, precision and length: everything between % and the conversion */
+static bool _log_is_flag(char c)
+{
+    return c == '-' || c == '+' || c == ' ' || c == '#' || c == '.' ||
+           (c >= '0' && c <= '9') || c == 'l' || c == 'h' || c == 'z' || c == 'j' || c == 't';
+}
+
+/*
+ * What the next argument fmt wants is, moving fmt past its conversion
+ */
+static uint8_t _log_next_arg(const char **fmt)
+{
+    const char *f = *fmt;
+
+    while (*f)
+    {
+        if (*f++ != '%')
+            continue;
+
+        uint8_t longs = 0;
+        while (_log_is_flag(*f))
+            longs += *f++ == 'l';
+
+        if (!*f)
+            break;
+
+        char conv = *f++;
+        if (conv == '%')
+            continue;
+
+        *fmt = f;
+        return conv == 's' ? LOG_ARG_STRING : longs > 1 ? LOG_ARG_INT64 : LOG_ARG_INT32;
+    }
+
+    *fmt = f;
+    return LOG_ARG_NONE;
+}
+
+/*
+ * Copy each argument into args: numbers as words (two for ll),
+ * strings inline and NUL terminated. The types come from fmt or, when
+ * that is NULL, 2 bits at a time from types. Returns the bytes used
+ */
+static uint16_t _log_pack_args(uint8_t *args, uint16_t len, const char *fmt, uint32_t types, va_list ar)
+{
+    for (;;)
+    {
+        uint8_t type;
+        if (fmt)
+        {
+            type = _log_next_arg(&fmt);
+        }
+        else
+        {
+            type = types & 3;
+            types >>= 2;
+        }
+
+        switch (type)
+        {
+        case LOG_ARG_NONE:
+            return len;
+        case LOG_ARG_STRING:
+        {
+            const char *s = va_arg(ar, const char *);
+            uint16_t n = 0;
+            while (s && n < LOG_MAX_STRING && s[n])
+                n++;
+            if (len + LOG_ALIGN(n + 1) > LOG_MAX_ARG_BYTES)
+                return len;
+            memcpy(args + len, s, n);
+            args[len + n] = 0;
+            len += LOG_ALIGN(n + 1);
+            break;
+        }
+        case LOG_ARG_INT64:
+        {
+            if (len + sizeof(uint64_t) > LOG_MAX_ARG_BYTES)
+                return len;
+            uint64_t v = va_arg(ar, uint64_t);
+            memcpy(args + len, &v, sizeof(v));
+            len += sizeof(uint64_t);
+            break;
+        }
+        default:
+        {
+            if (len + sizeof(uint32_t) > LOG_MAX_ARG_BYTES)
+                return len;
+            uint32_t v = va_arg(ar, uint32_t);
+            memcpy(args + len, &v, sizeof(v));
+            len += sizeof(uint32_t);
+        }
+        }
+    }
+}
+
+/*
+ * The other half of _log_pack_args. Formats one conversion at a time,
+ * so only ever passes snprintf the one argument
+ */
+static void _log_format(char *out, uint16_t size, const char *fmt, const uint8_t *args, uint16_t arg_bytes)
+{
+    const uint8_t *end = args + arg_bytes;
+    char spec[LOG_SPEC_LEN];
+    uint16_t pos = 0;
+
+    while (*fmt && pos < size - 1)
+    {
+        if (*fmt != '%')
+        {
+            out[pos++] = *fmt++;
+            continue;
+        }
+
+        const char *start = fmt++;
+        uint8_t longs = 0;
+        while (_log_is_flag(*fmt))
+            longs += *fmt++ == 'l';
+
+        if (!*fmt)
+            break;
+
+        char conv = *fmt++;
+        if (conv == '%')
+        {
+            out[pos++] = '%';
+            continue;
+        }
+
+        uint8_t n = fmt - start < LOG_SPEC_LEN ? fmt - start : LOG_SPEC_LEN - 1;
+        memcpy(spec, start, n);
+        spec[n] = 0;
+
+        if (conv == 's')
+        {
+            if (args >= end)
+                break;
+            snprintf(out + pos, size - pos, spec, (const char *)args);
+            args += LOG_ALIGN(strlen((const char *)args) + 1);
+        }
+        else if (longs > 1)
+        {
+            uint64_t v;
+            if (args + sizeof(v) > end)
+                break;
+            memcpy(&v, args, sizeof(v));
+            snprintf(out + pos, size - pos, spec, v);
+            args += sizeof(v);
+        }
+        else
+        {
+            uint32_t v;
+            if (args + sizeof(v) > end)
+                break;
+            memcpy(&v, args, sizeof(v));
+            snprintf(out + pos, size - pos, spec, v);
+            args += sizeof(v);
+        }
+        pos += strlen(out + pos);
+    }
+
+    out[pos < size ? pos : size - 1] = 0;
+}
+
+/*
+ * Claim size bytes of the ring. Records don't wrap, so if there isn't
+ * room before the end a pad record fills it and we start again at the top.
+ * NULL if the drain hasn't caught up enough
+ */
+static log_record *_log_reserve(uint16_t size)
+{
+    uint32_t head, end, pad;
+
+    do
+    {
+        head = __atomic_load_n(&_head, __ATOMIC_RELAXED);
+        uint32_t index = head & LOG_RING_MASK;
+        pad = index + size > LOG_RING_SIZE ? LOG_RING_SIZE - index : 0;
+        end = head + pad + size;
+
+        if (end - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE) > LOG_RING_SIZE)
+        {
+            __atomic_fetch_add(&_dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+    } while (!__atomic_compare_exchange_n(&_head, &head, end, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    if (pad)
+    {
+        log_record *p = (log_record *)&_ring[head & LOG_RING_MASK];
+        __atomic_store_n((uint32_t *)p, pad | (LOG_RECORD_PAD << 16), __ATOMIC_RELEASE);
+    }
+
+    return (log_record *)&_ring[(head + pad) & LOG_RING_MASK];
+}
+
+static void _log(uint8_t kind, const char *layer, const char *module, uint8_t level, const char *filename,
+                 uint32_t line_no, const char *fmt, uint32_t types, va_list ar)
+{
+    uint8_t args[LOG_MAX_ARG_BYTES] __attribute__((aligned(4)));
+    uint16_t arg_bytes;
+    bool isr = is_interrupt_set();
+
+    if (kind == LOG_RECORD_TEXT)
+    {
+        uint16_t n = filename ? strlen(filename) : 0;
+        if (n > LOG_APP_FILENAME_LEN)
+        {
+            filename += n - LOG_APP_FILENAME_LEN;
+            n = LOG_APP_FILENAME_LEN;
+        }
+        if (n)
+            memcpy(args, filename, n);
+        args[n] = 0;
+        filename = NULL;
+
+        uint16_t name_bytes = LOG_ALIGN(n + 1);
+        char *text = (char *)args + name_bytes;
+        vsfmt(text, LOG_MAX_ARG_BYTES - name_bytes, fmt, ar);
+        arg_bytes = name_bytes + LOG_ALIGN(strlen(text) + 1);
+    }
+    else if (kind == LOG_RECORD_TOKEN)
+    {
+        uint32_t *head = (uint32_t *)args;
+        head[0] = types;
+        head[1] = isr ? xTaskGetTickCountFromISR() : xTaskGetTickCount();
+        arg_bytes = _log_pack_args(args, 2 * sizeof(uint32_t), NULL, types, ar);
+    }
+    else
+    {
+        arg_bytes = _log_pack_args(args, 0, fmt, 0, ar);
+    }
+
+    uint16_t size = sizeof(log_record) + arg_bytes;
+    log_record *rec = _log_reserve(size);
+
+    if (rec)
+    {
+        app_running_thread *thread = isr ? NULL : appmanager_get_current_thread();
+
+        rec->layer = layer;
+        rec->module = module;
+        rec->filename = filename;
+        rec->fmt = kind == LOG_RECORD_TEXT ? NULL : fmt;
+        rec->line_no = line_no;
+        rec->thread = thread ? thread->thread_type : -1;
+        rec->isr = isr;
+        rec->arg_bytes = arg_bytes;
+        memcpy(rec->args, args, arg_bytes);
+        __atomic_store_n((uint32_t *)rec, size | (kind << 16) | (level << 24), __ATOMIC_RELEASE);
+    }
+
+    /* Nobody to hand it to yet. With the scheduler only suspended, the
+     * log task picks it up once it's resumed */
+    if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+    {
+        if (!isr)
+            _log_drain();
+        return;
+    }
+
+    if (!_log_task)
+        return;
+
+    if (isr)
+    {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(_log_task, &woken);
+        portYIELD_FROM_ISR(woken);
     }
     else
     {
-        xSemaphoreTake(_log_mutex, portMAX_DELAY);
+        xTaskNotifyGive(_log_task);
+    }
+}
+
+/*
+ * [isr][thread][L][layer ][module][filename     :line ] message
+ */
+static void _log_emit(const log_record *rec)
+{
+    char buf[LOG_LINE_LEN];
+    char tbuf[16];
+    const char *filename = rec->filename;
+    const char *text = (const char *)rec->args;
+
+    if (rec->kind == LOG_RECORD_TEXT)
+    {
+        filename = text;
+        text += LOG_ALIGN(strlen(text) + 1);
     }
 
-    log_clock_enable();
- 
-    
 #define INT_LEN 6
 #define LEVEL_LEN 3
 #define LAYER_LEN 8
 #define MODULE_LEN 8
 #define FILENM_LEN 15
 #define LINENO_LEN 5
- 
-    snprintf(buf, (INT_LEN / 2) + 1, "[%d]", interrupt_set);
-    app_running_thread *thread = appmanager_get_current_thread();
-    snprintf(buf + INT_LEN / 2, (INT_LEN / 2) + 1, "[%d]", thread ? thread->thread_type : -1);
-    
+
+    snprintf(buf, (INT_LEN / 2) + 1, "[%d]", rec->isr);
+    snprintf(buf + INT_LEN / 2, (INT_LEN / 2) + 1, "[%d]", rec->thread);
+
     // This is pretty cheesy. We print the sections in chunks back to back
     // This is becuase there is no %8d equiv in fmt.c so we hacky it up ourself
-    switch(level)
+    switch(rec->level)
     {
         case APP_LOG_LEVEL_ERROR:
             snprintf(buf + INT_LEN, LEVEL_LEN + 1, "[E]");
@@ -94,44 +499,179 @@ void log_printf(const char *layer, const char *module, uint8_t level, const char
         default:
             snprintf(buf + INT_LEN, LEVEL_LEN + 1, "[?]");
     }
-       
-    _log_pad_string(layer, tbuf, LAYER_LEN - 2);
+
+    _log_pad_string(rec->layer, tbuf, LAYER_LEN - 2);
     snprintf(buf + INT_LEN + LEVEL_LEN, LAYER_LEN + 1, "[%s]", tbuf);
-    
-    _log_pad_string(module, tbuf, MODULE_LEN - 2);
+
+    _log_pad_string(rec->module, tbuf, MODULE_LEN - 2);
     snprintf(buf + INT_LEN + LEVEL_LEN + LAYER_LEN, MODULE_LEN + 1, "[%s]", tbuf);
 
     _log_pad_string(filename, tbuf, FILENM_LEN - 2);
     snprintf(buf + INT_LEN + LEVEL_LEN + LAYER_LEN + MODULE_LEN, FILENM_LEN + 2, "[%s", tbuf);
 
-    snprintf(tbuf, LINENO_LEN + 2, ":%d", (int)line_no);
+    snprintf(tbuf, LINENO_LEN + 2, ":%d", (int)rec->line_no);
     _log_pad_string(tbuf, buf + INT_LEN + LEVEL_LEN + LAYER_LEN + MODULE_LEN + FILENM_LEN - 1, LINENO_LEN + 1);
     snprintf(buf + INT_LEN + LEVEL_LEN + LAYER_LEN + MODULE_LEN + FILENM_LEN + LINENO_LEN - 1, 3, "] ");
 
-    vsfmt(buf + INT_LEN + LEVEL_LEN + LAYER_LEN + MODULE_LEN + FILENM_LEN + LINENO_LEN + 1, 128, fmt, ar);
+    char *msg = buf + INT_LEN + LEVEL_LEN + LAYER_LEN + MODULE_LEN + FILENM_LEN + LINENO_LEN + 1;
+    uint16_t msg_len = LOG_LINE_LEN - (msg - buf);
+
+    if (rec->fmt)
+        _log_format(msg, msg_len, rec->fmt, (const uint8_t *)rec->args, rec->arg_bytes);
+    else
+        snprintf(msg, msg_len, "%s", text);
+
+    printf("%s\n", buf);
+}
+
+static uint8_t *_log_varint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+/* small negative numbers stay small */
+static uint64_t _log_zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+/*
+ * One LOG_FRAME_SYNC frame, straight to the debug UART. The longest
+ * message fits LOG_FRAME_MAX: the worst a word gets is 5 bytes
+ */
+static void _log_emit_token(const log_record *rec)
+{
+    uint8_t frame[LOG_FRAME_MAX];
+    const uint8_t *args = (const uint8_t *)rec->args;
+    const uint8_t *end = args + rec->arg_bytes;
+    uint32_t types, ticks;
+    uint8_t *p = frame + 2;
+
+    memcpy(&types, args, sizeof(types));
+    memcpy(&ticks, args + sizeof(types), sizeof(ticks));
+    args += sizeof(types) + sizeof(ticks);
+
+    *p++ = rec->level | (rec->isr ? 0x80 : 0);
+    *p++ = rec->thread + 1;
+    p = _log_varint(p, ticks);
+    p = _log_varint(p, (uint32_t)(uintptr_t)rec->fmt);
+
+    for (; types & 3; types >>= 2)
+    {
+        if ((types & 3) == LOG_ARG_STRING)
+        {
+            if (args >= end)
+                break;
+            uint8_t n = strlen((const char *)args);
+            *p++ = n;
+            memcpy(p, args, n);
+            p += n;
+            args += LOG_ALIGN(n + 1);
+        }
+        else if ((types & 3) == LOG_ARG_INT64)
+        {
+            int64_t v;
+            if (args + sizeof(v) > end)
+                break;
+            memcpy(&v, args, sizeof(v));
+            p = _log_varint(p, _log_zigzag(v));
+            args += sizeof(v);
+        }
+        else
+        {
+            int32_t v;
+            if (args + sizeof(v) > end)
+                break;
+            memcpy(&v, args, sizeof(v));
+            p = _log_varint(p, _log_zigzag(v));
+            args += sizeof(v);
+        }
+    }
+
+    uint8_t sum = 0;
+    for (uint8_t *q = frame + 2; q < p; q++)
+        sum += *q;
+    *p++ = sum;
+
+    frame[0] = LOG_FRAME_SYNC;
+    frame[1] = p - frame - 3;
+    debug_write(frame, p - frame);
+}
 
-    printf(buf);
-    printf("\n");
-    
-    log_clock_disable();
-    
-    if (interrupt_set)
+/*
+ * Write out records in order, up to the first one still being written.
+ * Each is zeroed once done with, so the next lap of the ring finds empty
+ * headers until they are filled in again
+ */
+static void _log_drain(void)
+{
+    uint32_t tail = _tail;
+    bool clock = false;
+
+    while (tail != __atomic_load_n(&_head, __ATOMIC_ACQUIRE))
     {
-        xSemaphoreGiveFromISR(_log_mutex, &xHigherPriorityTaskWoken);
-        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+        log_record *rec = (log_record *)&_ring[tail & LOG_RING_MASK];
+        uint32_t header = __atomic_load_n((uint32_t *)rec, __ATOMIC_ACQUIRE);
+        uint16_t size = header & 0xFFFF;
+        uint8_t kind = (header >> 16) & 0xFF;
+
+        if (kind == LOG_RECORD_EMPTY)
+            break;
+
+        if (kind != LOG_RECORD_PAD)
+        {
+            if (!clock)
+            {
+                log_clock_enable();
+                clock = true;
+            }
+            if (kind == LOG_RECORD_TOKEN)
+                _log_emit_token(rec);
+            else
+                _log_emit(rec);
+        }
+
+        memset(rec, 0, size);
+        tail += size;
+        __atomic_store_n(&_tail, tail, __ATOMIC_RELEASE);
     }
-    else 
+
+    uint32_t dropped = _dropped;
+    if (dropped != _dropped_reported)
     {
-        xSemaphoreGive(_log_mutex);
+        if (!clock)
+        {
+            log_clock_enable();
+            clock = true;
+        }
+        printf("[log] %d messages dropped\n", (int)(dropped - _dropped_reported));
+        _dropped_reported = dropped;
     }
+
+    if (clock)
+        log_clock_disable();
 }
 
+static void _log_thread(void *pvParameters)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        _log_drain();
+    }
+}
 
 static void _log_pad_string(const char *in_str, char *padded_str, uint16_t pad_len)
 {
     int len = strlen(in_str);
     padded_str[0] = 0;
-    
+
     if (len > pad_len)
     {
         // truncate left
@@ -9,6 +9,79 @@
 #include <stdarg.h>
 
 #define NULL_LOG(module_, lvl_, fmt_, ...) {;}
+
+#ifdef LOG_TOKENIZED
+
+/* Tokenized logging. Everything about a log call that is fixed at build
+ * time goes in .log_strings, which is never loaded into flash. The token
+ * is where it ended up in there, and Utilities/mklogdict.py reads them all
+ * back out of the elf. The watch sends the token, a timestamp and the
+ * raw arguments, and Utilities/logdecode.py puts the line back together.
+ * fmt_ has to be a string literal */
+
+#define _LOG_STR_(x_) #x_
+#define _LOG_STR(x_) _LOG_STR_(x_)
+#define _LOG_CAT_(a_, b_) a_##b_
+#define _LOG_CAT(a_, b_) _LOG_CAT_(a_, b_)
+
+/* 2 bits per argument, first argument lowest, 0 when there are no more */
+#define LOG_ARG_NONE   0
+#define LOG_ARG_INT32  1
+#define LOG_ARG_INT64  2
+#define LOG_ARG_STRING 3
+
+/* minilib's printf has no %f, so neither does the decoder. A float
+ * argument gets this instead of a type, which won't build */
+struct log_float_args_are_not_supported { char _; };
+#define _LOG_NO_FLOATS ((struct log_float_args_are_not_supported){ 0 })
+
+#define _LOG_ARG_TYPE(a_) _Generic((a_), \
+            char *: LOG_ARG_STRING, \
+            const char *: LOG_ARG_STRING, \
+            long long: LOG_ARG_INT64, \
+            unsigned long long: LOG_ARG_INT64, \
+            float: _LOG_NO_FLOATS, \
+            double: _LOG_NO_FLOATS, \
+            default: LOG_ARG_INT32)
+
+#define _LOG_NARGS(...) _LOG_NARGS_(_, ##__VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define _LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, n_, ...) n_
+
+#define _LOG_TYPES_0() 0
+#define _LOG_TYPES_1(a_) _LOG_ARG_TYPE(a_)
+#define _LOG_TYPES_2(a_, ...) (_LOG_ARG_TYPE(a_) | _LOG_TYPES_1(__VA_ARGS__) << 2)
+#define _LOG_TYPES_3(a_, ...) (_LOG_ARG_TYPE(a_) | _LOG_TYPES_2(__VA_ARGS__) << 2)
+#define _LOG_TYPES_4(a_, ...) (_LOG_ARG_TYPE(a_) | _LOG_TYPES_3(__VA_ARGS__) << 2)
+#define _LOG_TYPES_5(a_, ...) (_LOG_ARG_TYPE(a_) | _LOG_TYPES_4(__VA_ARGS__) << 2)
+#define _LOG_TYPES_6(a_, ...) (_LOG_ARG_TYPE(a_) | _LOG_TYPES_5(__VA_ARGS__) << 2)
+#define _LOG_TYPES_7(a_, ...) (_LOG_ARG_TYPE(a_) | _LOG_TYPES_6(__VA_ARGS__) << 2)
+#define _LOG_TYPES_8(a_, ...) (_LOG_ARG_TYPE(a_) | _LOG_TYPES_7(__VA_ARGS__) << 2)
+#define _LOG_TYPES_9(a_, ...) (_LOG_ARG_TYPE(a_) | _LOG_TYPES_8(__VA_ARGS__) << 2)
+#define _LOG_TYPES_10(a_, ...) (_LOG_ARG_TYPE(a_) | _LOG_TYPES_9(__VA_ARGS__) << 2)
+#define _LOG_TYPES(...) _LOG_CAT(_LOG_TYPES_, _LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+
+/* layer, module, file, line and fmt, split by \x1f. The first two are
+ * in the order log_printf_to_ar takes them, so a line decodes the same
+ * as it would have printed */
+#define _LOG_TOKEN(layer_, module_, lvl_, fmt_, ...) ({ \
+            static const char _log_token[] __attribute__((section(".log_strings"), used)) = \
+                layer_ "\x1f" module_ "\x1f" __FILE__ "\x1f" _LOG_STR(__LINE__) "\x1f" fmt_; \
+            log_token(lvl_, _log_token, _LOG_TYPES(__VA_ARGS__), ##__VA_ARGS__); \
+        })
+
+#define SYS_LOG(module_, lvl_, fmt_, ...) \
+            _LOG_TOKEN(module_, "SYS", lvl_, fmt_, ##__VA_ARGS__)
+#define KERN_LOG(module_, lvl_, fmt_, ...) \
+            _LOG_TOKEN(module_, "KERN", lvl_, fmt_, ##__VA_ARGS__)
+#define DRV_LOG(module_, lvl_, fmt_, ...) \
+            _LOG_TOKEN(module_, "DRIVER", lvl_, fmt_, ##__VA_ARGS__)
+#define APP_LOG(module_, lvl_, fmt_, ...) \
+            _LOG_TOKEN(module_, "APP", lvl_, fmt_, ##__VA_ARGS__)
+#define __LOG_AR(name_, type_, log_type_, fmt_, ...) \
+            _LOG_TOKEN(name_, type_, log_type_, fmt_, ##__VA_ARGS__)
+
+#else
+
 #define SYS_LOG(module_, lvl_, fmt_, ...) \
             log_printf_to_ar(module_, "SYS", lvl_, __FILE__, __LINE__, fmt_, ##__VA_ARGS__)
 #define KERN_LOG(module_, lvl_, fmt_, ...) \
@@ -18,6 +91,10 @@
 #define APP_LOG(module_, lvl_, fmt_, ...) \
             log_printf_to_ar(module_, "APP", lvl_, __FILE__, __LINE__, fmt_, ##__VA_ARGS__)
 
+#define __LOG_AR(name_, type_, log_type_, fmt_, ...) \
+        log_printf_to_ar(name_, type_, log_type_, __FILE__, __LINE__, fmt_, ##__VA_ARGS__)
+
+#endif
 
 #define _LOG_NONE  0
 #define _LOG_DEBUG 1
@@ -25,28 +102,36 @@
 #define _LOG_WARN  4
 #define _LOG_ERROR 8
 
-#define RBL_LOG_LEVEL_ALL (_LOG_DEBUG | _LOG_INFO | _LOG_ERROR)
-#define RBL_LOG_LEVEL_DEBUG (_LOG_DEBUG | _LOG_INFO | _LOG_ERROR)
-#define RBL_LOG_LEVEL_INFO (_LOG_INFO | _LOG_ERROR)
+#define RBL_LOG_LEVEL_ALL (_LOG_DEBUG | _LOG_INFO | _LOG_WARN | _LOG_ERROR)
+#define RBL_LOG_LEVEL_DEBUG (_LOG_DEBUG | _LOG_INFO | _LOG_WARN | _LOG_ERROR)
+#define RBL_LOG_LEVEL_INFO (_LOG_INFO | _LOG_WARN | _LOG_ERROR)
 #define RBL_LOG_LEVEL_WARN (_LOG_WARN | _LOG_ERROR)
 #define RBL_LOG_LEVEL_ERROR _LOG_ERROR
 #define RBL_LOG_LEVEL_NONE _LOG_NONE
 
-#define __LOG_AR(name_, type_, log_type_, fmt_, ...) \
-        log_printf_to_ar(name_, type_, log_type_, __FILE__, __LINE__, fmt_, ##__VA_ARGS__)
+#include "log_modules.h"
+
+/* LOG_LEVEL and the runtime level of the file's LOG_MODULE, from log_modules.h.
+ * The first is a constant, so when a level isn't built in the whole call,
+ * arguments included, is thrown away even at -O0 */
+#define _LOG_MODCAT_(a_, b_) a_##b_
+#define _LOG_MODCAT(a_, b_) _LOG_MODCAT_(a_, b_)
+#define LOG_LEVEL _LOG_MODCAT(LOG_LEVEL_, LOG_MODULE)
+#define _LOG_ON(lvl_) \
+        ((LOG_LEVEL & (lvl_)) && (log_module_levels[_LOG_MODCAT(LOG_MODULE_, LOG_MODULE)] & (lvl_)))
 
 #define LOG_INFO(fmt_, ...) \
-        if (LOG_LEVEL & _LOG_INFO) \
-            __LOG_AR(MODULE_NAME, MODULE_TYPE, APP_LOG_LEVEL_INFO, fmt_, ##__VA_ARGS__)
+        do { if (_LOG_ON(_LOG_INFO)) \
+            __LOG_AR(MODULE_NAME, MODULE_TYPE, APP_LOG_LEVEL_INFO, fmt_, ##__VA_ARGS__); } while (0)
 #define LOG_DEBUG(fmt_, ...) \
-        if (LOG_LEVEL & _LOG_DEBUG) \
-            __LOG_AR(MODULE_NAME, MODULE_TYPE, APP_LOG_LEVEL_DEBUG, fmt_, ##__VA_ARGS__)
+        do { if (_LOG_ON(_LOG_DEBUG)) \
+            __LOG_AR(MODULE_NAME, MODULE_TYPE, APP_LOG_LEVEL_DEBUG, fmt_, ##__VA_ARGS__); } while (0)
 #define LOG_WARN(fmt_, ...) \
-        if (LOG_LEVEL & _LOG_WARN) \
-            __LOG_AR(MODULE_NAME, MODULE_TYPE, APP_LOG_LEVEL_WARNING, fmt_, ##__VA_ARGS__)
+        do { if (_LOG_ON(_LOG_WARN)) \
+            __LOG_AR(MODULE_NAME, MODULE_TYPE, APP_LOG_LEVEL_WARNING, fmt_, ##__VA_ARGS__); } while (0)
 #define LOG_ERROR(fmt_, ...) \
-        if (LOG_LEVEL & _LOG_ERROR) \
-            __LOG_AR(MODULE_NAME, MODULE_TYPE, APP_LOG_LEVEL_ERROR, fmt_, ##__VA_ARGS__)
+        do { if (_LOG_ON(_LOG_ERROR)) \
+            __LOG_AR(MODULE_NAME, MODULE_TYPE, APP_LOG_LEVEL_ERROR, fmt_, ##__VA_ARGS__); } while (0)
 
 typedef enum LogLevel {
     APP_LOG_LEVEL_ERROR,
@@ -61,3 +146,7 @@ void app_log_trace(uint8_t level, const char *filename, uint32_t f, const char *
 
 void log_printf(const char *layer, const char *module, uint8_t level, const char *filename, uint32_t line_no, const char *fmt, va_list ar);
 void log_printf_to_ar(const char *layer, const char *module, uint8_t level, const char *filename, uint32_t line_no, const char *fmt, ...);
+void log_init(void);
+void log_flush(void);
+uint32_t log_dropped_count(void);
+void log_token(uint8_t level, const char *token, uint32_t types, ...);
@@ -0,0 +1,93 @@
+#pragma once
+/* log_modules.h
+ * The log levels each module is built with
+ * RebbleOS
+ *
+ * A file opts in with #define LOG_MODULE <NAME> (along with MODULE_NAME
+ * and MODULE_TYPE) and logs with LOG_DEBUG/INFO/WARN/ERROR. Any level not
+ * in LOG_LEVEL_<NAME> compiles to nothing, arguments and all. The rest can
+ * be turned off while running with log_module_set_level().
+ *
+ * To change one without touching this, add it to localconfig.mk, like
+ *   CFLAGS_all += -DLOG_LEVEL_APPMAN=RBL_LOG_LEVEL_DEBUG
+ */
+
+#include <stdint.h>
+
+/* every module, for the runtime table */
+#define LOG_MODULE_LIST(X) \
+    X(APPMAN) \
+    X(APPLOOP) \
+    X(RES) \
+    X(RTIME) \
+    X(MEM) \
+    X(ANIM) \
+    X(GRAPHICS) \
+    X(WINDOW) \
+    X(LAYER) \
+    X(PHPKT) \
+    X(ENDPT)
+
+#ifndef LOG_LEVEL_APPMAN
+#  define LOG_LEVEL_APPMAN RBL_LOG_LEVEL_INFO
+#endif
+
+/* logs every frame at debug */
+#ifndef LOG_LEVEL_APPLOOP
+#  define LOG_LEVEL_APPLOOP RBL_LOG_LEVEL_INFO
+#endif
+
+#ifndef LOG_LEVEL_RES
+#  define LOG_LEVEL_RES RBL_LOG_LEVEL_WARN
+#endif
+
+#ifndef LOG_LEVEL_RTIME
+#  define LOG_LEVEL_RTIME RBL_LOG_LEVEL_WARN
+#endif
+
+#ifndef LOG_LEVEL_MEM
+#  define LOG_LEVEL_MEM RBL_LOG_LEVEL_WARN
+#endif
+
+/* info is every animation scheduled and finished */
+#ifndef LOG_LEVEL_ANIM
+#  define LOG_LEVEL_ANIM RBL_LOG_LEVEL_WARN
+#endif
+
+/* debug is every primitive drawn */
+#ifndef LOG_LEVEL_GRAPHICS
+#  define LOG_LEVEL_GRAPHICS RBL_LOG_LEVEL_WARN
+#endif
+
+/* debug is the damage of every frame */
+#ifndef LOG_LEVEL_WINDOW
+#  define LOG_LEVEL_WINDOW RBL_LOG_LEVEL_INFO
+#endif
+
+/* debug is cache hits and tree dumps */
+#ifndef LOG_LEVEL_LAYER
+#  define LOG_LEVEL_LAYER RBL_LOG_LEVEL_INFO
+#endif
+
+/* notification parsing from the phone. Debug is every attribute */
+#ifndef LOG_LEVEL_PHPKT
+#  define LOG_LEVEL_PHPKT RBL_LOG_LEVEL_WARN
+#endif
+
+/* info is unknown endpoints and the stats dump */
+#ifndef LOG_LEVEL_ENDPT
+#  define LOG_LEVEL_ENDPT RBL_LOG_LEVEL_INFO
+#endif
+
+#define _LOG_MODULE_ENUM(name_) LOG_MODULE_##name_,
+
+typedef enum LogModule {
+    LOG_MODULE_LIST(_LOG_MODULE_ENUM)
+    LOG_MODULE_COUNT
+} LogModule;
+
+/* what each module is logging now, a subset of what it was built with */
+extern uint8_t log_module_levels[LOG_MODULE_COUNT];
+
+void log_module_set_level(LogModule module, uint8_t level);
+uint8_t log_module_get_level(LogModule module);
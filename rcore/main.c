@@ -34,6 +34,7 @@ void hardware_init(void)
 {
     platform_init();
     debug_init();
+    log_init();
     KERN_LOG("init", APP_LOG_LEVEL_INFO, "Debug Init");
     rcore_watchdog_init_early();
     KERN_LOG("init", APP_LOG_LEVEL_INFO, "Watchdog Init");
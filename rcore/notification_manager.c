@@ -16,8 +16,22 @@ static void _notif_timeout_cb(void *data);
 static void _notif_init(OverlayWindow *overlay_window);
 static void _notification_window_creating(OverlayWindow *overlay_window, Window *window);
 static void _notification_quit_click(ClickRecognizerRef _, void *context);
+static void _notification_queue_message(full_msg_t *msg, uint32_t timeout_ms);
+static void _notification_merge_pending(void *context);
 extern bool battery_overlay_visible(void);
 
+/* There is only one message window. Messages that come while it is up,
+ * or on its way up, wait here for the overlay thread to add them to it.
+ * However many come, there is only one update waiting on the overlay queue */
+#define NOTY_PENDING_MAX NOTIFICATION_WINDOW_MAX_MESSAGES
+
+static notification_message *_msg_window;
+static full_msg_t *_pending[NOTY_PENDING_MAX];
+static uint8_t _pending_count;
+static bool _merge_posted;
+static uint32_t _msg_timeout_ms;
+static NotificationBurstStats _burst_stats;
+
 uint8_t notification_init(void)
 {
     messages_init();
@@ -27,24 +41,196 @@ uint8_t notification_init(void)
 
 void notification_show_message(full_msg_t *msg, uint32_t timeout_ms)
 {
+    /* until it has been shown, or given up on */
+    message_pin(msg);
     message_add(msg);
-    
-    if (!message_count())
+    _notification_queue_message(msg, timeout_ms);
+}
+
+void notification_burst_stats(NotificationBurstStats *stats)
+{
+    taskENTER_CRITICAL();
+    *stats = _burst_stats;
+    taskEXIT_CRITICAL();
+}
+
+static uint8_t _notification_take_pending(full_msg_t **msgs, notification_message **nm)
+{
+    taskENTER_CRITICAL();
+    uint8_t count = _pending_count;
+    memcpy(msgs, _pending, count * sizeof(full_msg_t *));
+    _pending_count = 0;
+    _merge_posted = false;
+    *nm = _msg_window;
+    taskEXIT_CRITICAL();
+
+    return count;
+}
+
+static void _notification_not_shown(full_msg_t *msg)
+{
+    /* the store can have it back */
+    message_unpin(msg);
+    taskENTER_CRITICAL();
+    _burst_stats.not_shown++;
+    taskEXIT_CRITICAL();
+}
+
+static void _notification_queue_message(full_msg_t *msg, uint32_t timeout_ms)
+{
+    notification_message *nmsg = NULL;
+    bool open = false, queued = false, post = false;
+
+    _msg_timeout_ms = timeout_ms;
+
+    if (!_msg_window)
+        nmsg = noty_calloc(1, sizeof(notification_message));
+
+    taskENTER_CRITICAL();
+    if (!_msg_window && nmsg)
     {
-        SYS_LOG("NOTY", APP_LOG_LEVEL_ERROR, "No Messages?");
+        _msg_window = nmsg;
+        open = true;
+    }
+    else if (_msg_window && _pending_count < NOTY_PENDING_MAX)
+    {
+        _pending[_pending_count++] = msg;
+        queued = true;
+        post = !_merge_posted;
+        _merge_posted = true;
+    }
+    taskEXIT_CRITICAL();
+
+    if (open)
+    {
+        nmsg->data.create_callback = &notification_message_display;
+        nmsg->message = msg;
+        nmsg->data.timeout_ms = timeout_ms;
+        nmsg->data.timer = 0;
+
+        /* get an overlay */
+        if (overlay_window_create_with_context(_notification_window_creating, (void *)nmsg))
+        {
+            taskENTER_CRITICAL();
+            _burst_stats.windows++;
+            taskEXIT_CRITICAL();
+            return;
+        }
+
+        SYS_LOG("NOTYM", APP_LOG_LEVEL_ERROR, "Overlay busy, message not shown");
+        full_msg_t *msgs[NOTY_PENDING_MAX];
+        notification_message *nm;
+        uint8_t count = _notification_take_pending(msgs, &nm);
+        taskENTER_CRITICAL();
+        _msg_window = NULL;
+        taskEXIT_CRITICAL();
+        for (uint8_t i = 0; i < count; i++)
+            _notification_not_shown(msgs[i]);
+        _notification_not_shown(msg);
+        noty_free(nmsg);
         return;
     }
 
-    notification_message *nmsg = noty_calloc(1, sizeof(notification_message));
-    nmsg->data.create_callback = &notification_message_display;
-    nmsg->message = msg;
-    nmsg->data.timeout_ms = timeout_ms;
-    nmsg->data.timer = 0;
-    
-    /* get an overlay */
-    overlay_window_create_with_context(_notification_window_creating, (void *)nmsg);
-    
-    SYS_LOG("NOTYM", APP_LOG_LEVEL_INFO, "Done");
+    /* someone else got a window up first */
+    if (nmsg)
+        noty_free(nmsg);
+
+    if (!queued)
+    {
+        _notification_not_shown(msg);
+        return;
+    }
+
+    if (post && !overlay_window_post_callback(_notification_merge_pending, NULL))
+    {
+        /* the next message tries again */
+        taskENTER_CRITICAL();
+        _merge_posted = false;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/* overlay thread. Put everything waiting into the window in one go */
+static void _notification_merge_pending(void *context)
+{
+    full_msg_t *msgs[NOTY_PENDING_MAX];
+    notification_message *nm;
+    uint8_t count = _notification_take_pending(msgs, &nm);
+
+    if (!count)
+        return;
+
+    if (!nm)
+    {
+        /* it closed before they got in. They get the next window */
+        for (uint8_t i = 0; i < count; i++)
+            _notification_queue_message(msgs[i], _msg_timeout_ms);
+        return;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!nm->notification_layer)
+        {
+            /* not loaded yet, put them back until it is */
+            for (; i < count; i++)
+                _notification_queue_message(msgs[i], _msg_timeout_ms);
+            return;
+        }
+
+        if (nm->merged_count == NOTIFICATION_WINDOW_MAX_MESSAGES - 1)
+        {
+            _notification_not_shown(msgs[i]);
+            continue;
+        }
+
+        nm->merged[nm->merged_count++] = msgs[i];
+        notification_message_append(nm, msgs[i]);
+        taskENTER_CRITICAL();
+        _burst_stats.merged++;
+        taskEXIT_CRITICAL();
+    }
+
+    /* and it is up for the full time again from the newest */
+    if (nm->data.timer)
+        app_timer_cancel(nm->data.timer);
+    nm->data.timer = 0;
+    if (nm->data.timeout_ms)
+        nm->data.timer = app_timer_register(nm->data.timeout_ms,
+                                            (AppTimerCallback)_notif_timeout_cb, nm);
+
+    window_dirty(true);
+}
+
+/* overlay thread, as the message window unloads */
+void notification_message_closed(notification_message *nm)
+{
+    full_msg_t *msgs[NOTY_PENDING_MAX];
+    notification_message *current;
+    uint8_t count = 0;
+
+    /* the store can have them back */
+    message_unpin(nm->message);
+    for (uint8_t i = 0; i < nm->merged_count; i++)
+        message_unpin(nm->merged[i]);
+
+    taskENTER_CRITICAL();
+    bool was_current = _msg_window == nm;
+    if (was_current)
+        _msg_window = NULL;
+    taskEXIT_CRITICAL();
+
+    /* the timer is ours to cancel on this thread, then nothing has it */
+    if (nm->data.timer)
+        app_timer_cancel(nm->data.timer);
+    nm->data.timer = 0;
+    noty_free(nm);
+
+    /* anything still waiting for it gets a window of its own */
+    if (was_current)
+        count = _notification_take_pending(msgs, &current);
+    for (uint8_t i = 0; i < count; i++)
+        _notification_queue_message(msgs[i], _msg_timeout_ms);
 }
 
 void notification_show_battery(uint32_t timeout_ms)
@@ -123,21 +309,29 @@ static void _notification_quit_click(ClickRecognizerRef _, void *context)
 {
     notification_message *nm = (notification_message *)context;
     
-    if (!nm->data.overlay_window) {
+    if (!nm || !nm->data.overlay_window) {
         printf("notification window was already dead?\n");
         return;
     }
     
-    if (nm->data.destroy_callback)
-        nm->data.destroy_callback(nm->data.overlay_window, &nm->data.overlay_window->window);
-    overlay_window_destroy(nm->data.overlay_window);
+    /* new messages get a new window, not this one on its way out */
+    taskENTER_CRITICAL();
+    if (_msg_window == nm)
+        _msg_window = NULL;
+    taskEXIT_CRITICAL();
+    
+    /* a message window is freed as it unloads, which can be as soon as
+     * the destroy is posted, so nm is left alone from there on */
+    OverlayWindow *overlay_window = nm->data.overlay_window;
     nm->data.overlay_window = NULL;
+    if (nm->data.destroy_callback)
+        nm->data.destroy_callback(overlay_window, &overlay_window->window);
+    overlay_window_destroy(overlay_window);
     window_set_click_context(BUTTON_ID_BACK, NULL);
     
     /* We don't cancel the timer here (if there was one), because we're
      * running from the app thread, and the app timer lives on the overlay
-     * thread.  So if it needs to, we just let it die off on its own, and
-     * waste the wakeup later.  Oh, well.
+     * thread. notification_message_closed cancels it as the window goes.
      */
     SYS_LOG("NOTYM", APP_LOG_LEVEL_INFO, "DESTROY _notification_quit_click\n\n");
     window_dirty(true);
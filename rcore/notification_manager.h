@@ -19,11 +19,27 @@ uint8_t notification_init(void);
 /**
  * @brief Show a fullscreen message
  * 
+ * While a message window is up, new messages are added to it and its
+ * timeout starts again, rather than each getting a window of its own.
+ * 
  * @param msg \ref full_msg_t a fully structured protocol message
  * @param timeout_ms Time in ms before we auto close the window. 0 is disabled
  */
 void notification_show_message(full_msg_t *msg, uint32_t timeout_ms);
 
+typedef struct NotificationBurstStats {
+    uint32_t windows;   // message windows opened
+    uint32_t merged;    // messages added to a window already up
+    uint32_t not_shown; // window full or closing. Still in the store
+} NotificationBurstStats;
+
+/**
+ * @brief How many messages got to the screen, and how
+ * 
+ * @param stats filled in
+ */
+void notification_burst_stats(NotificationBurstStats *stats);
+
 /**
  * @brief Show a battery overlay. Shows current battery status
  * 
@@ -66,10 +82,17 @@ typedef struct notification_data_t {
     uint32_t timeout_ms;
 } notification_data;
 
+/* the most messages one window shows. They stay pinned in the store
+ * while it is up, so this keeps a burst from pinning all of it */
+#define NOTIFICATION_WINDOW_MAX_MESSAGES 16
+
 typedef struct notification_message_t {
     notification_data data;
     NotificationLayer *notification_layer;
     full_msg_t *message;
+    /* added while the window was up */
+    full_msg_t *merged[NOTIFICATION_WINDOW_MAX_MESSAGES - 1];
+    uint8_t merged_count;
 } notification_message;
 
 typedef struct notification_battery_t {
@@ -82,3 +105,7 @@ typedef struct notification_mini_msg_t {
     uint16_t icon;
     GRect frame;
 } notification_mini_msg;
+
+/* Internal. Overlay thread only */
+void notification_message_append(notification_message *nm, full_msg_t *msg);
+void notification_message_closed(notification_message *nm);
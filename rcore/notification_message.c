@@ -15,18 +15,33 @@
  * messages in here. 
  * XXX when we have write
  * 
+ * Messages only get MSG_STORE_BUDGET of the heap, the rest is for the
+ * overlays showing them. When a new one won't fit, the oldest go.
+ * Every message is one block (see notification_packet_push) so it can be
+ * moved to close up the holes the evicted ones leave.
+ *
+ * Messages come in on the endpoint thread and are shown on the overlay
+ * and app threads, so the list, the heap and the pins are all under
+ * _store_mutex. It is recursive, so the store can use its own calls.
  */
 #define MSG_HEAP_SIZE 10000
+#define MSG_STORE_BUDGET 8000
 
 static uint8_t _notification_messages_heap[MSG_HEAP_SIZE] CCRAM;
 static qarena_t *_notification_arena;
+/* newest first */
 static list_head _messages_head = LIST_HEAD(_messages_head);
+static MessageStoreStats _store_stats;
+static SemaphoreHandle_t _store_mutex;
+static StaticSemaphore_t _store_mutex_buf;
 
 static full_msg_t *_fake_message(char *text, char *action);
+static void _message_remove(full_msg_t *msg);
 
 
 void messages_init(void)
 {
+    _store_mutex = xSemaphoreCreateRecursiveMutexStatic(&_store_mutex_buf);
     _notification_arena = qinit(_notification_messages_heap, MSG_HEAP_SIZE);
 
     /* create three samples */
@@ -57,12 +72,197 @@ static full_msg_t *_fake_message(char *text, char *action)
     return m;
 }
 
+void message_store_lock(void)
+{
+    xSemaphoreTakeRecursive(_store_mutex, portMAX_DELAY);
+}
+
+void message_store_unlock(void)
+{
+    xSemaphoreGiveRecursive(_store_mutex);
+}
+
 void message_add(full_msg_t *msg)
 {
     /* we need to get the message into our list
      * it should already be allocated on our heap */
+    message_store_lock();
     list_init_node(&msg->node);
     list_insert_head(&_messages_head, &msg->node);
+
+    _store_stats.count++;
+    _store_stats.bytes += msg->size;
+    if (_store_stats.count > _store_stats.count_max)
+        _store_stats.count_max = _store_stats.count;
+    message_store_unlock();
+}
+
+void message_remove(full_msg_t *msg)
+{
+    message_store_lock();
+    _message_remove(msg);
+    noty_free(msg);
+    message_store_unlock();
+}
+
+void message_pin(full_msg_t *msg)
+{
+    message_store_lock();
+    msg->pins++;
+    message_store_unlock();
+}
+
+void message_unpin(full_msg_t *msg)
+{
+    message_store_lock();
+    if (msg->pins)
+        msg->pins--;
+    message_store_unlock();
+}
+
+static void _message_remove(full_msg_t *msg)
+{
+    list_remove(&_messages_head, &msg->node);
+    _store_stats.count--;
+    _store_stats.bytes -= msg->size;
+}
+
+/*
+ * Drop the oldest message that isn't on screen.
+ * XXX spill it to flash first, once we can write it. It's one block
+ */
+static bool _message_evict(void)
+{
+    full_msg_t *msg;
+    list_node *l = list_get_tail(&_messages_head);
+
+    for (; l; l = list_get_prev(&_messages_head, l))
+    {
+        msg = list_elem(l, full_msg_t, node);
+        if (msg->pins)
+            continue;
+
+        _message_remove(msg);
+        noty_free(msg);
+        _store_stats.evicted++;
+        return true;
+    }
+
+    return false;
+}
+
+/* everything in the message pointing inside it moves with it */
+#define _MSG_RELOCATE(ptr_) \
+    do { \
+        if ((uint8_t *)(ptr_) >= old && (uint8_t *)(ptr_) < old + msg->size) \
+            (ptr_) = (void *)((uint8_t *)(ptr_) + delta); \
+    } while (0)
+
+static void _message_relocate_list(full_msg_t *msg, list_head *head, uint8_t *old, ptrdiff_t delta)
+{
+    list_node *n = &head->node;
+    do {
+        _MSG_RELOCATE(n->next);
+        _MSG_RELOCATE(n->prev);
+        n = n->next;
+    } while (n != &head->node);
+}
+
+/*
+ * Close up the holes. qalloc is first fit, so a fresh allocation lands in
+ * the lowest hole it fits; if that is below the message, move it down.
+ * Called with the store locked, so nothing can pin a message or walk the
+ * list while it moves
+ */
+static void _message_compact(void)
+{
+    full_msg_t *msg;
+    list_node *l = list_get_head(&_messages_head);
+
+    _store_stats.compactions++;
+
+    for (; l; l = list_get_next(&_messages_head, l))
+    {
+        msg = list_elem(l, full_msg_t, node);
+        if (msg->pins)
+            continue;
+
+        full_msg_t *moved = qalloc(_notification_arena, msg->size);
+        if (!moved)
+            continue;
+        if (moved > msg)
+        {
+            qfree(_notification_arena, moved);
+            continue;
+        }
+
+        uint8_t *old = (uint8_t *)msg;
+        ptrdiff_t delta = (uint8_t *)moved - old;
+
+        memcpy(moved, msg, msg->size);
+        _MSG_RELOCATE(moved->header);
+        _message_relocate_list(msg, &moved->attributes_list_head, old, delta);
+        _message_relocate_list(msg, &moved->actions_list_head, old, delta);
+
+        cmd_phone_attribute_t *a;
+        list_foreach(a, &moved->attributes_list_head, cmd_phone_attribute_t, node)
+            _MSG_RELOCATE(a->data);
+        cmd_phone_action_t *act;
+        list_foreach(act, &moved->actions_list_head, cmd_phone_action_t, node)
+            _MSG_RELOCATE(act->data);
+
+        /* and swap it into the store where the old one was */
+        list_insert_after(&_messages_head, &msg->node, &moved->node);
+        list_remove(&_messages_head, &msg->node);
+        qfree(_notification_arena, msg);
+        l = &moved->node;
+    }
+}
+
+void *message_alloc(size_t size)
+{
+    uint32_t free_bytes, largest;
+    bool compacted = false;
+
+    message_store_lock();
+
+    /* keep to the budget */
+    while (_store_stats.bytes + size > MSG_STORE_BUDGET && _message_evict())
+        ;
+
+    for (;;)
+    {
+        void *x = noty_calloc(1, size);
+        if (x)
+        {
+            message_store_unlock();
+            return x;
+        }
+
+        /* there's room, just not in one piece. Moving everything is
+         * slow, so only once, and after that just make more room */
+        noty_heap_stats(&free_bytes, &largest);
+        if (!compacted && free_bytes > size)
+        {
+            _message_compact();
+            compacted = true;
+            continue;
+        }
+
+        if (!_message_evict())
+            break;
+    }
+
+    _store_stats.failed++;
+    message_store_unlock();
+    return NULL;
+}
+
+void message_store_stats(MessageStoreStats *stats)
+{
+    message_store_lock();
+    *stats = _store_stats;
+    message_store_unlock();
 }
 
 list_head *message_get_head(void)
@@ -73,12 +273,13 @@ list_head *message_get_head(void)
 uint16_t message_count(void)
 {
     uint16_t count = 0;
-    if (list_get_head(&_messages_head) == NULL)
-        return 0;
-    
     full_msg_t *w;
-    list_foreach(w, &_messages_head, full_msg_t, node)
-        count++;
+
+    message_store_lock();
+    if (list_get_head(&_messages_head))
+        list_foreach(w, &_messages_head, full_msg_t, node)
+            count++;
+    message_store_unlock();
 
     return count;
 }
@@ -86,7 +287,9 @@ uint16_t message_count(void)
 void *noty_calloc(size_t count, size_t size)
 {
     /* uses a special qarena */
+    message_store_lock();
     void *x = qalloc(_notification_arena, count * size);
+    message_store_unlock();
     if (x != NULL)
         memset(x, 0, count * size);
     return x;
@@ -94,6 +297,16 @@ void *noty_calloc(size_t count, size_t size)
 
 void noty_free(void *mem)
 {
+    message_store_lock();
     qfree(_notification_arena, mem);
+    message_store_unlock();
+}
+
+void noty_heap_stats(uint32_t *free_bytes, uint32_t *largest_free)
+{
+    message_store_lock();
+    *free_bytes = qfreebytes(_notification_arena);
+    *largest_free = qlargestfree(_notification_arena);
+    message_store_unlock();
 }
 
@@ -27,6 +27,39 @@ void *noty_calloc(size_t count, size_t size);
  */
 void noty_free(void *mem);
 
+/**
+ * @brief Allocate a message block of size bytes, making room in the store
+ * for it by dropping the oldest messages and compacting the heap.
+ * 
+ * @param size the whole block, see notification_packet_push
+ * @return zeroed memory, or NULL if it won't fit even in an empty store
+ */
+void *message_alloc(size_t size);
+
+typedef struct MessageStoreStats {
+    uint16_t count;       // messages kept now
+    uint16_t count_max;   // most ever kept at once
+    uint32_t bytes;       // of the budget in use
+    uint32_t evicted;     // dropped, oldest first, to fit new ones
+    uint32_t compactions; // times the heap had room, but not in one piece
+    uint32_t failed;      // couldn't make room at all
+} MessageStoreStats;
+
+/**
+ * @brief What the store has been up to
+ * 
+ * @param stats filled in
+ */
+void message_store_stats(MessageStoreStats *stats);
+
+/**
+ * @brief How much of the message heap is free, and the biggest block of it
+ * 
+ * @param free_bytes bytes free
+ * @param largest_free bytes in the biggest free block
+ */
+void noty_heap_stats(uint32_t *free_bytes, uint32_t *largest_free);
+
 /**
  * @brief Return a count of the messages in the list
  * 
@@ -40,3 +73,33 @@ uint16_t message_count(void);
  * @param full_msg_t the pebble message to add
  */
 void message_add(full_msg_t *msg);
+
+/**
+ * @brief Take a message out of the store and free it
+ * 
+ * @param msg a message that was added with \ref message_add
+ */
+void message_remove(full_msg_t *msg);
+
+/**
+ * @brief Pin a message so the store neither evicts nor moves it while
+ * something is showing it. Pins count, so each needs its own unpin
+ * 
+ * @param msg the message
+ */
+void message_pin(full_msg_t *msg);
+
+/**
+ * @brief Let go of a pin from \ref message_pin
+ * 
+ * @param msg the message
+ */
+void message_unpin(full_msg_t *msg);
+
+/**
+ * @brief Hold the store still. Anything walking \ref message_get_head
+ * has to, as a new message can evict or move the ones in there.
+ * Calls into the store are fine while it is held
+ */
+void message_store_lock(void);
+void message_store_unlock(void);
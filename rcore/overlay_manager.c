@@ -20,13 +20,53 @@ typedef struct OverlayMessage {
 #define OVERLAY_DRAW       1
 #define OVERLAY_DESTROY    2
 #define OVERLAY_APP_BUTTON 3
+#define OVERLAY_DRAW_PLANE 4
+#define OVERLAY_CALLBACK   5
+
+/* room for a create, a destroy and a few updates to be waiting at once */
+#define OVERLAY_QUEUE_SIZE 8
+
+/* Overlays are painted into a plane of their own only when they change.
+ * The plane is laid over the app after every app frame, which saves a trip
+ * through the overlay thread and a full app repaint each frame */
+typedef struct OverlayPlane {
+    GRect rect;         /* rows the overlays painted in. Always full width */
+    uint8_t *pixels;    /* rect.size.h rows of what they painted */
+#ifdef PBL_BW
+    uint8_t *mask;      /* and a bit set for each pixel they painted */
+#endif
+    uint8_t *row_kind;  /* OVERLAY_ROW_x, so whole rows can be skipped or copied */
+    bool valid;         /* false if it didn't fit, so the overlays draw over each frame */
+    bool painted_over;  /* the last render used the framebuffer as scratch */
+} OverlayPlane;
+
+#define OVERLAY_ROW_CLEAR  0
+#define OVERLAY_ROW_OPAQUE 1
+#define OVERLAY_ROW_MIXED  2
+
+/* leave the overlays this much of their heap once the plane is in */
+#define OVERLAY_PLANE_HEAP_RESERVE 2048
+
+#ifdef PBL_BW
+/* bytes of a row that are on screen. The rest is padding */
+#define OVERLAY_ROW_PIXEL_BYTES (DISPLAY_COLS / 8)
+#endif
+
+static OverlayPlane _plane;
+static bool _plane_dirty = false;
+static bool _plane_failed = false;
 
 static xQueueHandle _overlay_queue;
+static uint8_t _overlay_queue_contents[OVERLAY_QUEUE_SIZE * sizeof(OverlayMessage)];
+static StaticQueue_t _overlay_queue_buf;
 static void _overlay_thread(void *pvParameters);
 static list_head _overlay_window_list_head = LIST_HEAD(_overlay_window_list_head);
 static void _overlay_window_draw(bool window_is_dirty);
 static void _overlay_window_create(OverlayCreateCallback create_callback, void *context);
 static void _overlay_window_destroy(OverlayWindow *overlay_window, bool animated);
+static void _overlay_plane_render(void);
+static void _overlay_plane_free(void);
+static void _overlay_stack_changed(void);
 
 /* Semaphore to start drawing */
 static SemaphoreHandle_t _ovl_done_sem;
@@ -36,8 +76,8 @@ uint8_t overlay_window_init(void)
 {   
     _ovl_done_sem = xSemaphoreCreateBinaryStatic(&_ovl_done_sem_buf);
 
-    // XXX make static
-    _overlay_queue = xQueueCreate(1, sizeof(struct OverlayMessage));
+    _overlay_queue = xQueueCreateStatic(OVERLAY_QUEUE_SIZE, sizeof(OverlayMessage),
+                                        _overlay_queue_contents, &_overlay_queue_buf);
    
     app_running_thread *thread = appmanager_get_thread(AppThreadOverlay);
     thread->status = AppThreadLoading;
@@ -55,24 +95,29 @@ uint8_t overlay_window_init(void)
 /*
  * Create a new top level window and all of the contents therein
  */
-void overlay_window_create(OverlayCreateCallback creation_callback)
+bool overlay_window_create(OverlayCreateCallback creation_callback)
+{
+    return overlay_window_create_with_context(creation_callback, NULL);
+}
+
+bool overlay_window_create_with_context(OverlayCreateCallback creation_callback, void *context)
 {
     OverlayMessage om = (OverlayMessage) {
         .command = OVERLAY_CREATE,
         .data = (void *)creation_callback,
-        .context = NULL
+        .context = context
     };
-    xQueueSendToBack(_overlay_queue, &om, 0);
+    return xQueueSendToBack(_overlay_queue, &om, 0) == pdTRUE;
 }
 
-void overlay_window_create_with_context(OverlayCreateCallback creation_callback, void *context)
+bool overlay_window_post_callback(OverlayCallback callback, void *context)
 {
     OverlayMessage om = (OverlayMessage) {
-        .command = OVERLAY_CREATE,
-        .data = (void *)creation_callback,
+        .command = OVERLAY_CALLBACK,
+        .data = (void *)callback,
         .context = context
     };
-    xQueueSendToBack(_overlay_queue, &om, 0);
+    return xQueueSendToBack(_overlay_queue, &om, 0) == pdTRUE;
 }
 
 void overlay_window_draw(bool window_is_dirty)
@@ -87,6 +132,113 @@ void overlay_window_draw(bool window_is_dirty)
 }
 
 
+/*
+ * Something an overlay paints has changed. It is painted into the plane
+ * again before the next app frame
+ */
+void overlay_window_dirty(void)
+{
+    OverlayWindow *ow = overlay_stack_get_top_overlay_window();
+
+    _plane_dirty = true;
+    if (ow)
+        ow->window.is_render_scheduled = true;
+}
+
+/*
+ * Bring the overlay plane up to date before the app draws.
+ * From the app thread, holding the display lock
+ */
+void overlay_window_plane_update(void)
+{
+    if (!_plane_dirty)
+        return;
+
+    _plane_dirty = false;
+
+    /* it didn't fit last time and the overlays are the same ones, so don't try again */
+    if (_plane_failed)
+        return;
+
+    GRect old = _plane.valid ? _plane.rect : GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS);
+
+#ifdef DISPLAY_DEBUG_STATS
+    TickType_t start = xTaskGetTickCount();
+#endif
+    OverlayMessage om = (OverlayMessage) {
+        .command = OVERLAY_DRAW_PLANE,
+    };
+    xQueueSendToBack(_overlay_queue, &om, 1000);
+    xSemaphoreTake(_ovl_done_sem, portMAX_DELAY);
+
+#ifdef DISPLAY_DEBUG_STATS
+    SYS_LOG("ov win", APP_LOG_LEVEL_DEBUG, "plane %s: rows %d-%d in %dms",
+            _plane.valid ? "rendered" : "didn't fit",
+            _plane.rect.origin.y, _plane.rect.origin.y + _plane.rect.size.h - 1,
+            (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+#endif
+
+    /* Whatever was under the overlays before has to come back. If the
+     * framebuffer was used to render them, that is the lot */
+    if (_plane.painted_over)
+        window_dirty(true);
+    else
+        window_dirty_rect(window_stack_get_top_window(), old);
+}
+
+/*
+ * True if the overlays are all in the plane, rather than painted over
+ * the app on every frame
+ */
+bool overlay_window_plane_valid(void)
+{
+    return _plane.valid && !_plane_failed;
+}
+
+/*
+ * Lay the overlays over a freshly drawn app frame.
+ * From the app thread, holding the display lock
+ */
+void overlay_window_composite(void)
+{
+    if (!overlay_window_plane_valid())
+    {
+        overlay_window_draw(true);
+        return;
+    }
+
+    uint8_t *fb = display_get_buffer();
+
+    for (uint16_t i = 0; i < _plane.rect.size.h; i++)
+    {
+        uint8_t *row = fb + (_plane.rect.origin.y + i) * DISPLAY_ROW_BYTES;
+        uint8_t *px = _plane.pixels + i * DISPLAY_ROW_BYTES;
+
+        switch (_plane.row_kind[i])
+        {
+            case OVERLAY_ROW_OPAQUE:
+                memcpy(row, px, DISPLAY_ROW_BYTES);
+                break;
+            case OVERLAY_ROW_MIXED:
+            {
+#ifdef PBL_BW
+                uint8_t *mask = _plane.mask + i * DISPLAY_ROW_BYTES;
+                for (uint16_t b = 0; b < OVERLAY_ROW_PIXEL_BYTES; b++)
+                    row[b] = (row[b] & ~mask[b]) | (px[b] & mask[b]);
+#else
+                /* nothing paints 0, it has no alpha */
+                for (uint16_t x = 0; x < DISPLAY_COLS; x++)
+                    if (px[x])
+                        row[x] = px[x];
+#endif
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
 void overlay_window_destroy(OverlayWindow *overlay_window)
 {
     OverlayMessage om = (OverlayMessage) {
@@ -146,6 +298,7 @@ void overlay_window_stack_push(OverlayWindow *overlay_window, bool animated)
     list_init_node(&overlay_window->node);
     list_insert_head(&_overlay_window_list_head, &overlay_window->node);
     
+    _overlay_stack_changed();
     overlay_window->window.is_render_scheduled = true;
     window_dirty(true);
 }
@@ -236,6 +389,7 @@ static void _overlay_window_destroy(OverlayWindow *overlay_window, bool animated
         
     list_remove(&_overlay_window_list_head, &overlay_window->node);
     app_free(overlay_window);
+    _overlay_stack_changed();
     
     Window *top_window = overlay_window_get_next_window_with_click_config();
     if (top_window == NULL)
@@ -278,6 +432,166 @@ static void _overlay_window_draw(bool window_is_dirty)
     xSemaphoreGive(_ovl_done_sem);     
 }
 
+/*
+ * The overlays are different ones now, so there is another go at
+ * fitting them in the plane
+ */
+static void _overlay_stack_changed(void)
+{
+    _plane_failed = false;
+    _plane_dirty = true;
+}
+
+static void _overlay_window_paint_all(void)
+{
+    OverlayWindow *ow;
+    list_foreach(ow, &_overlay_window_list_head, OverlayWindow, node)
+    {
+        rbl_window_draw(&ow->window);
+        ow->window.is_render_scheduled = false;
+    }
+}
+
+/*
+ * Paint the overlays into the framebuffer over a background they can't
+ * paint themselves, and keep the rows they touched.
+ * The app thread is waiting on us with the display lock held.
+ */
+static void _overlay_plane_render(void)
+{
+    uint8_t *fb = display_get_buffer();
+    int16_t first = DISPLAY_ROWS, last = -1;
+
+    _overlay_plane_free();
+    _plane.rect = GRect(0, 0, 0, 0);
+    _plane.valid = true;
+    _plane.painted_over = false;
+
+    if (overlay_window_count() == 0)
+        return;
+
+    _plane.painted_over = true;
+    memset(fb, 0, DISPLAY_FRAMEBUFFER_SIZE);
+    _overlay_window_paint_all();
+
+#ifdef PBL_BW
+    /* There is no spare colour at 1 bit. Paint again over the opposite, and
+     * the bits that come out the same both times are the ones painted */
+    uint8_t *black = app_calloc(1, DISPLAY_FRAMEBUFFER_SIZE);
+    if (!black)
+        goto fail;
+
+    memcpy(black, fb, DISPLAY_FRAMEBUFFER_SIZE);
+    memset(fb, 0xFF, DISPLAY_FRAMEBUFFER_SIZE);
+    _overlay_window_paint_all();
+
+    for (uint32_t i = 0; i < DISPLAY_FRAMEBUFFER_SIZE; i++)
+        fb[i] = ~(fb[i] ^ black[i]);
+#endif
+
+    for (int16_t y = 0; y < DISPLAY_ROWS; y++)
+    {
+        uint8_t *row = fb + y * DISPLAY_ROW_BYTES;
+#ifdef PBL_BW
+        uint16_t n = OVERLAY_ROW_PIXEL_BYTES;
+#else
+        uint16_t n = DISPLAY_COLS;
+#endif
+        for (uint16_t i = 0; i < n; i++)
+        {
+            if (row[i])
+            {
+                if (first > y)
+                    first = y;
+                last = y;
+                break;
+            }
+        }
+    }
+
+    if (last < 0)
+    {
+#ifdef PBL_BW
+        app_free(black);
+#endif
+        return;
+    }
+
+    uint16_t rows = last - first + 1;
+    uint32_t size = rows * DISPLAY_ROW_BYTES;
+#ifdef PBL_BW
+    size *= 2;
+#endif
+    if (app_heap_bytes_free() < size + rows + OVERLAY_PLANE_HEAP_RESERVE)
+        goto fail;
+
+    _plane.pixels = app_calloc(1, rows * DISPLAY_ROW_BYTES);
+    _plane.row_kind = app_calloc(1, rows);
+#ifdef PBL_BW
+    _plane.mask = app_calloc(1, rows * DISPLAY_ROW_BYTES);
+    if (!_plane.mask)
+        goto fail;
+#endif
+    if (!_plane.pixels || !_plane.row_kind)
+        goto fail;
+
+    _plane.rect = GRect(0, first, DISPLAY_COLS, rows);
+
+    for (uint16_t i = 0; i < rows; i++)
+    {
+        uint8_t *row = fb + (first + i) * DISPLAY_ROW_BYTES;
+        bool all = true, any = false;
+#ifdef PBL_BW
+        memcpy(_plane.mask + i * DISPLAY_ROW_BYTES, row, DISPLAY_ROW_BYTES);
+        memcpy(_plane.pixels + i * DISPLAY_ROW_BYTES, black + (first + i) * DISPLAY_ROW_BYTES,
+               DISPLAY_ROW_BYTES);
+        for (uint16_t b = 0; b < OVERLAY_ROW_PIXEL_BYTES; b++)
+        {
+            all &= row[b] == 0xFF;
+            any |= row[b] != 0;
+        }
+#else
+        memcpy(_plane.pixels + i * DISPLAY_ROW_BYTES, row, DISPLAY_ROW_BYTES);
+        for (uint16_t x = 0; x < DISPLAY_COLS; x++)
+        {
+            all &= row[x] != 0;
+            any |= row[x] != 0;
+        }
+#endif
+        _plane.row_kind[i] = all ? OVERLAY_ROW_OPAQUE : any ? OVERLAY_ROW_MIXED : OVERLAY_ROW_CLEAR;
+    }
+
+#ifdef PBL_BW
+    app_free(black);
+#endif
+    return;
+
+fail:
+#ifdef PBL_BW
+    if (black)
+        app_free(black);
+#endif
+    _overlay_plane_free();
+    _plane.valid = false;
+    _plane_failed = true;
+    _plane.rect = GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS);
+}
+
+static void _overlay_plane_free(void)
+{
+    if (_plane.pixels)
+        app_free(_plane.pixels);
+    if (_plane.row_kind)
+        app_free(_plane.row_kind);
+#ifdef PBL_BW
+    if (_plane.mask)
+        app_free(_plane.mask);
+    _plane.mask = NULL;
+#endif
+    _plane.pixels = NULL;
+    _plane.row_kind = NULL;
+}
+
 static void _overlay_thread(void *pvParameters)
 {
     OverlayMessage data;
@@ -299,8 +613,9 @@ static void _overlay_thread(void *pvParameters)
             appmanager_timer_expired(_this_thread);
             /* When we need to update draw, we post it to the main app. This way
              * we guarantee the background is drawn first.
-             * App thread will then defer back to this thread to draw any overlays */
-            appmanager_post_draw_message(1);
+             * App thread will then defer back to this thread to draw any overlays
+             * that changed. Anything that did will have marked itself dirty */
+            appmanager_post_draw_message(0);
             next_timer = appmanager_timer_get_next_expiry(_this_thread);
         }
         if (next_timer < 0)
@@ -318,6 +633,10 @@ static void _overlay_thread(void *pvParameters)
                 case OVERLAY_DRAW:
                     _overlay_window_draw((bool)data.data);
                     break;
+                case OVERLAY_DRAW_PLANE:
+                    _overlay_plane_render();
+                    xSemaphoreGive(_ovl_done_sem);
+                    break;
                 case OVERLAY_DESTROY:
                     assert(data.data && "You MUST provide a valid overlay window");
                     OverlayWindow *ow = (OverlayWindow *)data.data;
@@ -330,6 +649,11 @@ static void _overlay_thread(void *pvParameters)
                     ButtonMessage *message = (ButtonMessage *)data.data;
                     ((ClickHandler)(message->callback))((ClickRecognizerRef)(message->clickref), message->context);
                     break;
+                case OVERLAY_CALLBACK:
+                    assert(data.data && "You MUST provide a callback");
+                    ((OverlayCallback)data.data)(data.context);
+                    appmanager_post_draw_message(1);
+                    break;
                 default:
                     assert(!"I don't know this command!");
             }
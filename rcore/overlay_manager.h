@@ -50,6 +50,13 @@ typedef struct OverlayWindow {
  */
 typedef void (*OverlayCreateCallback)(OverlayWindow *overlay, Window *window);
 
+/**
+ * @brief Prototype for a callback run on the overlay thread
+ * 
+ * @param context whatever was given to \ref overlay_window_post_callback
+ */
+typedef void (*OverlayCallback)(void *context);
+
 /* Internal initialiser */
 uint8_t overlay_window_init(void);
 
@@ -64,8 +71,9 @@ void overlay_window_post_button_message(ButtonMessage *message);
  * The \ref OverlayWindow is provided in the callback \ref OverlayCreateCallback
  * @param creation_callback Is a provided function that will be called on the
  * creation of the window.
+ * @return false if the overlay thread is too busy to take it
  */
-void overlay_window_create(OverlayCreateCallback creation_callback);
+bool overlay_window_create(OverlayCreateCallback creation_callback);
 
 /**
  * @brief Creates a new managed \ref OverlayWindow but also sets a custom context
@@ -74,8 +82,19 @@ void overlay_window_create(OverlayCreateCallback creation_callback);
  * The \ref OverlayWindow is provided in the callback \ref OverlayCreateCallback
  * @param creation_callback Is a provided function that will be called on the
  * creation of the window.
+ * @return false if the overlay thread is too busy to take it
  */
-void overlay_window_create_with_context(OverlayCreateCallback creation_callback, void *context);
+bool overlay_window_create_with_context(OverlayCreateCallback creation_callback, void *context);
+
+/**
+ * @brief Run a callback on the overlay thread, to change an \ref OverlayWindow
+ * that is already up. The overlays are redrawn after it
+ * 
+ * @param callback \ref OverlayCallback to run
+ * @param context passed to the callback
+ * @return false if the overlay thread is too busy to take it
+ */
+bool overlay_window_post_callback(OverlayCallback callback, void *context);
 
 /** 
  * @brief Directly draw an \ref OverlayWindow.
@@ -86,6 +105,13 @@ void overlay_window_create_with_context(OverlayCreateCallback creation_callback,
  */
 void overlay_window_draw(bool window_is_dirty);
 
+/* Internal. Overlays are rendered once into their own plane when they change,
+ * and composited over each app frame. Call with the display lock held */
+void overlay_window_dirty(void);
+void overlay_window_plane_update(void);
+bool overlay_window_plane_valid(void);
+void overlay_window_composite(void);
+
 /**
  * @brief Clean up an \ref OverlayWindow.
  * 
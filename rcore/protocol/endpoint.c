@@ -0,0 +1,232 @@
+/* endpoint.c
+ * Which handler gets each Pebble protocol frame, and the thread they run on
+ * RebbleOS
+ *
+ * Frames come in on the BT thread, and anything slow there holds up the
+ * radio. So each frame is copied onto its endpoint's queue and the
+ * endpoint worker runs the handler. Every endpoint has its own queue, so
+ * a flood of one kind of frame can only drop its own.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "rebbleos.h"
+#include "pebble_protocol.h"
+
+/* Configure Logging */
+#define MODULE_NAME "ENDPT"
+#define MODULE_TYPE "SYS"
+#define LOG_MODULE ENDPT
+
+#define STACK_SZ_ENDPOINT configMINIMAL_STACK_SIZE + 700
+
+typedef struct endpoint_frame {
+    TickType_t queued;
+    uint16_t len;
+    uint8_t data[];
+} endpoint_frame;
+
+typedef struct endpoint_entry {
+    EndpointHandler handler;
+    uint8_t queue_depth;
+    uint8_t head;
+    endpoint_frame *queue[ENDPOINT_QUEUE_MAX];
+    EndpointStats stats;
+} endpoint_entry;
+
+/* Only ever added to. The queues are only touched in a critical section */
+static endpoint_entry _endpoints[ENDPOINT_MAX];
+static uint8_t _endpoint_count;
+
+static TaskHandle_t _endpoint_task;
+static StackType_t _endpoint_task_stack[STACK_SZ_ENDPOINT];
+static StaticTask_t _endpoint_task_buf;
+
+/* one count for every frame waiting, on any endpoint */
+static SemaphoreHandle_t _endpoint_pending;
+static StaticSemaphore_t _endpoint_pending_buf;
+
+static void _endpoint_thread(void *pvParameters);
+
+void endpoint_init(void)
+{
+    _endpoint_pending = xSemaphoreCreateCountingStatic(ENDPOINT_MAX * ENDPOINT_QUEUE_MAX, 0, &_endpoint_pending_buf);
+    _endpoint_task = xTaskCreateStatic(_endpoint_thread,
+                                       "Endpoint", STACK_SZ_ENDPOINT, NULL,
+                                       tskIDLE_PRIORITY + 2UL,
+                                       _endpoint_task_stack, &_endpoint_task_buf);
+
+    endpoint_register(ENDPOINT_FIRMWARE_VERSION, process_version_packet, 2);
+    endpoint_register(ENDPOINT_SET_TIME, process_set_time_packet, 2);
+    endpoint_register(ENDPOINT_PHONE_MSG, process_notification_packet, 4);
+}
+
+static endpoint_entry *_endpoint_find(uint16_t endpoint)
+{
+    for (uint8_t i = 0; i < _endpoint_count; i++)
+        if (_endpoints[i].stats.endpoint == endpoint)
+            return &_endpoints[i];
+
+    return NULL;
+}
+
+bool endpoint_register(uint16_t endpoint, EndpointHandler handler, uint8_t queue_depth)
+{
+    if (_endpoint_find(endpoint) || _endpoint_count == ENDPOINT_MAX)
+    {
+        LOG_ERROR("Can't register endpoint %x", endpoint);
+        return false;
+    }
+
+    endpoint_entry *ep = &_endpoints[_endpoint_count];
+    ep->handler = handler;
+    ep->queue_depth = queue_depth > ENDPOINT_QUEUE_MAX ? ENDPOINT_QUEUE_MAX : queue_depth;
+    ep->stats.endpoint = endpoint;
+    _endpoint_count++;
+
+    return true;
+}
+
+static void _endpoint_run(endpoint_entry *ep, uint8_t *data, uint16_t len, TickType_t queued)
+{
+    TickType_t start = xTaskGetTickCount();
+    ep->handler(data, len);
+    uint32_t run_ms = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
+    uint32_t wait_ms = (start - queued) * portTICK_PERIOD_MS;
+
+    ep->stats.handled++;
+    ep->stats.run_ms_total += run_ms;
+    if (run_ms > ep->stats.run_ms_max)
+        ep->stats.run_ms_max = run_ms;
+    if (wait_ms > ep->stats.wait_ms_max)
+        ep->stats.wait_ms_max = wait_ms;
+}
+
+void endpoint_dispatch(uint16_t endpoint, uint8_t *data, uint16_t len)
+{
+    endpoint_entry *ep = _endpoint_find(endpoint);
+
+    if (!ep)
+    {
+        LOG_INFO("Unimplemented Endpoint %x", endpoint);
+        return;
+    }
+
+    if (!ep->queue_depth)
+    {
+        _endpoint_run(ep, data, len, xTaskGetTickCount());
+        return;
+    }
+
+    /* a full queue drops the frame before going to the trouble of copying it */
+    bool queued = false;
+    endpoint_frame *frame = NULL;
+    if (ep->stats.depth < ep->queue_depth)
+        frame = calloc(1, sizeof(endpoint_frame) + len);
+
+    if (frame)
+    {
+        frame->queued = xTaskGetTickCount();
+        frame->len = len;
+        memcpy(frame->data, data, len);
+
+        taskENTER_CRITICAL();
+        if (ep->stats.depth < ep->queue_depth)
+        {
+            ep->queue[(ep->head + ep->stats.depth) % ENDPOINT_QUEUE_MAX] = frame;
+            ep->stats.depth++;
+            if (ep->stats.depth > ep->stats.depth_max)
+                ep->stats.depth_max = ep->stats.depth;
+            queued = true;
+        }
+        taskEXIT_CRITICAL();
+    }
+
+    if (!queued)
+    {
+        ep->stats.dropped++;
+        LOG_WARN("Endpoint %x dropped a frame, %d waiting", endpoint, ep->stats.depth);
+        free(frame);
+        return;
+    }
+
+    xSemaphoreGive(_endpoint_pending);
+}
+
+bool endpoint_get_stats(uint16_t endpoint, EndpointStats *stats)
+{
+    endpoint_entry *ep = _endpoint_find(endpoint);
+    if (!ep)
+        return false;
+
+    taskENTER_CRITICAL();
+    *stats = ep->stats;
+    taskEXIT_CRITICAL();
+    return true;
+}
+
+void endpoint_stats_dump(void)
+{
+    for (uint8_t i = 0; i < _endpoint_count; i++)
+    {
+        EndpointStats s;
+        taskENTER_CRITICAL();
+        s = _endpoints[i].stats;
+        taskEXIT_CRITICAL();
+        LOG_INFO("%x: depth %d max %d, %d handled %d dropped, wait max %dms, run avg %dms max %dms",
+                 s.endpoint, s.depth, s.depth_max, s.handled, s.dropped, s.wait_ms_max,
+                 s.handled ? s.run_ms_total / s.handled : 0, s.run_ms_max);
+    }
+}
+
+/*
+ * Take the next frame, going round the endpoints so a busy one can't
+ * keep the rest waiting
+ */
+static endpoint_entry *_endpoint_next(endpoint_frame **frame)
+{
+    static uint8_t next;
+
+    for (uint8_t n = 0; n < _endpoint_count; n++)
+    {
+        endpoint_entry *ep = &_endpoints[(next + n) % _endpoint_count];
+        bool have = false;
+
+        taskENTER_CRITICAL();
+        if (ep->stats.depth)
+        {
+            *frame = ep->queue[ep->head];
+            ep->head = (ep->head + 1) % ENDPOINT_QUEUE_MAX;
+            ep->stats.depth--;
+            have = true;
+        }
+        taskEXIT_CRITICAL();
+
+        if (have)
+        {
+            next = (next + n + 1) % _endpoint_count;
+            return ep;
+        }
+    }
+
+    return NULL;
+}
+
+static void _endpoint_thread(void *pvParameters)
+{
+    for (;;)
+    {
+        xSemaphoreTake(_endpoint_pending, portMAX_DELAY);
+
+        endpoint_frame *frame;
+        endpoint_entry *ep = _endpoint_next(&frame);
+        if (!ep)
+            continue;
+
+        _endpoint_run(ep, frame->data, frame->len, frame->queued);
+        free(frame);
+    }
+}
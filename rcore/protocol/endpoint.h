@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
+
 // endpoint functions
 #define ENDPOINT_SET_TIME               0x0b
 #define ENDPOINT_FIRMWARE_VERSION       0x10
@@ -9,3 +12,33 @@
 
 // function parameters
 #define FIRMWARE_VERSION_GETVERSION  0
+
+
+/* How many endpoints can be registered, and the most frames any one
+ * of them can have waiting */
+#define ENDPOINT_MAX         16
+#define ENDPOINT_QUEUE_MAX   4
+
+/* data is only good until the handler returns */
+typedef void (*EndpointHandler)(uint8_t *data, uint16_t len);
+
+typedef struct EndpointStats {
+    uint16_t endpoint;
+    uint8_t depth;        // waiting now
+    uint8_t depth_max;    // most ever waiting
+    uint32_t handled;
+    uint32_t dropped;     // queue full, or no memory to copy it
+    uint32_t wait_ms_max; // queued to handler starting
+    uint32_t run_ms_total;
+    uint32_t run_ms_max;
+} EndpointStats;
+
+void endpoint_init(void);
+/* queue_depth frames wait for the endpoint worker. 0 runs the handler
+ * right there on the BT thread, only for ones that are just a few lines */
+bool endpoint_register(uint16_t endpoint, EndpointHandler handler, uint8_t queue_depth);
+/* Called with every frame from the phone. Never waits on a handler */
+void endpoint_dispatch(uint16_t endpoint, uint8_t *data, uint16_t len);
+bool endpoint_get_stats(uint16_t endpoint, EndpointStats *stats);
+/* every endpoint's stats to the log */
+void endpoint_stats_dump(void);
@@ -11,131 +11,155 @@
 #include "test.h"
 #include "protocol_notification.h"
 #include "notification_manager.h"
+#include "notification_message.h"
 
-static void _copy_and_null_term_string(uint8_t **dest, uint8_t *src, uint16_t len);
+/* Configure Logging */
+#define MODULE_NAME "PHPKT"
+#define MODULE_TYPE "SYS"
+#define LOG_MODULE PHPKT
+
+/* every descriptor starts word aligned in the block */
+#define _NOTY_ALIGN(x) (((x) + 3) & ~3)
 
 /* notification processing */
 
-void process_notification_packet(uint8_t *data)
+void process_notification_packet(uint8_t *data, uint16_t len)
 {
     full_msg_t *msg;
-    notification_packet_push(data, &msg);
+    if (!notification_packet_push(data, len, &msg))
+        return;
     notification_show_message(msg, 5000);
 }
 
-void notification_packet_push(uint8_t *data, full_msg_t **message)
+/*
+ * First pass over the attributes or actions. Checks each one fits in the
+ * packet and adds up the room its string needs, null terminated.
+ * Returns where they end, NULL if they don't fit
+ */
+static uint8_t *_notification_items_size(uint8_t *p, uint8_t *end, uint8_t count,
+                                         size_t hdr_size, size_t len_offset, uint32_t *strings)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if ((size_t)(end - p) < hdr_size)
+            return NULL;
+
+        uint16_t str_len = p[len_offset] | (p[len_offset + 1] << 8);
+        p += hdr_size;
+        if ((size_t)(end - p) < str_len)
+            return NULL;
+
+        p += str_len;
+        *strings += str_len + 1;
+    }
+
+    return p;
+}
+
+/* we have pesky pascal strings. Turn them into null term strings */
+static uint8_t *_notification_copy_string(uint8_t **str, uint8_t *src, uint16_t len)
+{
+    uint8_t *dest = *str;
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+    *str += len + 1;
+    return dest;
+}
+
+/*
+ * Parse a notification into one block on the notification heap: the
+ * message, then the attribute and action descriptors, then the header
+ * and the strings. Two passes, the first checks it all fits in len and
+ * works out the size, so there is one allocation and nothing to undo.
+ * One noty_free gets rid of the lot
+ */
+bool notification_packet_push(uint8_t *data, uint16_t len, full_msg_t **message)
 {
-    full_msg_t *new_msg = *message;
-    
-    /* create a real message as we are peeking at the buffer.
-     * lets be quick about this */
+    uint8_t *end = data + len;
+    uint32_t strings = 0;
+
+    if (len < sizeof(cmd_phone_notify_t))
+    {
+        LOG_ERROR("Notification only %d bytes", len);
+        return false;
+    }
+
     cmd_phone_notify_t *msg = (cmd_phone_notify_t *)data;
+    uint8_t *p = data + sizeof(cmd_phone_notify_t);
+    p = _notification_items_size(p, end, msg->attr_count, sizeof(cmd_phone_attribute_hdr_t),
+                                 offsetof(cmd_phone_attribute_hdr_t, str_len), &strings);
+    if (p)
+        p = _notification_items_size(p, end, msg->action_count, sizeof(cmd_phone_action_hdr_t),
+                                     offsetof(cmd_phone_action_hdr_t, str_len), &strings);
+    if (!p)
+    {
+        LOG_ERROR("Notification with %d attributes %d actions overruns its %d bytes",
+                  msg->attr_count, msg->action_count, len);
+        return false;
+    }
+
+    size_t attr_size = _NOTY_ALIGN(sizeof(cmd_phone_attribute_t));
+    size_t act_size = _NOTY_ALIGN(sizeof(cmd_phone_action_t));
+    size_t size = _NOTY_ALIGN(sizeof(full_msg_t)) + msg->attr_count * attr_size +
+                  msg->action_count * act_size + sizeof(cmd_phone_notify_t) + strings;
 
-    SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X attrc %d actc %d", msg->attr_count, msg->action_count);
-    
-    new_msg = noty_calloc(1, sizeof(full_msg_t));
-    assert(new_msg);
-    new_msg->header = noty_calloc(1, sizeof(cmd_phone_notify_t));
+    LOG_DEBUG("X attrc %d actc %d, %d bytes", msg->attr_count, msg->action_count, size);
+
+    uint8_t *block = message_alloc(size);
+    if (!block)
+    {
+        LOG_ERROR("No room for a %d byte notification", size);
+        return false;
+    }
+
+    full_msg_t *new_msg = (full_msg_t *)block;
+    new_msg->size = size;
+    uint8_t *desc = block + _NOTY_ALIGN(sizeof(full_msg_t));
+    uint8_t *str = desc + msg->attr_count * attr_size + msg->action_count * act_size;
+
+    new_msg->header = (cmd_phone_notify_t *)str;
     memcpy(new_msg->header, msg, sizeof(cmd_phone_notify_t));
+    str += sizeof(cmd_phone_notify_t);
     list_init_head(&new_msg->attributes_list_head);
     list_init_head(&new_msg->actions_list_head);
-    
+
     /* get the attributes */
-    uint8_t *p = data + sizeof(cmd_phone_notify_t);
+    p = data + sizeof(cmd_phone_notify_t);
     for (uint8_t i = 0; i < msg->attr_count; i++)
     {
-        
-        cmd_phone_attribute_hdr_t *att = (cmd_phone_attribute_hdr_t *)p;
-        uint8_t *data = p + sizeof(cmd_phone_attribute_hdr_t);
-        SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X ATTR ID:%d L:%d", att->attr_idx, att->str_len);
-        cmd_phone_attribute_t *new_attr = noty_calloc(1, sizeof(cmd_phone_attribute_t));
-        /* copy the head to the new attribute */
-        memcpy(new_attr, att, sizeof(cmd_phone_attribute_hdr_t));
-        /* copy the data in now */
-        SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X COPY");
-        /* we'll null terminate strings too as they are pascal strings and seemingly not terminated */
-        _copy_and_null_term_string(&(new_attr->data), data, att->str_len);
-       
-        SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X NODE");
+        cmd_phone_attribute_t *new_attr = (cmd_phone_attribute_t *)desc;
+        desc += attr_size;
+
+        memcpy(&new_attr->hdr, p, sizeof(cmd_phone_attribute_hdr_t));
+        p += sizeof(cmd_phone_attribute_hdr_t);
+        new_attr->data = _notification_copy_string(&str, p, new_attr->hdr.str_len);
+        p += new_attr->hdr.str_len;
+
         list_init_node(&new_attr->node);
         list_insert_tail(&new_msg->attributes_list_head, &new_attr->node);
-        p += sizeof(cmd_phone_attribute_hdr_t) + att->str_len;
     }
 
     /* get the actions */
     for (uint8_t i = 0; i < msg->action_count; i++)
     {
-        cmd_phone_action_hdr_t *act = (cmd_phone_action_hdr_t *)p;
-        uint8_t *data = p + sizeof(cmd_phone_action_hdr_t);
-        SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X ACT ID:%d L:%d AID:%d ALEN:%d", act->id, act->attr_count, act->attr_id, act->str_len);
-        cmd_phone_action_t *new_act = noty_calloc(1, sizeof(cmd_phone_action_t));
-        /* copy the head to the new action */
-        memcpy(new_act, act, sizeof(cmd_phone_action_hdr_t));
-        /* copy the data in now */
-        SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X NEW ACT ID:%d L:%d AID:%d ALEN:%d", new_act->hdr.id, new_act->hdr.attr_count, new_act->hdr.attr_id, new_act->hdr.str_len);
-
-        SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X COPY");
-        _copy_and_null_term_string(&new_act->data, data, act->str_len);
-        SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X NODE");
+        cmd_phone_action_t *new_act = (cmd_phone_action_t *)desc;
+        desc += act_size;
+
+        memcpy(&new_act->hdr, p, sizeof(cmd_phone_action_hdr_t));
+        p += sizeof(cmd_phone_action_hdr_t);
+        new_act->data = _notification_copy_string(&str, p, new_act->hdr.str_len);
+        p += new_act->hdr.str_len;
+
         list_init_node(&new_act->node);
         list_insert_tail(&new_msg->actions_list_head, &new_act->node);
-        SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X NODE ADDED");
-        p += sizeof(cmd_phone_action_hdr_t) + act->str_len;
     }
-    SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X Done");
-    *message = new_msg;
-}
 
-void _full_msg_free(full_msg_t *message)
-{  
-    cmd_phone_attribute_t *m;
-    list_node *l = list_get_head(&message->attributes_list_head);
-    while(l)
-    {
-        m = list_elem(l, cmd_phone_attribute_t, node);
-        list_remove(&message->attributes_list_head, &m->node);
-        /* free the string */
-        noty_free(m->data);
-        /* free the attribute */
-        noty_free(m);
-    }
-    
-    cmd_phone_action_t *a;
-    l = list_get_head(&message->actions_list_head);
-    while(l)
-    {
-        a = list_elem(l, cmd_phone_action_t, node);
-        list_remove(&message->actions_list_head, &a->node);
-        
-        /* free the string */
-        noty_free(a->data);
-        /* free the attribute */
-        noty_free(a);
-    }
-    
-    noty_free(message->header);
-    message->header = NULL;
-    noty_free(message);
-    message = NULL;
+    *message = new_msg;
+    return true;
 }
 
-
-/* we have pesky pascal strings. Turn them into null term strings */
-static void _copy_and_null_term_string(uint8_t **dest, uint8_t *src, uint16_t len)
+/* it's all one block */
+void notification_packet_free(full_msg_t *message)
 {
-    if (src[len - 1] != '\0')
-    {
-        *dest = noty_calloc(1, len + 1);
-        assert(*dest && "Malloc Failed!");
-
-        for(uint16_t i = 0; i < len; i++)
-            *(*dest + i) = src[i];
-
-        *(*dest + len) = '\0';
-    }
-    else
-    {
-        *dest = noty_calloc(1, len);
-        memcpy((uint8_t *)*dest, src, len);
-    }
+    noty_free(message);
 }
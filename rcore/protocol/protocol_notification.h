@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "node_list.h"
 
 
@@ -56,9 +58,14 @@ typedef struct full_msg {
     list_head attributes_list_head;
     list_head actions_list_head;
     list_node node;
+    /* bytes in the block, everything above points inside it */
+    uint16_t size;
+    /* on screen, the store can't move it or let it go until all are released */
+    uint8_t pins;
 } full_msg_t;
 
 
 full_msg_t *notification_get(void);
-void process_notification_packet(uint8_t *data);
-void notification_packet_push(uint8_t *data, full_msg_t **message);
+void process_notification_packet(uint8_t *data, uint16_t len);
+bool notification_packet_push(uint8_t *data, uint16_t len, full_msg_t **message);
+void notification_packet_free(full_msg_t *message);
@@ -4,7 +4,7 @@
 #include "endpoint.h"
 
 // firmware version processing
-void process_version_packet(uint8_t *data)
+void process_version_packet(uint8_t *data, uint16_t len)
 {
     switch(data[0])
     {
@@ -19,7 +19,7 @@ void process_version_packet(uint8_t *data)
 }
 
 
-void process_set_time_packet(uint8_t *data)
+void process_set_time_packet(uint8_t *data, uint16_t len)
 {
     cmd_set_time_t *time = (cmd_set_time_t *)data;
     SYS_LOG("FWPKT", APP_LOG_LEVEL_INFO, "XXX Time Set cmd %d, ts %d tso %d, tz %d",
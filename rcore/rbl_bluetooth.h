@@ -1,29 +1,40 @@
 #pragma once
 #include "stm32_usart.h"
 #include "stdbool.h"
+#include "bt_tx_ring.h"
+#include "bt_rx_stream.h"
 
 #define TX_BUFFER_SIZE 250
 #define TX_TIMEOUT_MS 5
 
-typedef struct pbl_transport_packet_t {
-    uint16_t length;
-    uint16_t endpoint;
+/* A reference counted packet. Fill it in, hand it to bluetooth_send_buf
+ * along with your reference, and don't touch it again. It is sent
+ * straight from here and freed when the last reference goes */
+typedef struct bt_buf {
     uint8_t *data;
-} __attribute__((__packed__)) pbl_transport_packet;
+    uint16_t len;
+    uint8_t refs;
+    uint8_t flags;
+} bt_buf;
 
+/* sent is false if it never went: no connection, queue full or timed out */
+typedef void (*tx_complete_callback)(bool sent, void *context);
 
-
-typedef void (*tx_complete_callback)();
+bt_buf *bluetooth_buf_alloc(uint16_t len);
+bt_buf *bluetooth_buf_wrap(uint8_t *data, uint16_t len);
+bt_buf *bluetooth_packet_alloc(uint16_t endpoint, uint16_t len);
+bt_buf *bluetooth_buf_ref(bt_buf *buf);
+void bluetooth_buf_unref(bt_buf *buf);
+bool bluetooth_send_buf(bt_buf *buf, BluetoothTxPriority priority, tx_complete_callback callback, void *context);
 
 uint8_t bluetooth_init(void);
 void bluetooth_init_complete(uint8_t state);
 void bluetooth_data_rx_notify(size_t len);
-uint32_t bluetooth_send_serial_raw(uint8_t *data, size_t len);
 uint8_t bluetooth_send(uint8_t *data, size_t len);
 void bluetooth_send_packet(uint16_t endpoint, uint8_t *data, uint16_t len);
 uint32_t bluetooth_tx_buf_get_bytes(uint8_t *data, size_t len);
 void bluetooth_data_rx(uint8_t *data, size_t len);
-void bluetooth_tx_complete_from_isr(void);
+void bluetooth_tx_complete(void);
 
 
 uint8_t hw_bluetooth_power_cycle(void);
@@ -31,6 +42,8 @@ void hw_bluetooth_enable_cts_irq(void);
 void hw_bluetooth_disable_cts_irq(void);
 stm32_usart_t *hw_bluetooth_get_usart(void);
 uint8_t hw_bluetooth_init(void);
+bool bt_device_request_tx(uint8_t *data, uint16_t len);
+bool bt_device_cancel_tx(void);
 
 
 void bluetooth_device_connected(void);
@@ -11,7 +11,7 @@
 /* Configure Logging */
 #define MODULE_NAME "mem"
 #define MODULE_TYPE "KERN"
-#define LOG_LEVEL RBL_LOG_LEVEL_ERROR //RBL_LOG_LEVEL_NONE
+#define LOG_MODULE MEM
 
 void rblos_memory_init(void)
 {
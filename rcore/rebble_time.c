@@ -11,7 +11,7 @@
 /* Configure Logging */
 #define MODULE_NAME "rtime"
 #define MODULE_TYPE "KERN"
-#define LOG_LEVEL RBL_LOG_LEVEL_ERROR //RBL_LOG_LEVEL_ERROR
+#define LOG_MODULE RTIME
 
 
 static TickType_t _boot_ticks;
@@ -13,7 +13,7 @@
 /* Configure Logging */
 #define MODULE_NAME "res"
 #define MODULE_TYPE "KERN"
-#define LOG_LEVEL RBL_LOG_LEVEL_DEBUG //RBL_LOG_LEVEL_ERROR
+#define LOG_MODULE RES
 
 
 
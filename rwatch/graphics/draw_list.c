@@ -0,0 +1,344 @@
+/* draw_list.c
+ * Recording graphics calls as a list of commands, to compare and replay later
+ * libRebbleOS
+ */
+
+#include "librebble.h"
+#include "draw_list.h"
+#include "utils.h"
+
+/* Lists that grow past this aren't worth keeping, the layer just draws */
+#define DRAW_LIST_MAX_BYTES 2048
+#define DRAW_LIST_MIN_BYTES 64
+/* Don't grow a list if the app heap gets this tight */
+#define DRAW_LIST_HEAP_RESERVE 4096
+#define DRAW_LIST_LOG_BYTES 32
+
+#define DRAW_LIST_ALIGN(n) (((n) + 3) & ~3)
+
+/* Drawing is serialised by the display buffer lock, so one will do */
+static DrawList *_recording;
+static n_GContext _state;
+static bool _state_valid;
+
+DrawList *draw_list_create(void)
+{
+    DrawList *list = app_calloc(1, sizeof(DrawList));
+    if (!list)
+        return NULL;
+
+    list->complete = true;
+    return list;
+}
+
+void draw_list_destroy(DrawList *list)
+{
+    if (!list)
+        return;
+
+    if (list->data)
+        app_free(list->data);
+    app_free(list);
+}
+
+/*
+ * Two lists draw the same thing, as far as we can tell
+ */
+bool draw_list_equal(const DrawList *a, const DrawList *b)
+{
+    if (!a || !b || !a->complete || !b->complete || a->external || b->external)
+        return false;
+
+    return a->len == b->len && !memcmp(a->data, b->data, a->len);
+}
+
+void draw_list_record_begin(DrawList *list)
+{
+    _recording = list;
+    _state_valid = false;
+}
+
+void draw_list_record_end(void)
+{
+    _recording = NULL;
+}
+
+DrawList *draw_list_recording(void)
+{
+    return _recording;
+}
+
+/*
+ * Room for one more command, zeroed. NULL (and the list is no good) if it won't fit
+ */
+static void *_draw_list_add(DrawList *list, uint8_t type, uint8_t color, uint32_t size)
+{
+    uint32_t need = list->len + sizeof(dl_cmd) + DRAW_LIST_ALIGN(size);
+
+    if (!list->complete)
+        return NULL;
+
+    if (need > list->size)
+    {
+        uint32_t grow = list->size ? list->size * 2 : DRAW_LIST_MIN_BYTES;
+        while (grow < need)
+            grow *= 2;
+
+        uint8_t *data = NULL;
+        if (grow <= DRAW_LIST_MAX_BYTES && app_heap_bytes_free() > grow + DRAW_LIST_HEAP_RESERVE)
+            data = app_realloc(list->data, grow);
+
+        if (!data)
+        {
+            list->complete = false;
+            return NULL;
+        }
+
+        list->data = data;
+        list->size = grow;
+    }
+
+    dl_cmd *cmd = (dl_cmd *)(list->data + list->len);
+    cmd->type = type;
+    cmd->color = color;
+    cmd->size = size;
+    memset(cmd + 1, 0, DRAW_LIST_ALIGN(size));
+    list->len = need;
+
+    return cmd + 1;
+}
+
+/*
+ * Draws pick up colours, stroke width and so on from the context.
+ * Record it whenever it is different to last time
+ */
+static void _draw_list_sync_state(DrawList *list, n_GContext *ctx)
+{
+    n_GContext state = *ctx;
+    state.offset = GRect(0, 0, 0, 0);
+
+    if (_state_valid && !memcmp(&state, &_state, sizeof(n_GContext)))
+        return;
+
+    void *payload = _draw_list_add(list, DrawListState, 0, sizeof(n_GContext));
+    if (!payload)
+        return;
+
+    memcpy(payload, &state, sizeof(n_GContext));
+    _state = state;
+    _state_valid = true;
+}
+
+void draw_list_rect(DrawList *list, n_GContext *ctx, uint8_t type, n_GRect rect, uint16_t radius, n_GCornerMask mask)
+{
+    _draw_list_sync_state(list, ctx);
+    dl_rect *r = _draw_list_add(list, type, type == DrawListFillRect ? ctx->fill_color.argb : ctx->stroke_color.argb,
+                                sizeof(dl_rect));
+    if (!r)
+        return;
+
+    *r = (dl_rect) { rect.origin.x, rect.origin.y, rect.size.w, rect.size.h, radius, mask, 0 };
+}
+
+void draw_list_line(DrawList *list, n_GContext *ctx, n_GPoint from, n_GPoint to)
+{
+    _draw_list_sync_state(list, ctx);
+    dl_line *l = _draw_list_add(list, DrawListLine, ctx->stroke_color.argb, sizeof(dl_line));
+    if (!l)
+        return;
+
+    *l = (dl_line) { from.x, from.y, to.x, to.y };
+}
+
+void draw_list_circle(DrawList *list, n_GContext *ctx, uint8_t type, n_GPoint p, uint16_t radius)
+{
+    _draw_list_sync_state(list, ctx);
+    dl_circle *c = _draw_list_add(list, type, type == DrawListFillCircle ? ctx->fill_color.argb : ctx->stroke_color.argb,
+                                  sizeof(dl_circle));
+    if (!c)
+        return;
+
+    *c = (dl_circle) { p.x, p.y, radius, 0 };
+}
+
+void draw_list_pixel(DrawList *list, n_GContext *ctx, n_GPoint p)
+{
+    _draw_list_sync_state(list, ctx);
+    dl_pixel *px = _draw_list_add(list, DrawListPixel, ctx->stroke_color.argb, sizeof(dl_pixel));
+    if (!px)
+        return;
+
+    *px = (dl_pixel) { p.x, p.y };
+}
+
+/*
+ * The text is copied in, so a changed string shows up as a changed list
+ */
+void draw_list_text(DrawList *list, n_GContext *ctx, const char *text, n_GFont const font, const n_GRect box,
+                    const n_GTextOverflowMode overflow_mode, const n_GTextAlignment alignment,
+                    n_GTextAttributes *text_attributes)
+{
+    uint16_t len = text ? strlen(text) : 0;
+
+    _draw_list_sync_state(list, ctx);
+    dl_text *t = _draw_list_add(list, DrawListText, ctx->text_color.argb, sizeof(dl_text) + len + 1);
+    if (!t)
+        return;
+
+    t->font = (uint32_t)font;
+    t->attributes = (uint32_t)text_attributes;
+    t->x = box.origin.x;
+    t->y = box.origin.y;
+    t->w = box.size.w;
+    t->h = box.size.h;
+    t->overflow = overflow_mode;
+    t->alignment = alignment;
+    t->len = len;
+    memcpy(t->text, text, len);
+}
+
+/*
+ * We only keep the pointer, and the pixels behind it can change under us
+ */
+void draw_list_bitmap(DrawList *list, n_GContext *ctx, const GBitmap *bitmap, GRect rect)
+{
+    _draw_list_sync_state(list, ctx);
+    dl_bitmap *b = _draw_list_add(list, DrawListBitmap, 0, sizeof(dl_bitmap));
+    if (!b)
+        return;
+
+    *b = (dl_bitmap) { (uint32_t)bitmap, rect.origin.x, rect.origin.y, rect.size.w, rect.size.h };
+    list->external = true;
+}
+
+void draw_list_path(DrawList *list, n_GContext *ctx, uint8_t type, const n_GPath *path)
+{
+    _draw_list_sync_state(list, ctx);
+    dl_path *p = _draw_list_add(list, type, type == DrawListFillPath ? ctx->fill_color.argb : ctx->stroke_color.argb,
+                                sizeof(dl_path) + path->num_points * sizeof(n_GPoint));
+    if (!p)
+        return;
+
+    p->rotation = path->rotation;
+    p->x = path->offset.x;
+    p->y = path->offset.y;
+    p->num_points = path->num_points;
+    memcpy(p->points, path->points, path->num_points * sizeof(n_GPoint));
+}
+
+/*
+ * Draw the list through the same graphics_* calls it was recorded from,
+ * at wherever the context is offset to now
+ */
+void draw_list_replay(const DrawList *list, n_GContext *context)
+{
+    const uint8_t *pos = list->data;
+    const uint8_t *end = list->data + list->len;
+
+    assert(!_recording && "Replaying a draw list while recording");
+
+    while (pos < end)
+    {
+        const dl_cmd *cmd = (const dl_cmd *)pos;
+        const void *payload = cmd + 1;
+        pos += sizeof(dl_cmd) + DRAW_LIST_ALIGN(cmd->size);
+
+        switch (cmd->type)
+        {
+        case DrawListState:
+        {
+            GRect offset = context->offset;
+            memcpy(context, payload, sizeof(n_GContext));
+            context->offset = offset;
+            break;
+        }
+        case DrawListFillRect:
+        case DrawListDrawRect:
+        {
+            const dl_rect *r = payload;
+            GRect rect = GRect(r->x, r->y, r->w, r->h);
+            if (cmd->type == DrawListFillRect)
+                graphics_fill_rect(context, rect, r->radius, r->corners);
+            else
+                graphics_draw_rect(context, rect, r->radius, r->corners);
+            break;
+        }
+        case DrawListLine:
+        {
+            const dl_line *l = payload;
+            graphics_draw_line(context, GPoint(l->x0, l->y0), GPoint(l->x1, l->y1));
+            break;
+        }
+        case DrawListFillCircle:
+        case DrawListDrawCircle:
+        {
+            const dl_circle *c = payload;
+            if (cmd->type == DrawListFillCircle)
+                graphics_fill_circle(context, GPoint(c->x, c->y), c->radius);
+            else
+                graphics_draw_circle(context, GPoint(c->x, c->y), c->radius);
+            break;
+        }
+        case DrawListPixel:
+        {
+            const dl_pixel *px = payload;
+            graphics_draw_pixel(context, GPoint(px->x, px->y));
+            break;
+        }
+        case DrawListText:
+        {
+            const dl_text *t = payload;
+            graphics_draw_text(context, t->text, (n_GFont)t->font, GRect(t->x, t->y, t->w, t->h),
+                               t->overflow, t->alignment, (n_GTextAttributes *)t->attributes);
+            break;
+        }
+        case DrawListBitmap:
+        {
+            const dl_bitmap *b = payload;
+            graphics_draw_bitmap_in_rect(context, (const GBitmap *)b->bitmap, GRect(b->x, b->y, b->w, b->h));
+            break;
+        }
+        case DrawListFillPath:
+        case DrawListDrawPath:
+        {
+            const dl_path *p = payload;
+            n_GPath path = {
+                .num_points = p->num_points,
+                .points = (n_GPoint *)p->points,
+                .rotation = p->rotation,
+                .offset = GPoint(p->x, p->y),
+            };
+            if (cmd->type == DrawListFillPath)
+                gpath_fill_app(context, &path);
+            else
+                gpath_draw_app(context, &path);
+            break;
+        }
+        default:
+            SYS_LOG("dlist", APP_LOG_LEVEL_ERROR, "Bad command %d at %d", cmd->type,
+                    (int)((const uint8_t *)cmd - list->data));
+            return;
+        }
+    }
+}
+
+/*
+ * Dump a list as hex, for Utilities/drawlist2png.py to draw on the host
+ */
+void draw_list_log(const DrawList *list)
+{
+    char hex[DRAW_LIST_LOG_BYTES * 2 + 1];
+
+    SYS_LOG("dlist", APP_LOG_LEVEL_INFO, "DL begin %d %d %d %d %d", list->rect.origin.x, list->rect.origin.y,
+            list->rect.size.w, list->rect.size.h, list->len);
+
+    for (uint16_t i = 0; i < list->len; i += DRAW_LIST_LOG_BYTES)
+    {
+        uint16_t n = MIN(DRAW_LIST_LOG_BYTES, list->len - i);
+        for (uint16_t j = 0; j < n; j++)
+            snprintf(hex + j * 2, 3, "%02x", list->data[i + j]);
+        SYS_LOG("dlist", APP_LOG_LEVEL_INFO, "DL %s", hex);
+    }
+
+    SYS_LOG("dlist", APP_LOG_LEVEL_INFO, "DL end");
+}
@@ -0,0 +1,105 @@
+#pragma once
+/* draw_list.h
+ * Recording graphics calls as a list of commands, to compare and replay later
+ * libRebbleOS
+ */
+
+#include "librebble.h"
+
+/* Command types. Each command is a dl_cmd header, then its payload,
+ * padded out so the next one starts 4 byte aligned.
+ * Everything is little endian; Utilities/drawlist2png.py reads the same layout */
+enum {
+    DrawListState = 0,      // raw n_GContext, offset zeroed
+    DrawListFillRect,       // dl_rect
+    DrawListDrawRect,       // dl_rect
+    DrawListLine,           // dl_line
+    DrawListFillCircle,     // dl_circle
+    DrawListDrawCircle,     // dl_circle
+    DrawListPixel,          // dl_pixel
+    DrawListText,           // dl_text, then the text and its NUL
+    DrawListBitmap,         // dl_bitmap
+    DrawListFillPath,       // dl_path, then the points
+    DrawListDrawPath,       // dl_path, then the points
+};
+
+typedef struct dl_cmd {
+    uint8_t type;
+    uint8_t color;  // argb of the colour it draws with, for the host tool
+    uint16_t size;  // payload bytes, before padding
+} dl_cmd;
+
+typedef struct dl_rect {
+    int16_t x, y, w, h;
+    uint16_t radius;
+    uint8_t corners;
+    uint8_t pad;
+} dl_rect;
+
+typedef struct dl_line {
+    int16_t x0, y0, x1, y1;
+} dl_line;
+
+typedef struct dl_circle {
+    int16_t x, y;
+    uint16_t radius;
+    uint16_t pad;
+} dl_circle;
+
+typedef struct dl_pixel {
+    int16_t x, y;
+} dl_pixel;
+
+typedef struct dl_text {
+    uint32_t font;
+    uint32_t attributes;
+    int16_t x, y, w, h;
+    uint8_t overflow;
+    uint8_t alignment;
+    uint16_t len;
+    char text[];
+} dl_text;
+
+typedef struct dl_bitmap {
+    uint32_t bitmap;
+    int16_t x, y, w, h;
+} dl_bitmap;
+
+typedef struct dl_path {
+    int32_t rotation;
+    int16_t x, y;
+    uint16_t num_points;
+    uint16_t pad;
+    n_GPoint points[];
+} dl_path;
+
+typedef struct DrawList {
+    uint8_t *data;
+    uint16_t len;
+    uint16_t size;  // allocated
+    GRect rect;     // screen frame of the layer it was recorded for
+    bool complete;  // false if it ran out of room, or something drew around it
+    bool external;  // draws things it only holds a pointer to, so can't be compared
+} DrawList;
+
+DrawList *draw_list_create(void);
+void draw_list_destroy(DrawList *list);
+bool draw_list_equal(const DrawList *a, const DrawList *b);
+void draw_list_replay(const DrawList *list, n_GContext *context);
+void draw_list_log(const DrawList *list);
+
+/* While recording, the graphics_* wrappers append to the list
+ * instead of drawing. Only one list records at a time */
+void draw_list_record_begin(DrawList *list);
+void draw_list_record_end(void);
+DrawList *draw_list_recording(void);
+
+void draw_list_rect(DrawList *list, n_GContext *ctx, uint8_t type, n_GRect rect, uint16_t radius, n_GCornerMask mask);
+void draw_list_line(DrawList *list, n_GContext *ctx, n_GPoint from, n_GPoint to);
+void draw_list_circle(DrawList *list, n_GContext *ctx, uint8_t type, n_GPoint p, uint16_t radius);
+void draw_list_pixel(DrawList *list, n_GContext *ctx, n_GPoint p);
+void draw_list_text(DrawList *list, n_GContext *ctx, const char *text, n_GFont const font, const n_GRect box,
+                    const n_GTextOverflowMode overflow_mode, const n_GTextAlignment alignment,
+                    n_GTextAttributes *text_attributes);
+void draw_list_bitmap(DrawList *list, n_GContext *ctx, const GBitmap *bitmap, GRect rect);
+void draw_list_path(DrawList *list, n_GContext *ctx, uint8_t type, const n_GPath *path);
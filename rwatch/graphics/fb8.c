@@ -0,0 +1,93 @@
+/* fb8.c
+ * Fills and copies for 8 bit (one byte per pixel) framebuffers
+ * libRebbleOS
+ */
+
+#include <string.h>
+#include "fb8.h"
+
+#define FB8_ALPHA_MASK 0xC0
+#define FB8_ALPHA_WORD 0xC0C0C0C0u
+
+/*
+ * Bytes up to a word boundary, then 16 bytes a go in word stores, then the rest
+ */
+static void _fb8_fill_run(uint8_t *dst, uint32_t n, uint8_t color)
+{
+    uint32_t word = color * 0x01010101u;
+
+    while (n && ((uintptr_t)dst & 3))
+    {
+        *dst++ = color;
+        n--;
+    }
+
+    uint32_t *d = (uint32_t *)dst;
+    for (; n >= 16; n -= 16)
+    {
+        d[0] = word;
+        d[1] = word;
+        d[2] = word;
+        d[3] = word;
+        d += 4;
+    }
+
+    for (; n >= 4; n -= 4)
+        *d++ = word;
+
+    dst = (uint8_t *)d;
+    while (n--)
+        *dst++ = color;
+}
+
+void fb8_fill(uint8_t *dst, uint16_t stride, uint16_t w, uint16_t h, uint8_t color)
+{
+    /* full width rows are one run */
+    if (w == stride)
+    {
+        _fb8_fill_run(dst, (uint32_t)w * h, color);
+        return;
+    }
+
+    for (; h; h--, dst += stride)
+        _fb8_fill_run(dst, w, color);
+}
+
+void fb8_blit(uint8_t *dst, uint16_t dst_stride, const uint8_t *src, uint16_t src_stride,
+              uint16_t w, uint16_t h)
+{
+    if (w == dst_stride && w == src_stride)
+    {
+        memcpy(dst, src, (uint32_t)w * h);
+        return;
+    }
+
+    for (; h; h--, dst += dst_stride, src += src_stride)
+        memcpy(dst, src, w);
+}
+
+bool fb8_opaque(const uint8_t *src, uint16_t stride, uint16_t w, uint16_t h)
+{
+    for (; h; h--, src += stride)
+    {
+        const uint8_t *p = src;
+        uint16_t n = w;
+
+        while (n && ((uintptr_t)p & 3))
+        {
+            if ((*p++ & FB8_ALPHA_MASK) != FB8_ALPHA_MASK)
+                return false;
+            n--;
+        }
+
+        for (; n >= 4; n -= 4, p += 4)
+            if ((*(const uint32_t *)p & FB8_ALPHA_WORD) != FB8_ALPHA_WORD)
+                return false;
+
+        while (n--)
+            if ((*p++ & FB8_ALPHA_MASK) != FB8_ALPHA_MASK)
+                return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+/* fb8.h
+ * Fills and copies for 8 bit (one byte per pixel) framebuffers
+ * libRebbleOS
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* These don't clip or blend, the caller has already worked out that
+ * every byte in the w x h area is just overwritten.
+ * stride is the bytes from one row to the next. */
+void fb8_fill(uint8_t *dst, uint16_t stride, uint16_t w, uint16_t h, uint8_t color);
+void fb8_blit(uint8_t *dst, uint16_t dst_stride, const uint8_t *src, uint16_t src_stride,
+              uint16_t w, uint16_t h);
+/* true if every pixel in the area is fully opaque GColor8 */
+bool fb8_opaque(const uint8_t *src, uint16_t stride, uint16_t w, uint16_t h);
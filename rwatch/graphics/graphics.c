@@ -9,12 +9,15 @@
 #include "upng.h"
 #include "png.h"
 #include "graphics_wrapper.h"
+#include "draw_list.h"
+#include "fb8.h"
 #include "display.h"
+#include "utils.h"
 
 /* Configure Logging */
 #define MODULE_NAME "grphcs"
 #define MODULE_TYPE "SYS"
-#define LOG_LEVEL RBL_LOG_LEVEL_INFO //RBL_LOG_LEVEL_ERROR
+#define LOG_MODULE GRAPHICS
 static GBitmap _fb_gbitmap;
 
 static GRect _jimmy_layer_offset(n_GContext *ctx, n_GRect rect)
@@ -39,25 +42,97 @@ static n_GPoint _jimmy_layer_point_offset(n_GContext *ctx, n_GPoint point)
     };
 }
 
+#ifndef PBL_BW
+/*
+ * Square, opaque fills go straight into the framebuffer a word at a time,
+ * rather than pixel by pixel through ngfx
+ */
+static bool _fast_fill_rect(n_GContext *ctx, n_GRect rect, uint16_t radius, n_GCornerMask mask)
+{
+    if ((radius && mask != GCornerNone) || (ctx->fill_color.argb & 0xC0) != 0xC0 ||
+        rect.size.w <= 0 || rect.size.h <= 0)
+        return false;
+
+    rect = grect_intersection(_jimmy_layer_offset(ctx, rect), GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    if (rect.size.w <= 0 || rect.size.h <= 0)
+        return true;
+
+    fb8_fill(display_get_buffer() + rect.origin.y * DISPLAY_ROW_BYTES + rect.origin.x, DISPLAY_ROW_BYTES,
+             rect.size.w, rect.size.h, ctx->fill_color.argb);
+    return true;
+}
+
+/*
+ * An 8 bit bitmap that fits in rect (so isn't tiled) and is opaque throughout
+ * comes out the same under any compositing mode 8 bit supports, so its rows
+ * can just be copied in
+ */
+static bool _fast_draw_bitmap(n_GContext *ctx, const GBitmap *bitmap, GRect rect)
+{
+    if (!bitmap || bitmap->format != n_GBitmapFormat8Bit || rect.size.w <= 0 || rect.size.h <= 0 ||
+        rect.size.w > bitmap->bounds.size.w || rect.size.h > bitmap->bounds.size.h)
+        return false;
+
+    GRect screen = _jimmy_layer_offset(ctx, rect);
+    GRect clip = grect_intersection(screen, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    if (clip.size.w <= 0 || clip.size.h <= 0)
+        return true;
+
+    const uint8_t *src = (const uint8_t *)bitmap->addr +
+                         (bitmap->bounds.origin.y + clip.origin.y - screen.origin.y) * bitmap->row_size_bytes +
+                         bitmap->bounds.origin.x + clip.origin.x - screen.origin.x;
+    if (!fb8_opaque(src, bitmap->row_size_bytes, clip.size.w, clip.size.h))
+        return false;
+
+    fb8_blit(display_get_buffer() + clip.origin.y * DISPLAY_ROW_BYTES + clip.origin.x, DISPLAY_ROW_BYTES,
+             src, bitmap->row_size_bytes, clip.size.w, clip.size.h);
+    return true;
+}
+#else
+#  define _fast_fill_rect(ctx, rect, radius, mask) false
+#  define _fast_draw_bitmap(ctx, bitmap, rect) false
+#endif
 
 // void n_graphics_fill_rect_app(n_GContext * ctx, n_GRect rect, uint16_t radius, n_GCornerMask mask);
 void graphics_fill_rect(n_GContext * ctx, n_GRect rect, uint16_t radius, n_GCornerMask mask)
 {
+    if (draw_list_recording())
+    {
+        draw_list_rect(draw_list_recording(), ctx, DrawListFillRect, rect, radius, mask);
+        return;
+    }
+    if (_fast_fill_rect(ctx, rect, radius, mask))
+        return;
     n_graphics_fill_rect(ctx, _jimmy_layer_offset(ctx, rect), radius, mask);
 }
 
 void graphics_fill_circle(n_GContext * ctx, n_GPoint p, uint16_t radius)
 {
+    if (draw_list_recording())
+    {
+        draw_list_circle(draw_list_recording(), ctx, DrawListFillCircle, p, radius);
+        return;
+    }
     n_graphics_fill_circle(ctx, _jimmy_layer_point_offset(ctx, p), radius);
 }
 
 void graphics_draw_circle(n_GContext * ctx, n_GPoint p, uint16_t radius)
 {
+    if (draw_list_recording())
+    {
+        draw_list_circle(draw_list_recording(), ctx, DrawListDrawCircle, p, radius);
+        return;
+    }
     n_graphics_draw_circle(ctx, _jimmy_layer_point_offset(ctx, p), radius);
 }
 
 void graphics_draw_line(n_GContext * ctx, n_GPoint from, n_GPoint to)
 {
+    if (draw_list_recording())
+    {
+        draw_list_line(draw_list_recording(), ctx, from, to);
+        return;
+    }
     n_graphics_draw_line(ctx, 
                          _jimmy_layer_point_offset(ctx, from), 
                          _jimmy_layer_point_offset(ctx, to));
@@ -69,14 +144,36 @@ void graphics_draw_text(
     n_GTextAttributes * text_attributes)
 {
     LOG_DEBUG("text");
+    if (draw_list_recording())
+    {
+        draw_list_text(draw_list_recording(), ctx, text, font, box, overflow_mode, alignment, text_attributes);
+        return;
+    }
     n_graphics_draw_text(ctx, text, font, _jimmy_layer_offset(ctx, box),
                             overflow_mode, alignment,
                             text_attributes);
 }
 
+/*
+ * Lay the text out without drawing it, and return the size it fills
+ */
+GSize graphics_text_layout_get_content_size(
+    const char * text, n_GFont const font, const n_GRect box,
+    const n_GTextOverflowMode overflow_mode, const n_GTextAlignment alignment)
+{
+    return n_graphics_text_layout_get_content_size(text, font, box, overflow_mode, alignment);
+}
+
 void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect)
 {
     LOG_DEBUG("gbir");
+    if (draw_list_recording())
+    {
+        draw_list_bitmap(draw_list_recording(), ctx, bitmap, rect);
+        return;
+    }
+    if (_fast_draw_bitmap(ctx, bitmap, rect))
+        return;
     GRect offsetted = _jimmy_layer_offset(ctx, rect);
     n_graphics_draw_bitmap_in_rect(ctx, bitmap, offsetted);
 }
@@ -85,6 +182,11 @@ void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect re
 void graphics_draw_pixel(n_GContext * ctx, n_GPoint p)
 {
     LOG_DEBUG("dip");
+    if (draw_list_recording())
+    {
+        draw_list_pixel(draw_list_recording(), ctx, p);
+        return;
+    }
     n_graphics_draw_pixel(ctx, _jimmy_layer_point_offset(ctx, p));
 
 }
@@ -92,12 +194,20 @@ void graphics_draw_pixel(n_GContext * ctx, n_GPoint p)
 void graphics_draw_rect(n_GContext * ctx, n_GRect rect, uint16_t radius, n_GCornerMask mask)
 {
     LOG_DEBUG("rect");
+    if (draw_list_recording())
+    {
+        draw_list_rect(draw_list_recording(), ctx, DrawListDrawRect, rect, radius, mask);
+        return;
+    }
     n_graphics_draw_rect(ctx, _jimmy_layer_offset(ctx, rect), radius, mask);
 }
 
 
 GBitmap *graphics_capture_frame_buffer(n_GContext *context)
 {
+    /* whatever gets drawn straight into the framebuffer, a list can't replay */
+    if (draw_list_recording())
+        draw_list_recording()->complete = false;
     // rbl_lock_frame_buffer
     if (!_fb_gbitmap.addr)
     {
@@ -115,6 +225,8 @@ GBitmap *graphics_capture_frame_buffer_format(n_GContext *context, GBitmap forma
 {
     // rbl_lock_frame_buffer
     LOG_DEBUG("fb lock");
+    if (draw_list_recording())
+        draw_list_recording()->complete = false;
     return (GBitmap *)display_get_buffer();
 }
 
@@ -127,6 +239,11 @@ void graphics_release_frame_buffer(n_GContext *context, GBitmap *bitmap)
 
 void gpath_fill_app(n_GContext * ctx, n_GPath * path)
 {
+    if (draw_list_recording())
+    {
+        draw_list_path(draw_list_recording(), ctx, DrawListFillPath, path);
+        return;
+    }
     GPoint off = path->offset;
     GPoint r = _jimmy_layer_point_offset(ctx, path->offset);
     path->offset.x = r.x;
@@ -138,6 +255,11 @@ void gpath_fill_app(n_GContext * ctx, n_GPath * path)
 
 void gpath_draw_app(n_GContext * ctx, n_GPath * path)
 {
+    if (draw_list_recording())
+    {
+        draw_list_path(draw_list_recording(), ctx, DrawListDrawPath, path);
+        return;
+    }
     GPoint off = path->offset;
     GPoint r = _jimmy_layer_point_offset(ctx, path->offset);
     path->offset.x = r.x;
@@ -250,6 +372,40 @@ void grect_standardize(GRect *rect)
     }
 }
 
+/*
+ * Smallest rect holding both rects. Empty rects are ignored
+ */
+GRect grect_union(GRect a, GRect b)
+{
+    if (a.size.w <= 0 || a.size.h <= 0)
+        return b;
+    if (b.size.w <= 0 || b.size.h <= 0)
+        return a;
+
+    int16_t x0 = MIN(a.origin.x, b.origin.x);
+    int16_t y0 = MIN(a.origin.y, b.origin.y);
+    int16_t x1 = MAX(a.origin.x + a.size.w, b.origin.x + b.size.w);
+    int16_t y1 = MAX(a.origin.y + a.size.h, b.origin.y + b.size.h);
+
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+/*
+ * The overlap of two rects. Zero size if they don't touch
+ */
+GRect grect_intersection(GRect a, GRect b)
+{
+    int16_t x0 = MAX(a.origin.x, b.origin.x);
+    int16_t y0 = MAX(a.origin.y, b.origin.y);
+    int16_t x1 = MIN(a.origin.x + a.size.w, b.origin.x + b.size.w);
+    int16_t y1 = MIN(a.origin.y + a.size.h, b.origin.y + b.size.h);
+
+    if (x1 <= x0 || y1 <= y0)
+        return GRect(x0, y0, 0, 0);
+
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
 //! Returns a rectangle that is shrinked or expanded by the given edge insets.
 //! @note The rectangle is standardized and then the inset parameters are applied.
 //! If the resulting rectangle would have a negative height or width, a GRectZero is returned.
@@ -11,6 +11,9 @@ void graphics_draw_text(
     n_GContext * ctx, const char * text, n_GFont const font, const n_GRect box,
     const n_GTextOverflowMode overflow_mode, const n_GTextAlignment alignment,
     n_GTextAttributes * text_attributes);
+GSize graphics_text_layout_get_content_size(
+    const char * text, n_GFont const font, const n_GRect box,
+    const n_GTextOverflowMode overflow_mode, const n_GTextAlignment alignment);
 void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
 void graphics_draw_pixel(n_GContext * ctx, n_GPoint p);
 void graphics_draw_rect(n_GContext * ctx, n_GRect rect, uint16_t radius, n_GCornerMask mask);
@@ -33,3 +33,5 @@ bool graphics_frame_buffer_is_captured(GContext * ctx);
 
 void grect_align(GRect *rect, const GRect *inside_rect, const GAlign alignment, const bool clip);
 void grect_standardize(GRect *rect);
+GRect grect_union(GRect a, GRect b);
+GRect grect_intersection(GRect a, GRect b);
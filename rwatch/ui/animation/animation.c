@@ -43,7 +43,7 @@
 /* Configure Logging */
 #define MODULE_NAME "anim"
 #define MODULE_TYPE "SYS"
-#define LOG_LEVEL RBL_LOG_LEVEL_INFO //RBL_LOG_LEVEL_ERROR
+#define LOG_MODULE ANIM
 
 
 #define ANIMATION_FPS 60
@@ -7,12 +7,59 @@
 
 #include "librebble.h"
 #include "utils.h"
+#include "task.h"
+#include "draw_list.h"
+
+/* Configure Logging */
+#define MODULE_NAME "layer"
+#define MODULE_TYPE "SYS"
+#define LOG_MODULE LAYER
 
 static void _layer_remove_node(Layer *to_be_removed);
 static void _layer_insert_node(Layer *layer_to_insert, Layer *sibling_layer, bool below);
-static void _layer_delete_tree(Layer *layer);
-static Layer *_layer_find_parent(Layer *orig_layer, Layer *layer);
-static void _layer_walk(const Layer *layer, GContext *context);
+static void _layer_delete_tree(Layer *parent);
+static void _layer_release(Layer *layer);
+static void _layer_link(Layer *layer, Layer *parent, Layer *prev);
+static void _layer_walk(const Layer *layer, GContext *context, GRect damage);
+static GRect _layer_walk_clip(const Layer *layer, GPoint origin, const Layer *top, GRect damage);
+static void _layer_grow_damage(const Layer *layer, GPoint origin, GRect *damage, bool *grown);
+static GRect _layer_get_screen_frame(const Layer *layer, struct Window **window);
+static GRect _layer_get_painted(const Layer *layer, GRect rect, GRect damage);
+static bool _layer_cache_restore(Layer *layer, GRect rect, GRect hit);
+static void _layer_cache_capture(Layer *layer, GRect rect, GRect hit, TickType_t start);
+static void _layer_cache_free(Layer *layer);
+static void _layer_damage(Layer *layer);
+static void _layer_record(Layer *layer, GContext *context, GRect rect);
+static bool _layer_replay(Layer *layer, GContext *context, GRect rect);
+
+/* Build with LAYER_DEBUG to check the tree after every change */
+#define LAYER_CHECK_MAX_LAYERS 1024
+#ifdef LAYER_DEBUG
+#  define LAYER_CHECK_TREE(layer) assert(layer_tree_check(layer) && "Layer tree is broken")
+#else
+#  define LAYER_CHECK_TREE(layer)
+#endif
+
+/* Drop layer caches rather than let the app heap get this tight */
+#define LAYER_CACHE_HEAP_RESERVE 4096
+
+#ifdef PBL_BW
+#  define LAYER_CACHE_BYTE(x) ((x) >> 3)
+#else
+#  define LAYER_CACHE_BYTE(x) (x)
+#endif
+
+/* The layer being painted, and its damage in its own coordinates */
+static const Layer *_damage_layer;
+static GRect _damage_local;
+
+typedef struct LayerCache {
+    GRect rect; // screen area held
+    uint16_t row_bytes;
+    bool valid;
+    TickType_t draw_ticks; // how long update_proc took to paint it
+    uint8_t data[];
+} LayerCache;
 
 // Layer Functions
 Layer *layer_create(GRect frame)
@@ -20,7 +67,7 @@ Layer *layer_create(GRect frame)
     Layer* layer = app_calloc(1, sizeof(Layer));
     if (layer == NULL)
     {
-        SYS_LOG("layer", APP_LOG_LEVEL_ERROR, "NO MEMORY FOR LAYER!");
+        LOG_ERROR("NO MEMORY FOR LAYER!");
         return NULL;
     }
     layer_ctor(layer, frame);
@@ -42,8 +89,16 @@ void layer_ctor(Layer* layer, GRect frame)
     layer->clip = false;
     layer->frame = frame;
     layer->child = NULL;
+    layer->last_child = NULL;
     layer->sibling = NULL;
+    layer->prev_sibling = NULL;
     layer->parent = NULL;
+    layer->cached = false;
+    layer->cache = NULL;
+    layer->damage_proc = NULL;
+    layer->recorded = false;
+    layer->record_pending = false;
+    layer->draw_list = NULL;
 }
 
 void layer_destroy(Layer* layer)
@@ -51,11 +106,19 @@ void layer_destroy(Layer* layer)
     layer_dtor(layer);
 }
 
+/* what a layer holds on to besides itself */
+static void _layer_release(Layer *layer)
+{
+    _layer_cache_free(layer);
+    draw_list_destroy(layer->draw_list);
+    layer->draw_list = NULL;
+}
+
 void layer_dtor(Layer *layer)
 {
     // remove our node
-    SYS_LOG("layer", APP_LOG_LEVEL_ERROR, "Layer DTOR");
     _layer_remove_node(layer);
+    _layer_release(layer);
     // free the children too...
     /* @ginge Actually, Pebble doesn't do this so we dont either */
     /*_layer_delete_tree(layer);
@@ -70,6 +133,9 @@ GRect layer_get_unobstructed_bounds(Layer *layer)
 void layer_set_update_proc(Layer *layer, void *proc)
 {
     layer->update_proc = proc;
+    layer->record_pending = true;
+    if (layer->cache)
+        layer->cache->valid = false;
 }
 
 void layer_add_child(Layer *parent_layer, Layer *child_layer)
@@ -77,46 +143,68 @@ void layer_add_child(Layer *parent_layer, Layer *child_layer)
     if (parent_layer == NULL || child_layer == NULL)
         return;
 
-    if(parent_layer->child == child_layer)
+    if (child_layer->parent == parent_layer)
     {
-        SYS_LOG("layer", APP_LOG_LEVEL_ERROR, "LAYER IS ALREADY CHILD");
+        LOG_ERROR("LAYER IS ALREADY CHILD");
         return;
     }
     
-    // if parent isn't already with child, it will become it
-    // this will set the root node for all other elements in this parent
-    if (parent_layer->child == NULL)
-    {
-        parent_layer->child = child_layer;
-        child_layer->parent = parent_layer;
-        child_layer->window = parent_layer->window;
-        return;
-    }
+    /* a layer only has the one parent */
+    _layer_remove_node(child_layer);
     
-    Layer *child = parent_layer->child;
-    
-    // now find the parents childs siblings
-    while(child->sibling)
+    // goes on the end, so it is drawn on top of its siblings
+    _layer_link(child_layer, parent_layer, parent_layer->last_child);
+    _layer_damage(child_layer);
+}
+
+/*
+ * The layer's content changed.
+ * A recorded layer is recorded again before the next draw, and only damages
+ * the screen if it came out different. Anything else damages where it is now.
+ */
+void layer_mark_dirty(Layer *layer)
+{
+    struct Window *window = NULL;
+
+    if (layer && layer->recorded && layer->draw_list)
     {
-        if (child == child_layer)
+        _layer_get_screen_frame(layer, &window);
+        if (window && !window->is_overlay)
         {
-            SYS_LOG("layer", APP_LOG_LEVEL_ERROR, "LAYER IS ALREADY CHILD\n");
+            layer->record_pending = true;
+            window->is_record_pending = true;
+            window->is_render_scheduled = true;
             return;
         }
-        child = child->sibling;
     }
-    
-    child->sibling = child_layer;
-    child_layer->parent = parent_layer;
-    child_layer->window = parent_layer->window;
 
-    layer_mark_dirty(parent_layer);
+    _layer_damage(layer);
 }
 
-void layer_mark_dirty(Layer *layer)
+/*
+ * Damage the part of the screen this layer covers.
+ * If we can't tell where that is, or it's an overlay, repaint the lot
+ */
+static void _layer_damage(Layer *layer)
 {
-    //layer->window
-    window_dirty(true);
+    struct Window *window = NULL;
+    GRect rect;
+
+    if (layer)
+    {
+        rect = _layer_get_screen_frame(layer, &window);
+        layer->record_pending = true;
+        if (layer->cache)
+            layer->cache->valid = false;
+    }
+
+    if (!window || window->is_overlay)
+    {
+        window_dirty(true);
+        return;
+    }
+
+    window_dirty_rect(window, rect);
 }
 
 void layer_set_bounds(Layer *layer, GRect bounds)
@@ -159,8 +247,10 @@ void layer_set_bounds_origin(Layer* layer, GPoint origin) {
 void layer_set_frame(Layer *layer, GRect frame)
 {
     if (!RECT_EQ(layer->frame, frame)) {
+        /* damage where we were, and where we are going */
+        _layer_damage(layer);
         layer->frame = frame;
-        layer_mark_dirty(layer);
+        _layer_damage(layer);
     }
 }
 
@@ -181,7 +271,10 @@ void layer_remove_from_parent(Layer *child)
 
 void layer_remove_child_layers(Layer *parent)
 {
-    _layer_delete_tree(parent->child);
+    /* the children's area needs a repaint */
+    _layer_damage(parent);
+    _layer_delete_tree(parent);
+    LAYER_CHECK_TREE(parent);
 }
 
 void layer_insert_below_sibling(Layer *layer_to_insert, Layer *below_sibling_layer)
@@ -196,7 +289,11 @@ void layer_insert_above_sibling(Layer *layer_to_insert, Layer *above_sibling_lay
 
 void layer_set_hidden(Layer *layer, bool hidden)
 {
+    if (layer->hidden == hidden)
+        return;
+
     layer->hidden = hidden;
+    _layer_damage(layer);
 }
 
 bool layer_get_hidden(const Layer *layer)
@@ -206,7 +303,35 @@ bool layer_get_hidden(const Layer *layer)
 
 void layer_draw(const Layer *layer, GContext *context)
 {
-    _layer_walk(layer, context);
+    _layer_walk(layer, context, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+}
+
+/*
+ * Draw the tree, only calling update procs of layers that
+ * touch the damaged (screen) rect
+ */
+void layer_draw_damage(const Layer *layer, GContext *context, GRect damage)
+{
+    _layer_walk(layer, context, damage);
+}
+
+/*
+ * Update procs paint their whole layer, and would paint over any
+ * neighbour that isn't being redrawn. So every layer touching the damage
+ * grows it to cover that layer, until it stops growing.
+ * origin is the screen position the tree is drawn at.
+ */
+GRect layer_grow_damage(const Layer *layer, GPoint origin, GRect damage)
+{
+    bool grown;
+
+    do
+    {
+        grown = false;
+        _layer_grow_damage(layer, origin, &damage, &grown);
+    } while (grown);
+
+    return damage;
 }
 
 void layer_apply_frame_offset(const Layer *layer, GContext *context)
@@ -225,6 +350,158 @@ void layer_set_clips(Layer *layer, bool clips)
     layer->clip = clips;
 }
 
+void layer_set_damage_proc(Layer *layer, LayerDamageProc damage_proc)
+{
+    layer->damage_proc = damage_proc;
+}
+
+/*
+ * The part of the layer being repainted, in its own coordinates.
+ * Outside of its update_proc, that is all of it.
+ */
+GRect layer_get_damage(const Layer *layer)
+{
+    if (layer == _damage_layer)
+        return _damage_local;
+
+    return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+/*
+ * Move a layer up or down inside its parent, as a scroll does.
+ * Rather than repaint the lot, the window shifts what is already on screen
+ * in the parent's area and only the uncovered strip gets drawn.
+ * Anything other than a vertical move is a plain layer_set_frame.
+ */
+void layer_scroll_frame(Layer *layer, GRect frame)
+{
+    struct Window *window = NULL;
+    int16_t dy = frame.origin.y - layer->frame.origin.y;
+    
+    if (!layer->parent || dy == 0 || frame.origin.x != layer->frame.origin.x ||
+        !SIZE_EQ(frame.size, layer->frame.size))
+    {
+        layer_set_frame(layer, frame);
+        return;
+    }
+    
+    GRect view = _layer_get_screen_frame(layer->parent, &window);
+    if (!window || window->is_overlay)
+    {
+        layer_set_frame(layer, frame);
+        return;
+    }
+    
+    layer->frame = frame;
+    window_scroll_rect(window, layer->parent, view, dy);
+}
+
+/*
+ * True if nothing outside owner's subtree paints in rect,
+ * so that what is on screen there belongs to owner alone
+ */
+bool layer_subtree_owns_rect(const Layer *layer, GPoint origin, const Layer *owner, GRect rect)
+{
+    for (; layer; layer = layer->sibling)
+    {
+        if (layer->hidden || layer == owner)
+            continue;
+
+        GPoint layer_origin = GPoint(origin.x + layer->frame.origin.x,
+                                     origin.y + layer->frame.origin.y);
+        GRect hit = grect_intersection(GRect(layer_origin.x, layer_origin.y,
+                                             layer->frame.size.w, layer->frame.size.h), rect);
+
+        if (layer->update_proc && hit.size.w > 0 && hit.size.h > 0)
+            return false;
+
+        if (!layer_subtree_owns_rect(layer->child, layer_origin, owner, rect))
+            return false;
+    }
+
+    return true;
+}
+
+void layer_set_cached(Layer *layer, bool cached)
+{
+    layer->cached = cached;
+    if (!cached)
+        _layer_cache_free(layer);
+}
+
+bool layer_get_cached(const Layer *layer)
+{
+    return layer->cached;
+}
+
+void layer_set_recorded(Layer *layer, bool recorded)
+{
+    layer->recorded = recorded;
+    layer->record_pending = true;
+    if (!recorded)
+    {
+        draw_list_destroy(layer->draw_list);
+        layer->draw_list = NULL;
+    }
+}
+
+bool layer_get_recorded(const Layer *layer)
+{
+    return layer->recorded;
+}
+
+/*
+ * Record every visible layer under root that was marked dirty since it was
+ * last recorded. Those that draw something different damage where they
+ * were and where they are now; the rest are left alone.
+ */
+void layer_record_pending(const Layer *root, GContext *context)
+{
+    const Layer *l = root;
+    GRect initial_offset = context->offset;
+
+    while (l)
+    {
+        if (!l->hidden)
+        {
+            if (l->recorded && l->record_pending && l->update_proc)
+            {
+                struct Window *window = NULL;
+                Layer *layer = (Layer *)l;
+                GRect rect = _layer_get_screen_frame(layer, &window);
+                DrawList *old = layer->draw_list;
+
+                layer->draw_list = NULL;
+                _layer_record(layer, context, rect);
+
+                if (!draw_list_equal(old, layer->draw_list) || !RECT_EQ(old->rect, rect))
+                {
+                    if (old)
+                        window_dirty_rect(window, old->rect);
+                    window_dirty_rect(window, rect);
+                    if (layer->cache)
+                        layer->cache->valid = false;
+                }
+                draw_list_destroy(old);
+            }
+
+            if (l->child)
+            {
+                l = l->child;
+                continue;
+            }
+        }
+
+        /* next in pre-order, without recursion */
+        while (l != root && !l->sibling)
+            l = l->parent;
+
+        l = l == root ? NULL : l->sibling;
+    }
+
+    context->offset = initial_offset;
+}
+
 bool layer_get_clips(const Layer *layer)
 {
     if (!layer)
@@ -235,130 +512,517 @@ bool layer_get_clips(const Layer *layer)
 
 /* Private functions */
 
+/*
+ * Below a sibling means before it in the list (drawn first),
+ * above means after it
+ */
 static void _layer_insert_node(Layer *layer_to_insert, Layer *sibling_layer, bool below)
 {
-    if (below)
+    if (!sibling_layer->parent || layer_to_insert == sibling_layer)
     {
-        // first find the sibling that points to parent
-        Layer *parent = _layer_find_parent(sibling_layer, sibling_layer);
-        layer_to_insert->parent = parent->parent;
-        layer_to_insert->sibling = parent->sibling;
-        parent->sibling = layer_to_insert;
+        LOG_ERROR("Can't insert next to %x", sibling_layer);
+        return;
     }
+    
+    _layer_remove_node(layer_to_insert);
+    _layer_link(layer_to_insert, sibling_layer->parent,
+                below ? sibling_layer->prev_sibling : sibling_layer);
+    _layer_damage(layer_to_insert);
+}
+
+/*
+ * Slot a detached layer into parent's children, after prev.
+ * NULL prev makes it the first child
+ */
+static void _layer_link(Layer *layer, Layer *parent, Layer *prev)
+{
+    Layer *next = prev ? prev->sibling : parent->child;
+
+    layer->parent = parent;
+    layer->prev_sibling = prev;
+    layer->sibling = next;
+    layer->window = parent->window;
+
+    if (prev)
+        prev->sibling = layer;
     else
-    {
-        // slot the node in after
-        layer_to_insert->parent = sibling_layer->parent;
-        layer_to_insert->sibling = sibling_layer->sibling;
-        sibling_layer->sibling = layer_to_insert;
-    }
-    layer_to_insert->window = sibling_layer->window;
+        parent->child = layer;
+
+    if (next)
+        next->prev_sibling = layer;
+    else
+        parent->last_child = layer;
+    
+    LAYER_CHECK_TREE(parent);
 }
 
 static void _layer_remove_node(Layer *to_be_removed)
 {
-    if (to_be_removed->parent == NULL)
-        return;
+    Layer *parent = to_be_removed->parent;
     
-    Layer *parent = _layer_find_parent(to_be_removed, to_be_removed->parent);
-    // remove our node by pointing next to parents next, jumping over us
     if (parent == NULL)
-    {
-        SYS_LOG("window", APP_LOG_LEVEL_INFO, "ROOT layers rem %d %d %d %d", to_be_removed, parent, parent->sibling, parent->child);
-        
-        /* we are the root node */
         return;
-    }
     
-    if (parent->sibling == to_be_removed)
-    {
-        parent->sibling = to_be_removed->sibling;
-    }
-    else if (parent->child == to_be_removed)
+    /* the area we leave behind needs a repaint */
+    _layer_damage(to_be_removed);
+
+    // remove our node by pointing our neighbours at each other, jumping over us
+    if (to_be_removed->prev_sibling)
+        to_be_removed->prev_sibling->sibling = to_be_removed->sibling;
+    else
+        parent->child = to_be_removed->sibling;
+    
+    if (to_be_removed->sibling)
+        to_be_removed->sibling->prev_sibling = to_be_removed->prev_sibling;
+    else
+        parent->last_child = to_be_removed->prev_sibling;
+
+    to_be_removed->parent = NULL;
+    to_be_removed->sibling = NULL;
+    to_be_removed->prev_sibling = NULL;
+    
+    LAYER_CHECK_TREE(parent);
+}
+
+/*
+ * Check every link in the tree under root agrees with its neighbours.
+ * Logs and returns false at the first broken one
+ */
+bool layer_tree_check(const Layer *root)
+{
+    const Layer *l = root->child;
+    uint16_t count = 0;
+
+    while (l && l != root)
     {
-        parent->child = NULL;
+        const Layer *parent = l->parent;
+        
+        if (++count > LAYER_CHECK_MAX_LAYERS)
+        {
+            LOG_ERROR("tree: loop under %x", root);
+            return false;
+        }
+        
+        if (!parent ||
+            (l->prev_sibling ? l->prev_sibling->sibling != l : parent->child != l) ||
+            (l->sibling ? l->sibling->prev_sibling != l : parent->last_child != l) ||
+            (l->sibling && l->sibling->parent != parent))
+        {
+            LOG_ERROR("tree: bad links at %x", l);
+            return false;
+        }
+
+        /* next in pre-order, without recursion */
+        if (l->child)
+        {
+            l = l->child;
+            continue;
+        }
+        
+        while (l != root && !l->sibling)
+            l = l->parent;
+        
+        if (l != root)
+            l = l->sibling;
     }
-    to_be_removed->parent = NULL;   
+
+    return true;
 }
 
 /*
- * Recurse through the btree.
+ * Walk the btree, painting as we go.
  * As we are storing layers as a btree where each sibling
  * is the next layer of the same child as layer->parent
  * layer->child is the head of a new list of siblings where layer->child == new parent
- * This will recurse the children, the siblings of children in a layer
- * When exhaused it will walk the siblings of the parent, etc etc until
- * either 1) no more ram 2) completion
+ *
+ * This doesn't recurse or keep a stack: it goes down through child, along
+ * through sibling, and back up through parent, taking the frame offset off
+ * again on the way up. So any depth and any number of siblings is drawn in
+ * the same stack.
+ * Update procs are only called when the layer touches the clip rect (the
+ * damage, to start with). A layer with clips set narrows the clip for its
+ * children, and if none of it is in the clip, its children are skipped
  */
-static void _layer_walk(const Layer *layer, GContext *context)
+static void _layer_walk(const Layer *layer, GContext *context, GRect damage)
 {
-    if (layer)
+    GRect initial_offset = context->offset;
+    const Layer *top = layer ? layer->parent : NULL;
+    const Layer *l = layer;
+    GRect clip = damage;
+    /* the parent's context offset. The size isn't clamped at 0 as
+     * layer_apply_frame_offset does, so the way back up is a subtraction */
+    int32_t x = initial_offset.origin.x, y = initial_offset.origin.y;
+    int32_t w = initial_offset.size.w, h = initial_offset.size.h;
+
+    while (l)
     {
-        if (layer->hidden == false) // we don't draw hidden layers or their children
+        if (!l->hidden) // we don't draw hidden layers or their children
         {
-            GRect previous_offset = context->offset;
-            layer_apply_frame_offset(layer, context);
+            GRect rect = GRect(x + l->frame.origin.x, y + l->frame.origin.y,
+                               l->frame.size.w, l->frame.size.h);
+            GRect hit = grect_intersection(_layer_get_painted(l, rect, clip), clip);
 
-            if (layer->update_proc)
-                layer->update_proc((Layer *)layer, context);
+            context->offset = GRect(rect.origin.x, rect.origin.y,
+                                    MAX(0, w - l->frame.origin.x), MAX(0, h - l->frame.origin.y));
 
-            // walk this elements sub elements recursively before moving on to the next element
-            _layer_walk(layer->child, context);
+            if (l->update_proc && hit.size.w > 0 && hit.size.h > 0 && !_layer_cache_restore((Layer *)l, rect, hit))
+            {
+                TickType_t start = xTaskGetTickCount();
+                _damage_layer = l;
+                _damage_local = GRect(hit.origin.x - rect.origin.x, hit.origin.y - rect.origin.y,
+                                      hit.size.w, hit.size.h);
+                if (!_layer_replay((Layer *)l, context, rect))
+                    l->update_proc((Layer *)l, context);
+                _damage_layer = NULL;
+                _layer_cache_capture((Layer *)l, rect, hit, start);
+            }
 
-            context->offset = previous_offset; // restore offset
+            /* Children can live outside of our frame unless we clip them */
+            GRect frame_hit = grect_intersection(rect, clip);
+            bool visible = frame_hit.size.w > 0 && frame_hit.size.h > 0;
+            if (l->child && (!l->clip || visible))
+            {
+                x += l->frame.origin.x;
+                y += l->frame.origin.y;
+                w -= l->frame.origin.x;
+                h -= l->frame.origin.y;
+                if (l->clip)
+                    clip = frame_hit;
+                l = l->child;
+                continue;
+            }
         }
-        _layer_walk(layer->sibling, context);
+
+        /* on to our sibling, or the first parent that has one */
+        while (!l->sibling && l->parent != top)
+        {
+            l = l->parent;
+            x -= l->frame.origin.x;
+            y -= l->frame.origin.y;
+            w += l->frame.origin.x;
+            h += l->frame.origin.y;
+            if (l->clip)
+                clip = _layer_walk_clip(l, GPoint(x, y), top, damage);
+        }
+        l = l->sibling;
     }
+    
+    context->offset = initial_offset; // restore offset
 }
 
-static Layer *_layer_find_parent(Layer *orig_layer, Layer *layer)
+/*
+ * The clip a layer is drawn with: the damage, narrowed by each of its
+ * parents (up to top) that clips. origin is where the layer's parent is
+ * on screen
+ */
+static GRect _layer_walk_clip(const Layer *layer, GPoint origin, const Layer *top, GRect damage)
 {
-    if (layer)
-    {       
-        if (layer->sibling == orig_layer || layer->child == orig_layer)
+    GRect clip = damage;
+
+    for (const Layer *l = layer->parent; l != top; l = l->parent)
+    {
+        if (l->clip)
+            clip = grect_intersection(clip, GRect(origin.x, origin.y, l->frame.size.w, l->frame.size.h));
+        origin.x -= l->frame.origin.x;
+        origin.y -= l->frame.origin.y;
+    }
+
+    return clip;
+}
+
+static void _layer_grow_damage(const Layer *layer, GPoint origin, GRect *damage, bool *grown)
+{
+    const Layer *top = layer ? layer->parent : NULL;
+    const Layer *l = layer;
+
+    /* the same way down and back up as _layer_walk */
+    while (l)
+    {
+        if (!l->hidden)
         {
-            return layer;
+            GRect rect = GRect(origin.x + l->frame.origin.x, origin.y + l->frame.origin.y,
+                               l->frame.size.w, l->frame.size.h);
+            GRect painted = _layer_get_painted(l, rect, *damage);
+
+            if (l->update_proc && painted.size.w > 0 && painted.size.h > 0)
+            {
+                GRect grown_damage = grect_union(*damage, painted);
+                if (!RECT_EQ(grown_damage, *damage))
+                {
+                    *damage = grown_damage;
+                    *grown = true;
+                }
+            }
+
+            if (l->child)
+            {
+                origin = rect.origin;
+                l = l->child;
+                continue;
+            }
         }
-        
-        // walk this elements sub elements recursively before moving on to the next element
-        Layer *found_layer = NULL;
-        found_layer = _layer_find_parent(orig_layer, layer->child);
-        if (found_layer)
-            return found_layer;
-        
-        found_layer = _layer_find_parent(orig_layer, layer->sibling);
-        if (found_layer)
-            return found_layer;
+
+        while (!l->sibling && l->parent != top)
+        {
+            l = l->parent;
+            origin.x -= l->frame.origin.x;
+            origin.y -= l->frame.origin.y;
+        }
+        l = l->sibling;
     }
-    return NULL;
 }
 
-int inj = 0;
-static void _layer_delete_tree(Layer *layer)
+/*
+ * What a layer at rect (on screen) paints when damage (on screen) is repainted.
+ * Without a damage proc that's the whole layer, if the damage touches it.
+ * With one, it's whatever the proc says, which can be outside the frame,
+ * as a menu's cells are once it has scrolled. A recorded list paints the
+ * whole layer
+ */
+static GRect _layer_get_painted(const Layer *layer, GRect rect, GRect damage)
+{
+    GRect hit = grect_intersection(rect, damage);
+
+    if (!layer->damage_proc || layer->recorded)
+        return hit.size.w > 0 && hit.size.h > 0 ? rect : hit;
+
+    GRect painted = layer->damage_proc(layer, GRect(damage.origin.x - rect.origin.x, damage.origin.y - rect.origin.y,
+                                                    damage.size.w, damage.size.h));
+    painted.origin.x += rect.origin.x;
+    painted.origin.y += rect.origin.y;
+    return painted;
+}
+
+/*
+ * Where a layer ends up on screen, and the window it is drawn in (if any)
+ */
+static GRect _layer_get_screen_frame(const Layer *layer, struct Window **window)
 {
-    if(!layer)
+    GRect rect = layer->frame;
+    const Layer *root = layer;
+
+    for (const Layer *l = layer->parent; l; l = l->parent)
+    {
+        rect.origin.x += l->frame.origin.x;
+        rect.origin.y += l->frame.origin.y;
+        root = l;
+    }
+
+    *window = root->window;
+    if (*window)
+    {
+        rect.origin.x += (*window)->frame.origin.x;
+        rect.origin.y += (*window)->frame.origin.y;
+    }
+
+    return rect;
+}
+
+/*
+ * Cached layers.
+ * The cache is a copy of the framebuffer rows under the layer, taken just after
+ * its update_proc ran (so before its children are drawn over it). 
+ * On B&W it is whole bytes, so the edges are masked on the way back.
+ */
+static void _layer_cache_free(Layer *layer)
+{
+    if (!layer->cache)
         return;
 
-    char sinj[20] = "";
-    for(int i = 0; i < inj; i++)
-        strncat(sinj, "   ", 3);
+    app_free(layer->cache);
+    layer->cache = NULL;
+}
+
+static bool _layer_cache_restore(Layer *layer, GRect rect, GRect hit)
+{
+    LayerCache *cache = layer->cache;
+
+    if (!cache)
+        return false;
+
+    if (app_heap_bytes_free() < LAYER_CACHE_HEAP_RESERVE)
+    {
+        LOG_INFO("Heap low, dropping cache for %x", layer);
+        _layer_cache_free(layer);
+        return false;
+    }
+
+    if (!cache->valid ||
+        !RECT_EQ(cache->rect, grect_intersection(rect, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS))))
+        return false;
+
+    hit = grect_intersection(hit, cache->rect);
+    if (hit.size.w <= 0 || hit.size.h <= 0)
+        return true;
+    
+#ifdef DISPLAY_DEBUG_STATS
+    TickType_t start = xTaskGetTickCount();
+#endif
+    uint8_t *fb = display_get_buffer();
+    uint16_t first = LAYER_CACHE_BYTE(hit.origin.x);
+    uint16_t last = LAYER_CACHE_BYTE(hit.origin.x + hit.size.w - 1);
+    const uint8_t *src = cache->data + (hit.origin.y - cache->rect.origin.y) * cache->row_bytes +
+                         first - LAYER_CACHE_BYTE(cache->rect.origin.x);
+    
+    for (int16_t y = hit.origin.y; y < hit.origin.y + hit.size.h; y++)
+    {
+        uint8_t *dst = fb + y * DISPLAY_ROW_BYTES + first;
+#ifdef PBL_BW
+        /* pixels are LSB first within each byte */
+        uint8_t first_mask = 0xFF << (hit.origin.x & 7);
+        uint8_t last_mask = 0xFF >> (7 - ((hit.origin.x + hit.size.w - 1) & 7));
+        
+        if (first == last)
+        {
+            first_mask &= last_mask;
+            dst[0] = (dst[0] & ~first_mask) | (src[0] & first_mask);
+        }
+        else
+        {
+            dst[0] = (dst[0] & ~first_mask) | (src[0] & first_mask);
+            memcpy(dst + 1, src + 1, last - first - 1);
+            dst[last - first] = (dst[last - first] & ~last_mask) | (src[last - first] & last_mask);
+        }
+#else
+        memcpy(dst, src, last - first + 1);
+#endif
+        src += cache->row_bytes;
+    }
     
-    SYS_LOG("test", APP_LOG_LEVEL_DEBUG, "DTREE %s |_ CHILD %d", sinj, layer);
-    if (layer->child)
+#ifdef DISPLAY_DEBUG_STATS
+    LOG_DEBUG("cache %x: blit %dms, redraw was %dms", layer,
+            (xTaskGetTickCount() - start) * portTICK_PERIOD_MS, cache->draw_ticks * portTICK_PERIOD_MS);
+#endif
+    return true;
+}
+
+static void _layer_cache_capture(Layer *layer, GRect rect, GRect hit, TickType_t start)
+{
+    if (!layer->cached)
+        return;
+
+    /* only worth keeping if all of the on screen part was just painted */
+    rect = grect_intersection(rect, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    if (!RECT_EQ(rect, hit) || rect.size.w <= 0 || rect.size.h <= 0)
+        return;
+
+    uint16_t first = LAYER_CACHE_BYTE(rect.origin.x);
+    uint16_t row_bytes = LAYER_CACHE_BYTE(rect.origin.x + rect.size.w - 1) - first + 1;
+    size_t size = sizeof(LayerCache) + row_bytes * rect.size.h;
+
+    if (layer->cache && !RECT_EQ(layer->cache->rect, rect))
+        _layer_cache_free(layer);
+
+    if (!layer->cache)
     {
-        inj++;
-        _layer_delete_tree(layer->child);
-        inj--;
+        if (app_heap_bytes_free() < size + LAYER_CACHE_HEAP_RESERVE)
+            return;
+        
+        layer->cache = app_calloc(1, size);
+        if (!layer->cache)
+            return;
     }
-    if (layer->sibling)
+
+    LayerCache *cache = layer->cache;
+    uint8_t *fb = display_get_buffer();
+    
+    for (int16_t y = 0; y < rect.size.h; y++)
+        memcpy(cache->data + y * row_bytes,
+               fb + (rect.origin.y + y) * DISPLAY_ROW_BYTES + first, row_bytes);
+    
+    cache->rect = rect;
+    cache->row_bytes = row_bytes;
+    cache->draw_ticks = xTaskGetTickCount() - start;
+    cache->valid = true;
+}
+
+/*
+ * Recorded layers.
+ * The update_proc runs with the graphics_* calls appending to the layer's
+ * draw list, which is replayed whenever the layer needs painting.
+ * The layer is recorded whole, whatever is damaged, so the list can be
+ * compared against the last one. rect is where it is on screen.
+ * If it couldn't all be recorded, the layer just draws instead.
+ */
+static void _layer_record(Layer *layer, GContext *context, GRect rect)
+{
+    const Layer *damage_layer = _damage_layer;
+    GRect offset = context->offset;
+
+    if (!layer->draw_list)
+        layer->draw_list = draw_list_create();
+    
+    DrawList *list = layer->draw_list;
+    if (!list)
+        return;
+
+    list->len = 0;
+    list->complete = true;
+    list->external = false;
+    list->rect = rect;
+    layer->record_pending = false;
+
+    context->offset = rect;
+    _damage_layer = NULL;
+    draw_list_record_begin(list);
+    layer->update_proc(layer, context);
+    draw_list_record_end();
+    _damage_layer = damage_layer;
+    context->offset = offset;
+
+#ifdef DRAW_LIST_LOG
+    draw_list_log(list);
+#endif
+}
+
+static bool _layer_replay(Layer *layer, GContext *context, GRect rect)
+{
+    if (!layer->recorded)
+        return false;
+
+    if (!layer->draw_list || layer->record_pending)
+        _layer_record(layer, context, rect);
+
+    if (!layer->draw_list || !layer->draw_list->complete)
+        return false;
+
+    /* what is on screen is wherever we draw it now, e.g. mid push */
+    layer->draw_list->rect = rect;
+    draw_list_replay(layer->draw_list, context);
+    return true;
+}
+
+/*
+ * Free everything under parent. Leaves first, finding the way back up
+ * by the parent links, so there is no recursion however deep it goes
+ */
+static void _layer_delete_tree(Layer *parent)
+{
+    Layer *layer = parent->child;
+
+    while (layer)
     {
-        inj++;
-        SYS_LOG("test", APP_LOG_LEVEL_DEBUG, "DTREE %s   = SIB %d", sinj, layer);
-        _layer_delete_tree(layer->sibling);
-        inj--;
+        while (layer->child)
+            layer = layer->child;
+
+        /* a leaf, and the first child of its parent */
+        Layer *up = layer->parent;
+        Layer *next = layer->sibling;
+        up->child = next;
+        if (next)
+        {
+            next->prev_sibling = NULL;
+        }
+        else
+        {
+            up->last_child = NULL;
+            next = up == parent ? NULL : up;
+        }
+
+        _layer_release(layer);
+        app_free(layer);
+        layer = next;
     }
-    SYS_LOG("test", APP_LOG_LEVEL_DEBUG, "DTREE %s    DONE %d", sinj, layer);
-    app_free(layer);
 }
 
 void *layer_get_data(const Layer *layer)
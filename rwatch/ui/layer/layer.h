@@ -12,16 +12,25 @@
 
 struct Window;
 struct Layer;
+struct LayerCache;
+struct DrawList;
 
 // Callback for the layer drawing
 // typedef it for cleanness
 typedef void (*LayerUpdateProc)(struct Layer *layer, GContext *context);
+// Given the damage in a layer's own coordinates, the part of it the
+// update_proc will actually paint. Two steps, as "GRect (" would be
+// taken for the GRect(x, y, w, h) macro
+typedef GRect LayerDamageFunc(const struct Layer *layer, GRect damage);
+typedef LayerDamageFunc *LayerDamageProc;
 
 // Make sure these are the same. 
 typedef struct Layer
 {
     struct Layer *child;
+    struct Layer *last_child;
     struct Layer *sibling;
+    struct Layer *prev_sibling;
     struct Layer *parent;
     void *container; // pointer to parent type, if any. i.e. a textlayer
     struct Window  *window;
@@ -29,8 +38,14 @@ typedef struct Layer
     GRect frame;
     bool clip;
     LayerUpdateProc update_proc;
+    LayerDamageProc damage_proc; // NULL means update_proc paints the whole frame, and only that
     void *callback_data;
     bool hidden;
+    bool cached;
+    struct LayerCache *cache; // what update_proc last painted, if cached
+    bool recorded;
+    bool record_pending; // marked dirty since draw_list was recorded
+    struct DrawList *draw_list; // what update_proc last drew, if recorded
 } Layer;
 
 
@@ -65,8 +80,30 @@ void layer_set_hidden(Layer *layer, bool hidden);
 bool layer_get_hidden(const Layer *layer);
 void layer_set_clips(Layer *layer, bool clips);  //TODO
 bool layer_get_clips(const Layer *layer); //TODO
+/* A cached layer's update_proc is only called again after layer_mark_dirty,
+ * otherwise the pixels it painted last time are copied back. The layer must
+ * paint every pixel of its frame, and not depend on anything below it */
+void layer_set_cached(Layer *layer, bool cached);
+bool layer_get_cached(const Layer *layer);
+/* A recorded layer's update_proc draws into a list instead of the screen.
+ * When it is marked dirty, the list is recorded again, and only if it came out
+ * different is the layer repainted. Everything must be drawn through the
+ * graphics_* calls, and with context state the update_proc sets itself */
+void layer_set_recorded(Layer *layer, bool recorded);
+bool layer_get_recorded(const Layer *layer);
+void layer_record_pending(const Layer *root, GContext *context);
 void *layer_get_data(const Layer *layer); //TODO
 void layer_draw(const Layer *layer, GContext *context);
+/* Layers with a damage proc only paint what layer_get_damage() covers.
+ * The proc says what that is, and may go outside the frame; the layer is
+ * drawn whenever it touches the damage, wherever its frame is */
+void layer_set_damage_proc(Layer *layer, LayerDamageProc damage_proc);
+GRect layer_get_damage(const Layer *layer);
+void layer_scroll_frame(Layer *layer, GRect frame);
+bool layer_subtree_owns_rect(const Layer *root, GPoint origin, const Layer *owner, GRect rect);
+void layer_draw_damage(const Layer *layer, GContext *context, GRect damage);
+GRect layer_grow_damage(const Layer *layer, GPoint origin, GRect damage);
+bool layer_tree_check(const Layer *root);
 // updates context offset based on layer frame, used to properly adjust layer drawing calls
 void layer_apply_frame_offset(const Layer *layer, GContext *context);
 
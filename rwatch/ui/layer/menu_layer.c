@@ -10,6 +10,10 @@
 extern void graphics_draw_bitmap_in_rect(GContext *, const GBitmap *, GRect);
 
 static void menu_layer_update_proc(Layer *layer, GContext *nGContext);
+static void _menu_layer_reload(MenuLayer *menu_layer, bool keep_layout);
+static void _menu_layer_layout_to(MenuLayer *menu_layer, const MenuIndex *index, int16_t y);
+static void _menu_layer_update_content_size(MenuLayer *menu_layer);
+static GRect _menu_layer_damage_proc(const Layer *layer, GRect damage);
 
 #define MenuRow(section, row, x, y, h) ((MenuCellSpan){ (x), (y), (h), 0, false, MenuIndex((section), (row)) })
 #define MenuHeader(section, x, y, h) ((MenuCellSpan){ (x), (y), (h), 0, true, MenuIndex((section), 0) })
@@ -25,7 +29,9 @@ void menu_layer_ctor(MenuLayer *mlayer, GRect frame)
     mlayer->layer.container = mlayer;
 
     mlayer->column_count = 1;
+    mlayer->sections_count = 0;
     mlayer->cells_count = 0;
+    mlayer->cells_ready = 0;
     mlayer->selected = MenuIndex(0, 0);
     mlayer->end_index = MenuIndex(0, 1);
     mlayer->bg_color = GColorWhite;
@@ -43,6 +49,7 @@ void menu_layer_ctor(MenuLayer *mlayer, GRect frame)
 #endif
 
     layer_set_update_proc(&mlayer->layer, menu_layer_update_proc);
+    layer_set_damage_proc(&mlayer->layer, _menu_layer_damage_proc);
 
     scroll_layer_add_child(&mlayer->scroll_layer, &mlayer->layer);
 }
@@ -124,12 +131,29 @@ void menu_layer_set_selected_next(MenuLayer *menu_layer, bool up, MenuRowAlign s
     menu_layer_set_selected_index(menu_layer, get_next_index(menu_layer, up), scroll_align, animated);
 }
 
+/*
+ * Cells are in index order, a section's header before its first row
+ */
 static MenuCellSpan *_get_cell_span(MenuLayer *menu_layer, const MenuIndex *index)
 {
-    // TODO: optimize, binary search should be enough
-    for (size_t cell = 0; cell < menu_layer->cells_count; ++cell)
-        if (menu_index_compare(index, &menu_layer->cells[cell].index) == 0 && !menu_layer->cells[cell].header)
-            return &menu_layer->cells[cell];
+    _menu_layer_layout_to(menu_layer, index, INT16_MIN);
+
+    size_t lo = 0, hi = menu_layer->cells_ready;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        MenuCellSpan *span = &menu_layer->cells[mid];
+        int16_t cmp = menu_index_compare(&span->index, index);
+        
+        if (cmp < 0 || (cmp == 0 && span->header))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < menu_layer->cells_ready && !menu_layer->cells[lo].header &&
+        menu_index_compare(&menu_layer->cells[lo].index, index) == 0)
+        return &menu_layer->cells[lo];
 
     return NULL;
 }
@@ -150,11 +174,17 @@ static int16_t _get_aligned_edge_position(int16_t height, MenuRowAlign align)
 void _menu_layer_update_scroll_offset(MenuLayer* menu_layer, MenuRowAlign scroll_align, bool animated) {
     MenuIndex index = menu_layer_get_selected_index(menu_layer);
     MenuCellSpan *cell = _get_cell_span(menu_layer, &index);
+    
+    // wherever we scroll to, lay out a screen past it so the whole view is known
+    if (cell)
+        _menu_layer_layout_to(menu_layer, NULL, cell->y + layer_get_frame(&menu_layer->scroll_layer.layer).size.h);
+    _menu_layer_update_content_size(menu_layer);
+    
     if (cell && scroll_align != MenuRowAlignNone)
     {
         if (menu_layer->is_center_focus)
             scroll_align = MenuRowAlignCenter;
-        GSize size = layer_get_frame(&menu_layer->layer).size;
+        GSize size = layer_get_frame(&menu_layer->scroll_layer.layer).size;
         int16_t span_pos = cell->y + _get_aligned_edge_position(cell->h, scroll_align);
         int16_t frame_pos = _get_aligned_edge_position(size.h, scroll_align);
 
@@ -239,6 +269,16 @@ void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, Men
 }
 
 void menu_layer_reload_data(MenuLayer *menu_layer)
+{
+    _menu_layer_reload(menu_layer, true);
+}
+
+/*
+ * Count the cells, and throw away the layout unless rows were just appended.
+ * Reloads scheduled by the menu itself are there to pick up new heights, so
+ * they always start over.
+ */
+static void _menu_layer_reload(MenuLayer *menu_layer, bool keep_layout)
 {
     menu_layer->is_reload_scheduled = false;
 
@@ -247,6 +287,7 @@ void menu_layer_reload_data(MenuLayer *menu_layer)
         sections = menu_layer->callbacks.get_num_sections(menu_layer, menu_layer->context);
 
     uint16_t last_section = (uint16_t) (sections - 1);
+    MenuIndex old_end = menu_layer->end_index;
     menu_layer->end_index = MenuIndex(last_section, get_num_rows(menu_layer, last_section));
 
     // count cells
@@ -259,72 +300,230 @@ void menu_layer_reload_data(MenuLayer *menu_layer)
         cells += menu_layer->callbacks.get_num_rows(menu_layer, section, menu_layer->context);
     }
 
+    // Only the last section grew, so everything laid out so far still stands
+    bool appended = keep_layout && menu_layer->cells_count > 0 && cells > menu_layer->cells_count &&
+                    sections == menu_layer->sections_count &&
+                    menu_layer->end_index.row > old_end.row &&
+                    cells - menu_layer->cells_count == menu_layer->end_index.row - old_end.row;
+
     // allocate cells array if needed
     if (menu_layer->cells_count != cells)
     {
-        if (menu_layer->cells_count > 0)
-            app_free(menu_layer->cells);
+        MenuCellSpan *grown = appended
+            ? (MenuCellSpan *)app_realloc(menu_layer->cells, cells * sizeof(MenuCellSpan))
+            : NULL;
+        
+        if (!grown)
+        {
+            appended = false;
+            if (menu_layer->cells_count > 0)
+                app_free(menu_layer->cells);
+            if (cells > 0)
+               grown = (MenuCellSpan *)app_calloc(cells, sizeof(MenuCellSpan));
+        }
 
-        menu_layer->cells_count = cells;
-        if (cells > 0)
-           menu_layer->cells = (MenuCellSpan *)app_calloc(cells, sizeof(MenuCellSpan));
+        menu_layer->cells = grown;
+        menu_layer->cells_count = grown ? cells : 0;
     }
+    menu_layer->sections_count = sections;
 
-    // generate cells
-    size_t cell = 0;
-    uint16_t cell_width = menu_layer->layer.frame.size.w / menu_layer->column_count;
-    uint16_t oversized_columns = menu_layer->layer.frame.size.w % menu_layer->column_count;
-    int16_t column = 0;
-    int16_t y = 0;
-    int16_t h = 0;
-    for (uint16_t section = 0; section < sections; ++section)
+    if (appended && menu_layer->layout_section == last_section)
     {
-        if (menu_layer->callbacks.get_header_height)
+        // a short last row gets laid out again, with the new cells alongside
+        uint16_t spare = menu_layer->layout_row % menu_layer->column_count;
+        if (spare)
         {
-            h = menu_layer->callbacks.get_header_height(menu_layer, section, menu_layer->context);
-            menu_layer->cells[cell++] = MenuHeader(section, 0, y, h);
-            y += h;
-            // TODO: add space for separator
+            menu_layer->cells_ready -= spare;
+            menu_layer->layout_row -= spare;
+            menu_layer->layout_y -= menu_layer->cells[menu_layer->cells_ready].h;
         }
+        menu_layer->layout_rows = menu_layer->end_index.row;
+    }
+    else if (!appended)
+    {
+        menu_layer->cells_ready = 0;
+        menu_layer->layout_section = 0;
+        menu_layer->layout_row = 0;
+        menu_layer->layout_rows = menu_layer->cells_count ? get_num_rows(menu_layer, 0) : 0;
+        menu_layer->layout_y = 0;
+        menu_layer->layout_header_pending = true;
+    }
+
+    _menu_layer_update_scroll_offset(menu_layer, MenuRowAlignCenter, false);
+    layer_mark_dirty(&menu_layer->layer);
+}
 
-        column = 0;
-        uint16_t rows = menu_layer->callbacks.get_num_rows(menu_layer, section, menu_layer->context);
-        h = 0;
-        for (uint16_t row = 0; row < rows; ++row)
+/*
+ * Lay out the next header, or the next row of columns. 
+ * Returns false once every cell has its place
+ */
+static bool _menu_layer_layout_step(MenuLayer *menu_layer)
+{
+    if (menu_layer->cells_ready >= menu_layer->cells_count)
+        return false;
+
+    if (menu_layer->layout_header_pending)
+    {
+        menu_layer->layout_header_pending = false;
+        if (menu_layer->callbacks.get_header_height)
         {
-            MenuIndex index = MenuIndex(section, row);
-            int16_t cur_h = menu_layer->callbacks.get_cell_height
-                ? menu_layer->callbacks.get_cell_height(menu_layer, &index, menu_layer->context)
-                : MENU_CELL_BASIC_CELL_HEIGHT;
-            if (cur_h > h)
-                h = cur_h;
-
-            int16_t x = column * cell_width + (column > 0 && column < oversized_columns);
-            menu_layer->cells[cell++] = MenuRow(section, row, x, y, h);
-
-            column++;
-            if (column >= menu_layer->column_count)
-            {
-                // the height of the row might have changed, reset all
-                for (uint16_t col = 0; col < menu_layer->column_count - 1; col++)
-                {
-                    menu_layer->cells[cell - menu_layer->column_count + col].h = h;
-                }
-
-                column = 0;
-                y += h;
-                h = 0;
-                // TODO: add space for separator
-            }
+            int16_t h = menu_layer->callbacks.get_header_height(menu_layer, menu_layer->layout_section,
+                                                                menu_layer->context);
+            menu_layer->cells[menu_layer->cells_ready++] = MenuHeader(menu_layer->layout_section, 0,
+                                                                      menu_layer->layout_y, h);
+            menu_layer->layout_y += h;
+            // TODO: add space for separator
+            return true;
         }
     }
 
+    if (menu_layer->layout_row >= menu_layer->layout_rows)
+    {
+        if (menu_layer->layout_section + 1 >= menu_layer->sections_count)
+            return false;
+        
+        menu_layer->layout_section++;
+        menu_layer->layout_row = 0;
+        menu_layer->layout_rows = get_num_rows(menu_layer, menu_layer->layout_section);
+        menu_layer->layout_header_pending = true;
+        return true;
+    }
 
+    uint16_t cell_width = menu_layer->layer.frame.size.w / menu_layer->column_count;
+    uint16_t oversized_columns = menu_layer->layer.frame.size.w % menu_layer->column_count;
+    size_t first = menu_layer->cells_ready;
+    int16_t h = 0;
+    
+    for (uint16_t column = 0; column < menu_layer->column_count &&
+                              menu_layer->layout_row < menu_layer->layout_rows &&
+                              menu_layer->cells_ready < menu_layer->cells_count; column++)
+    {
+        MenuIndex index = MenuIndex(menu_layer->layout_section, menu_layer->layout_row++);
+        int16_t cur_h = menu_layer->callbacks.get_cell_height
+            ? menu_layer->callbacks.get_cell_height(menu_layer, &index, menu_layer->context)
+            : MENU_CELL_BASIC_CELL_HEIGHT;
+        if (cur_h > h)
+            h = cur_h;
+
+        int16_t x = column * cell_width + (column > 0 && column < oversized_columns);
+        menu_layer->cells[menu_layer->cells_ready++] = MenuRow(index.section, index.row, x, menu_layer->layout_y, 0);
+    }
+    
+    // the whole row is as tall as its tallest cell
+    for (size_t cell = first; cell < menu_layer->cells_ready; cell++)
+        menu_layer->cells[cell].h = h;
+    
+    menu_layer->layout_y += h;
+    // TODO: add space for separator
+    return true;
+}
+
+static bool _menu_layer_is_laid_out(const MenuLayer *menu_layer, const MenuIndex *index)
+{
+    if (menu_layer->cells_ready == 0)
+        return false;
+
+    const MenuCellSpan *last = &menu_layer->cells[menu_layer->cells_ready - 1];
+    int16_t cmp = menu_index_compare(index, &last->index);
+
+    return cmp < 0 || (cmp == 0 && !last->header);
+}
+
+/*
+ * Make sure cells are laid out down past y, and as far as index if given
+ */
+static void _menu_layer_layout_to(MenuLayer *menu_layer, const MenuIndex *index, int16_t y)
+{
+    while ((menu_layer->layout_y <= y || (index && !_menu_layer_is_laid_out(menu_layer, index)))
+           && _menu_layer_layout_step(menu_layer))
+        ;
+}
+
+/*
+ * Until the whole menu is laid out, guess the rest are the same
+ * height as those we have seen so far
+ */
+static void _menu_layer_update_content_size(MenuLayer *menu_layer)
+{
     GSize size = layer_get_frame(&menu_layer->layer).size;
-    size.h = y + (column == 0 ? 0 : h);
-    scroll_layer_set_content_size(&menu_layer->scroll_layer, size);
-    _menu_layer_update_scroll_offset(menu_layer, MenuRowAlignCenter, false);
-    layer_mark_dirty(&menu_layer->layer);
+    int32_t h = menu_layer->layout_y;
+
+    if (menu_layer->cells_ready > 0 && menu_layer->cells_ready < menu_layer->cells_count)
+        h += (int32_t)(menu_layer->cells_count - menu_layer->cells_ready) * menu_layer->layout_y
+             / (int32_t)menu_layer->cells_ready;
+    size.h = MIN(h, INT16_MAX);
+
+    if (!SIZE_EQ(size, scroll_layer_get_content_size(&menu_layer->scroll_layer)))
+        scroll_layer_set_content_size(&menu_layer->scroll_layer, size);
+}
+
+/*
+ * The part of the menu layer in view, limited to damage
+ */
+static void _menu_layer_get_view(MenuLayer *menu_layer, GRect damage, int16_t *top, int16_t *bottom)
+{
+    GPoint scroll_offset = scroll_layer_get_content_offset(&menu_layer->scroll_layer);
+    int16_t view_top = -scroll_offset.y - menu_layer->layer.frame.origin.y;
+    int16_t view_bottom = view_top + layer_get_frame(&menu_layer->scroll_layer.layer).size.h;
+    
+    *top = MAX(view_top, damage.origin.y);
+    *bottom = MIN(view_bottom, damage.origin.y + damage.size.h);
+}
+
+/*
+ * The cells from first up to (not including) end overlap top..bottom
+ */
+static void _menu_layer_get_cells_between(MenuLayer *menu_layer, int16_t top, int16_t bottom,
+                                          size_t *first, size_t *end)
+{
+    _menu_layer_layout_to(menu_layer, NULL, bottom);
+    
+    // first cell that ends below the top
+    size_t lo = 0, hi = menu_layer->cells_ready;
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        if (menu_layer->cells[mid].y + menu_layer->cells[mid].h <= top)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    *first = lo;
+    while (lo < menu_layer->cells_ready && menu_layer->cells[lo].y < bottom)
+        lo++;
+    *end = lo;
+}
+
+/*
+ * What we paint for the damage: the part of it in view, spread to every
+ * cell it touches as cells are painted whole. The cells are wherever the
+ * scroll has put them, not in our frame, which is left as the app set it.
+ * Centre focus keeps the cursor still while the cells move, so that repaints
+ * all of the view
+ */
+static GRect _menu_layer_damage_proc(const Layer *layer, GRect damage)
+{
+    MenuLayer *menu_layer = (MenuLayer *) layer->container;
+    int16_t top, bottom;
+    size_t first, end;
+
+    if (menu_layer->is_center_focus || menu_layer->is_reload_scheduled ||
+        menu_layer->reload_behaviour == MenuLayerReloadBehaviourOnRender)
+        damage = GRect(0, INT16_MIN / 2, layer->frame.size.w, INT16_MAX);
+
+    _menu_layer_get_view(menu_layer, damage, &top, &bottom);
+    if (top >= bottom)
+        return GRect(0, 0, 0, 0);
+    
+    _menu_layer_get_cells_between(menu_layer, top, bottom, &first, &end);
+    if (first < end)
+    {
+        top = MIN(top, menu_layer->cells[first].y);
+        bottom = MAX(bottom, menu_layer->cells[end - 1].y + menu_layer->cells[end - 1].h);
+    }
+    
+    return GRect(0, top, layer->frame.size.w, bottom - top);
 }
 
 // Input handling -------------
@@ -440,45 +639,60 @@ static void menu_layer_draw_cell(GContext *context, const MenuLayer *menu_layer,
 static void menu_layer_update_proc(Layer *layer, GContext *nGContext)
 {
     MenuLayer *menu_layer = (MenuLayer *) layer->container;
-    GRect frame = layer_get_frame(layer);
-    uint16_t cell_width = frame.size.w / menu_layer->column_count;
+    uint16_t cell_width = layer->frame.size.w / menu_layer->column_count;
+    int16_t view_h = layer_get_frame(&menu_layer->scroll_layer.layer).size.h;
 
     if (menu_layer->is_reload_scheduled || menu_layer->reload_behaviour == MenuLayerReloadBehaviourOnRender)
-        menu_layer_reload_data(menu_layer);
+        _menu_layer_reload(menu_layer, false);
+    
+    // after any reload, which can change our size
+    GRect frame = layer_get_frame(layer);
+    GRect damage = layer_get_damage(layer);
+    int16_t top, bottom;
+    size_t first, end;
+    
+    _menu_layer_get_view(menu_layer, damage, &top, &bottom);
+    _menu_layer_get_cells_between(menu_layer, top, bottom, &first, &end);
     
     // Draw background
+    GPoint scroll_offset = scroll_layer_get_content_offset(&menu_layer->scroll_layer);
     if (menu_layer->is_center_focus)
     {
-        GPoint scroll_offset = scroll_layer_get_content_offset(&menu_layer->scroll_layer);
         MenuCellSpan* focused_cell = _get_cell_span(menu_layer, &menu_layer->selected);
-        GRect cursor_rect = GRect(focused_cell->x, (layer->frame.size.h / 2) - (focused_cell->h / 2) - scroll_offset.y,
+        if (!focused_cell)
+            return;
+        GRect cursor_rect = GRect(focused_cell->x, (view_h / 2) - (focused_cell->h / 2) - scroll_offset.y,
                                   cell_width, focused_cell->h);
 
         graphics_context_set_fill_color(nGContext, menu_layer->bg_color);
         if (menu_layer->column_count == 1) {
-            // fill everything except the cursor
-            GRect background_rect = GRect(0, -scroll_offset.y, frame.size.w, cursor_rect.origin.y);
+            // fill everything in view except the cursor
+            GRect background_rect = GRect(0, -scroll_offset.y, frame.size.w, cursor_rect.origin.y + scroll_offset.y);
             graphics_fill_rect(nGContext, background_rect, 0, GCornerNone);
             background_rect = GRect(0, cursor_rect.origin.y + cursor_rect.size.h,
-                                    layer->frame.size.w, layer->frame.size.h - (cursor_rect.origin.y + cursor_rect.size.h));
+                                    frame.size.w, view_h - (cursor_rect.origin.y + cursor_rect.size.h + scroll_offset.y));
             graphics_fill_rect(nGContext, background_rect, 0, GCornerNone);
         } else {
             // fill everything, no real gain here anymore to split the work
-            graphics_fill_rect(nGContext, frame, 0, GCornerNone);
+            graphics_fill_rect(nGContext, GRect(0, -scroll_offset.y, frame.size.w, view_h), 0, GCornerNone);
         }
 
         // draw the cursor
         graphics_context_set_fill_color(nGContext, menu_layer->bg_hi_color);
         graphics_fill_rect(nGContext, cursor_rect, 0, GCornerNone);
     } else if (!menu_layer->callbacks.draw_background) {
+        // behind the damage, and the whole of every cell we paint
+        int16_t fill_top = first < end ? MIN(top, menu_layer->cells[first].y) : top;
+        int16_t fill_bottom = first < end ? MAX(bottom, menu_layer->cells[end - 1].y + menu_layer->cells[end - 1].h)
+                                          : bottom;
         graphics_context_set_fill_color(nGContext, menu_layer->bg_color);
-        graphics_fill_rect(nGContext, frame, 0, GCornerNone);
+        if (fill_bottom > fill_top)
+            graphics_fill_rect(nGContext, GRect(0, fill_top, frame.size.w, fill_bottom - fill_top), 0, GCornerNone);
     }
 
-    // Draw cells
-    for (size_t cell = 0; cell < menu_layer->cells_count; ++cell)
+    // Draw only the cells in view
+    for (size_t cell = first; cell < end; ++cell)
     {
-        // TODO: only draw visible cells based on layer frame/bounds
         MenuCellSpan *span = menu_layer->cells + cell;
         layer->callback_data = span;
         layer->frame = GRect(span->x, span->y, (span->header ? frame.size.w : cell_width), span->h);
@@ -108,11 +108,20 @@ typedef struct MenuLayer
   MenuLayerReloadBehaviour reload_behaviour;
 
   uint16_t column_count;
+  uint16_t sections_count;
   size_t cells_count;
   MenuCellSpan *cells;
   MenuIndex selected;
   MenuIndex end_index;
 
+  // cells are laid out lazily, only as far down as something needs them
+  size_t cells_ready;
+  uint16_t layout_section;
+  uint16_t layout_row;
+  uint16_t layout_rows; // rows in layout_section
+  int16_t layout_y;
+  bool layout_header_pending;
+
   GColor bg_color;
   GColor bg_hi_color;
   GColor fg_color;
@@ -156,6 +165,8 @@ void menu_layer_set_selected_index(MenuLayer *menu_layer, MenuIndex index,
 
 MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer);
 
+//! Reloads the data of the \ref MenuLayer. If the only change is rows appended to
+//! the last section, the heights already measured are kept.
 void menu_layer_reload_data(MenuLayer *menu_layer);
 
 bool menu_cell_layer_is_highlighted(const Layer *layer);
@@ -249,7 +249,7 @@ static void _scroll_down_click_handler(ClickRecognizerRef recognizer, void *cont
             Notification *n = list_elem(notification->node.next, Notification, node);
             notification_layer->active = n;
 
-            SYS_LOG("notification_layer", APP_LOG_LEVEL_DEBUG, notification_layer->active->app_name);
+            SYS_LOG("notification_layer", APP_LOG_LEVEL_DEBUG, "%s", notification_layer->active->app_name);
             
             // Scroll to top
             _scroll_to(notification_layer, DISPLAY_ROWS, 0, true);
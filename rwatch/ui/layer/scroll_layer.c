@@ -114,7 +114,20 @@ void scroll_layer_set_content_offset(ScrollLayer *scroll_layer, GPoint offset, b
                                  frame.size.w,
                                  frame.size.h);
     
-    scroll_layer->animation = property_animation_create_layer_frame(&scroll_layer->content_sublayer, &scroll_layer->prev_scroll_offset, &scroll_layer->scroll_offset);
+    /* like property_animation_create_layer_frame, but each step scrolls what's on screen */
+    const PropertyAnimationImplementation implementation = {
+        .base = {
+            .update = (AnimationUpdateImplementation) property_animation_update_grect,
+            .teardown = (AnimationTeardownImplementation) property_animation_destroy,
+        },
+        .accessors = {
+            .setter = { .grect = (GRectSetter) layer_scroll_frame },
+            .getter = { .grect = (GRectGetter) layer_get_frame },
+        },
+    };
+    
+    scroll_layer->animation = property_animation_create(&implementation, &scroll_layer->content_sublayer,
+                                                        &scroll_layer->prev_scroll_offset, &scroll_layer->scroll_offset);
     Animation *anim = property_animation_get_animation(scroll_layer->animation);
     animation_set_duration(anim, 100);
     animation_schedule(anim);
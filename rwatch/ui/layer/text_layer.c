@@ -9,6 +9,8 @@
 #include "text.h"
 
 void text_layer_draw(struct Layer *layer, GContext *context);
+static uint32_t _text_hash(const char *text);
+static void _text_layer_changed(TextLayer *text_layer);
 
 void text_layer_ctor(TextLayer *tlayer, GRect frame)
 {
@@ -19,10 +21,13 @@ void text_layer_ctor(TextLayer *tlayer, GRect frame)
     tlayer->background_color = GColorWhite;
     tlayer->text_alignment = GTextAlignmentLeft;
     tlayer->font = fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD);
+    tlayer->layout.valid = false;
 
     // hook the draw callback to us
     // this way we control the text, bound, pagination etc
     layer_set_update_proc(&tlayer->layer, text_layer_draw);
+    /* setting the same text again then costs a compare, not a repaint */
+    layer_set_recorded(&tlayer->layer, true);
 }
 
 void text_layer_dtor(TextLayer *tlayer)
@@ -52,8 +57,15 @@ Layer *text_layer_get_layer(TextLayer *text_layer)
 
 void text_layer_set_text(TextLayer *text_layer, const char* text)
 {
+    uint32_t hash = _text_hash(text);
+    
+    /* Faces tend to set the same string every tick. Nothing to redraw */
+    if (text == text_layer->text && hash == text_layer->text_hash)
+        return;
+    
     text_layer->text = text;
-    layer_mark_dirty(&text_layer->layer);
+    text_layer->text_hash = hash;
+    _text_layer_changed(text_layer);
 }
 
 const char *text_layer_get_text(TextLayer *text_layer)
@@ -75,33 +87,100 @@ void text_layer_set_text_color(TextLayer *text_layer, GColor color)
 
 void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode)
 {
+    if (text_layer->overflow_mode == line_mode)
+        return;
+    
     text_layer->overflow_mode = line_mode;
-    layer_mark_dirty(&text_layer->layer);
+    _text_layer_changed(text_layer);
 }
 
 void text_layer_set_font(TextLayer * text_layer, GFont font)
 {   
+    if (text_layer->font == font)
+        return;
+    
     text_layer->font = font;
-    layer_mark_dirty(&text_layer->layer);
+    _text_layer_changed(text_layer);
 }
 
 void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment)
 {
+    if (text_layer->text_alignment == text_alignment)
+        return;
+    
     text_layer->text_alignment = text_alignment;
-    layer_mark_dirty(&text_layer->layer);
+    _text_layer_changed(text_layer);
 }
 
+/*
+ * The size the text takes up when laid out in the layer.
+ * Only laid out again when something it depends on has changed.
+ */
 GSize text_layer_get_content_size(TextLayer *text_layer)
 {
-    return text_layer->layer.bounds.size;
+    TextLayout *layout = &text_layer->layout;
+    GSize box = text_layer->layer.frame.size;
+    
+    if (!text_layer->text)
+        return GSize(0, 0);
+    
+    uint32_t hash = _text_hash(text_layer->text);
+    
+    if (layout->valid &&
+        layout->text == text_layer->text &&
+        layout->hash == hash &&
+        layout->font == text_layer->font &&
+        layout->box.w == box.w && layout->box.h == box.h &&
+        layout->overflow_mode == text_layer->overflow_mode &&
+        layout->text_alignment == text_layer->text_alignment)
+        return layout->content_size;
+    
+    layout->content_size = graphics_text_layout_get_content_size(text_layer->text, text_layer->font,
+                                                                 GRect(0, 0, box.w, box.h),
+                                                                 text_layer->overflow_mode,
+                                                                 text_layer->text_alignment);
+    layout->text = text_layer->text;
+    layout->hash = hash;
+    layout->font = text_layer->font;
+    layout->box = box;
+    layout->overflow_mode = text_layer->overflow_mode;
+    layout->text_alignment = text_layer->text_alignment;
+    layout->valid = true;
+    
+    return layout->content_size;
 }
 
 void text_layer_set_size(TextLayer *text_layer, const GSize max_size)
 {
     text_layer->layer.frame.size = max_size;
+    _text_layer_changed(text_layer);
+}
+
+/*
+ * Something the text is laid out with has changed
+ */
+static void _text_layer_changed(TextLayer *text_layer)
+{
+    text_layer->layout.valid = false;
     layer_mark_dirty(&text_layer->layer);
 }
 
+/*
+ * djb2. Cheap next to laying the text out, and catches it being edited in place
+ */
+static uint32_t _text_hash(const char *text)
+{
+    uint32_t hash = 5381;
+    
+    if (!text)
+        return 0;
+    
+    while (*text)
+        hash = (hash << 5) + hash + (uint8_t)*text++;
+    
+    return hash;
+}
+
 void text_layer_draw(struct Layer *layer, GContext *context)
 {
     TextLayer *tlayer = (TextLayer *)layer->container;
@@ -121,6 +200,11 @@ void text_layer_draw(struct Layer *layer, GContext *context)
     GRect bounds = GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
     graphics_fill_rect(context, bounds, 0, GCornerNone);
 
+    /* what is on screen now, so setting it again can be skipped */
+    tlayer->text_hash = _text_hash(tlayer->text);
+    if (!tlayer->text || !*tlayer->text)
+        return;
+
     graphics_draw_text(context, tlayer->text, tlayer->font,
                        bounds, tlayer->overflow_mode,
                        tlayer->text_alignment, &tlayer->text_attributes);
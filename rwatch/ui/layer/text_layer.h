@@ -8,12 +8,27 @@
 
 #include "librebble.h"
 
+/* The last layout of a TextLayer's text, and what it was worked out for.
+ * Any of those changing, including the text in place, means laying out again */
+typedef struct TextLayout
+{
+    const char *text;
+    uint32_t hash;
+    GFont font;
+    GSize box;
+    GTextOverflowMode overflow_mode;
+    GTextAlignment text_alignment;
+    GSize content_size;
+    bool valid;
+} TextLayout;
+
 typedef struct TextLayer
 {
     Layer layer;
     const char *text;
+    uint32_t text_hash; // of the text as last set or drawn
     GFont font;
-//     GTextLayoutCacheRef layout_cache;
+    TextLayout layout;
     GColor text_color;
     GColor background_color;
     GTextOverflowMode overflow_mode;
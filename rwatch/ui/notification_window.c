@@ -51,7 +51,7 @@ static void scroll_down_click_handler(ClickRecognizerRef recognizer, void *conte
     {
         // Show the previous notification on the stack
         notification_window->active = notification->previous;
-        SYS_LOG("notification_window", APP_LOG_LEVEL_DEBUG, notification->previous->app_name);
+        SYS_LOG("notification_window", APP_LOG_LEVEL_DEBUG, "%s", notification->previous->app_name);
         
         // Scroll to top
         notification_window->offset = 0;
@@ -171,7 +171,7 @@ void notification_window_update_proc(Layer *layer, GContext *ctx)
     char *title = notification->title;
     char *body = notification->body;
     
-    SYS_LOG("notification_window", APP_LOG_LEVEL_DEBUG, app);
+    SYS_LOG("notification_window", APP_LOG_LEVEL_DEBUG, "%s", app);
     
     // Draw the background:
     graphics_context_set_fill_color(ctx, notification->color);
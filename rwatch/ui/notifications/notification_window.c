@@ -6,6 +6,7 @@
 static void _notif_man_window_load(Window *window);
 static void _notif_man_window_unload(Window *window);
 static void _nl_back_click_handler(ClickRecognizerRef _, void *context);
+static void _notif_man_push_message(NotificationLayer *notif_layer, full_msg_t *msg);
 
 void notification_message_display(OverlayWindow *overlay, Window *window)
 {    
@@ -30,8 +31,6 @@ static void _notif_man_window_load(Window *window)
 {
     notification_message *message = (notification_message *)window->context;
     
-    char *app = "RebbleOS";
-    char *title = "Test Alert";
     window->background_color = GColorWhite;
     
     Layer *layer = window_get_root_layer(window);    
@@ -39,12 +38,7 @@ static void _notif_man_window_load(Window *window)
 
     NotificationLayer *notif_layer = notification_layer_create(bounds);
     
-    cmd_phone_attribute_t *a;
-    list_foreach(a, &message->message->attributes_list_head, cmd_phone_attribute_t, node)
-    {
-        Notification *notification = notification_create(app, title, (char*)a->data, gbitmap_create_with_resource(RESOURCE_ID_SPEECH_BUBBLE), GColorRed);        
-        notification_layer_stack_push_notification(notif_layer, notification);
-    }
+    _notif_man_push_message(notif_layer, message->message);
         
     layer_add_child(layer, notification_layer_get_layer(notif_layer));
 
@@ -58,12 +52,33 @@ static void _notif_man_window_load(Window *window)
     window_dirty(true);
 }
 
+static void _notif_man_push_message(NotificationLayer *notif_layer, full_msg_t *msg)
+{
+    char *app = "RebbleOS";
+    char *title = "Test Alert";
+
+    cmd_phone_attribute_t *a;
+    list_foreach(a, &msg->attributes_list_head, cmd_phone_attribute_t, node)
+    {
+        Notification *notification = notification_create(app, title, (char*)a->data, gbitmap_create_with_resource(RESOURCE_ID_SPEECH_BUBBLE), GColorRed);        
+        notification_layer_stack_push_notification(notif_layer, notification);
+    }
+}
+
+/* another message for a window that is already up. The newest is shown,
+ * and the counter goes up */
+void notification_message_append(notification_message *nm, full_msg_t *msg)
+{
+    _notif_man_push_message(nm->notification_layer, msg);
+    layer_mark_dirty(notification_layer_get_layer(nm->notification_layer));
+}
+
 static void _notif_man_window_unload(Window *window)
 {
     notification_message *nm = (notification_message *)window->context;
     notification_layer_destroy(nm->notification_layer);
-    
-    
+    nm->notification_layer = NULL;
+    notification_message_closed(nm);
 }
 
 static void _nl_back_click_handler(ClickRecognizerRef _, void *context)
@@ -13,15 +13,29 @@
 #include "overlay_manager.h"
 #include "notification_manager.h"
 
+/* Configure Logging */
+#define MODULE_NAME "window"
+#define MODULE_TYPE "SYS"
+#define LOG_MODULE WINDOW
+
 static list_head _window_list_head = LIST_HEAD(_window_list_head);
 
+/* leave the app this much heap after snapshotting the screen for a push */
+#define PUSH_SNAPSHOT_HEAP_RESERVE 4096
+
 static void _window_load_proc(Window *window);
 
 static bool _anim_direction_left = true;
-static void _animation_util_push_fb(GRect rect, int16_t distance);
-static void _animation_setup(bool direction_left);
+static uint16_t _push_frames;
+static TickType_t _push_start;
+static void _animation_setup(Window *window, bool direction_left);
+static bool _window_push_snapshot_take(Window *window);
+static void _window_push_snapshot_free(Window *window);
+static void _window_push_composite(Window *window);
 static void _push_animation_update(Animation *animation,
                                   const AnimationProgress progress);
+static void _window_draw_damage(Window *window, GRect damage);
+static bool _window_scroll(Window *window, GRect *damage, GRect *shifted);
 
 
 /*
@@ -33,12 +47,12 @@ Window *window_create(void)
 
     if (window == NULL)
     {
-        SYS_LOG("window", APP_LOG_LEVEL_ERROR, "No memory for Window");
+        LOG_ERROR("No memory for Window");
         return NULL;
     }
 
     window_ctor(window);
-    SYS_LOG("window", APP_LOG_LEVEL_INFO, "ctor 0x%x", window);
+    LOG_INFO("ctor 0x%x", window);
     return window;
 }
 
@@ -51,7 +65,7 @@ void window_ctor(Window *window)
     window->root_layer->window = window;
     window->background_color = GColorWhite;
     window->load_state = WindowLoadStateUnloaded;
-    SYS_LOG("window", APP_LOG_LEVEL_INFO, "CTOR");
+    LOG_INFO("CTOR");
 }
 
 /*
@@ -66,39 +80,52 @@ void window_set_window_handlers(Window *window, WindowHandlers handlers)
 }
 
 static void _push_animation_setup(Animation *animation) {
-    SYS_LOG("window", APP_LOG_LEVEL_INFO, "Anim window ease in.");
+    LOG_INFO("Anim window ease in.");
 }
 
 static void _push_animation_update(Animation *animation,
                                   const AnimationProgress progress)
 {
-    Window *window = window_stack_get_top_window(); 
-    int existx = window->frame.origin.x; 
-    int newx, delta; 
-     
-    if (*((bool*)animation->context) == true) 
-    { 
-        newx = ANIM_LERP(DISPLAY_COLS, 0, progress) - 1; 
-        delta = (existx - newx);
-        if (delta && existx > 0)
-        {
-            _animation_util_push_fb(GRect(delta, 0, DISPLAY_COLS - delta, DISPLAY_ROWS), -delta);
-        }
-    } 
-    else 
-    {
+    Window *window = (Window *)animation->context;
+    int16_t newx;
+
+    /* something else got pushed over us, leave it be */
+    if (window != window_stack_get_top_window())
+        return;
+
+    if (_anim_direction_left)
+        newx = ANIM_LERP(DISPLAY_COLS, 0, progress);
+    else
         newx = ANIM_LERP(-DISPLAY_COLS, 0, progress);
-        delta = newx - existx;
-        if (delta && existx < 0)
-            _animation_util_push_fb(GRect(DISPLAY_COLS + existx + 1, 0, DISPLAY_COLS - delta + 1, DISPLAY_ROWS), delta);
-    } 
 
-    window->frame.origin.x = newx; 
-    window_dirty(true); 
+#ifdef PBL_BW
+    /* keep to whole framebuffer bytes so the old window copies across as is */
+    newx &= ~7;
+#endif
+
+    if (newx == window->frame.origin.x)
+        return;
+
+    window->frame.origin.x = newx;
+    window_dirty(true);
 }
 
-static void _push_animation_teardown(Animation *animation) {
-    SYS_LOG("window", APP_LOG_LEVEL_INFO, "Animation finished!");
+static void _push_animation_teardown(Animation *animation)
+{
+    Window *window = (Window *)animation->context;
+    
+    if (window_stack_contains_window(window) && window->push_snapshot)
+    {
+        uint32_t ms = (xTaskGetTickCount() - _push_start) * portTICK_PERIOD_MS;
+        LOG_INFO("Push transition: %d frames in %dms (%d fps)",
+                _push_frames, ms, ms ? _push_frames * 1000 / ms : 0);
+
+        _window_push_snapshot_free(window);
+        window->frame.origin.x = 0;
+        if (window == window_stack_get_top_window())
+            window_dirty(true);
+    }
+    
     animation_destroy(animation);
 }
 
@@ -135,25 +162,23 @@ void window_stack_push(Window *window, bool animated)
 
 void window_stack_push_configure(Window *window, bool animated)
 {
-    if (animated)
+    /* No room to keep the old screen around, so just cut to the new one */
+    if (animated && _window_push_snapshot_take(window))
     {
-        Window *window = window_stack_get_top_window();
-        window->frame.origin.x = DISPLAY_COLS;
         App *app = appmanager_get_current_app();
         /* A quicky hack to determine direction of scroll
          * If we are an app => face, then we go left
          * Face to app => right
          */
-        if (app->type == APP_TYPE_FACE)
-            _animation_setup(true);
-        else 
-            _animation_setup(false);
+        bool direction_left = app->type == APP_TYPE_FACE;
+        window->frame.origin.x = direction_left ? DISPLAY_COLS : -DISPLAY_COLS;
+        _animation_setup(window, direction_left);
     }
     window_configure(window);
     window_dirty(true);
 }
 
-static void _animation_setup(bool direction_left)
+static void _animation_setup(Window *window, bool direction_left)
 {
     // Animate the window change
     Animation *animation = animation_create();
@@ -167,12 +192,92 @@ static void _animation_setup(bool direction_left)
     animation_set_implementation(animation, &implementation);
  
     _anim_direction_left = direction_left;
-    animation->context = (void*)&_anim_direction_left;
+    animation->context = window;
     
     // Play the animation
     animation_schedule(animation);
 }
 
+/*
+ * Copy what is on screen now, before the window being pushed paints over it.
+ * That is all we ever draw of the outgoing window while the new one slides in.
+ */
+static bool _window_push_snapshot_take(Window *window)
+{
+    if (window->push_snapshot)
+        return true;
+
+    if (app_heap_bytes_free() < DISPLAY_FRAMEBUFFER_SIZE + PUSH_SNAPSHOT_HEAP_RESERVE)
+        return false;
+
+    /* hold off any draw in flight so we get a whole frame */
+    if (!display_buffer_lock_take(pdMS_TO_TICKS(100)))
+        return false;
+
+    window->push_snapshot = app_calloc(1, DISPLAY_FRAMEBUFFER_SIZE);
+    if (window->push_snapshot)
+        memcpy(window->push_snapshot, display_get_buffer(), DISPLAY_FRAMEBUFFER_SIZE);
+
+    display_buffer_lock_give();
+
+    _push_frames = 0;
+    _push_start = xTaskGetTickCount();
+
+    return window->push_snapshot != NULL;
+}
+
+static void _window_push_snapshot_free(Window *window)
+{
+    if (!window->push_snapshot)
+        return;
+
+    app_free(window->push_snapshot);
+    window->push_snapshot = NULL;
+}
+
+/*
+ * Fill the part of the screen the pushed window has not reached yet with
+ * the outgoing window, slid along by the same amount.
+ * Whole rows at a time, straight from the snapshot.
+ */
+static void _window_push_composite(Window *window)
+{
+    int16_t x = window->frame.origin.x;
+    uint8_t *fb = display_get_buffer();
+
+    if (x == 0)
+        return;
+
+    if (abs(x) >= DISPLAY_COLS)
+    {
+        memcpy(fb, window->push_snapshot, DISPLAY_FRAMEBUFFER_SIZE);
+        return;
+    }
+
+    /* rows may be padded past the last pixel (tintin), so skip by the
+     * pixel width, not the row stride */
+#ifdef PBL_BW
+    uint16_t width = DISPLAY_COLS / 8;
+    uint16_t bytes = abs(x) >> 3;
+#else
+    uint16_t width = DISPLAY_COLS;
+    uint16_t bytes = abs(x);
+#endif
+    uint16_t skip = width - bytes;
+
+    for (uint16_t y = 0; y < DISPLAY_ROWS; y++)
+    {
+        uint8_t *row = fb + y * DISPLAY_ROW_BYTES;
+        uint8_t *old = window->push_snapshot + y * DISPLAY_ROW_BYTES;
+
+        /* new window coming in from the right pushes the old one off left */
+        if (x > 0)
+            memcpy(row, old + skip, bytes);
+        else
+            memcpy(row + skip, old, bytes);
+    }
+}
+
 /*
  * Remove the top_window from the list
  */
@@ -247,7 +352,7 @@ uint16_t window_count(void)
         count++;
     }
     
-    SYS_LOG("window", APP_LOG_LEVEL_INFO, "COUNT %d", count);
+    LOG_INFO("COUNT %d", count);
     
     return count;
 }
@@ -291,7 +396,7 @@ void window_destroy(Window *window)
         window->load_state != WindowLoadStateUnloaded
     )
     {
-        SYS_LOG("window", APP_LOG_LEVEL_ERROR, "Window is either loading or unloading!!");
+        LOG_ERROR("Window is either loading or unloading!!");
         return;
     }
     
@@ -309,7 +414,7 @@ void window_destroy(Window *window)
     
     if (_count == 0)
     {
-        SYS_LOG("window", APP_LOG_LEVEL_INFO, "No more windows!");
+        LOG_INFO("No more windows!");
         return;
     }
     
@@ -322,7 +427,8 @@ void window_dtor(Window* window)
 {
     // free all of the layers
     layer_destroy(window->root_layer);
-    SYS_LOG("window", APP_LOG_LEVEL_INFO, "DTOR");
+    _window_push_snapshot_free(window);
+    LOG_INFO("DTOR");
 }
 
 /*
@@ -338,21 +444,163 @@ Layer *window_get_root_layer(Window *window)
 
 /*
  * Invalidate the window so it is scheduled for a redraw
+ * The whole window will be repainted
  */
 void window_dirty(bool is_dirty)
 {
     Window *wind = window_stack_get_top_window();
+
+    /* An overlay changed. It gets rendered again, and repairs the app under it */
+    if (appmanager_is_thread_overlay())
+    {
+        if (is_dirty)
+            overlay_window_dirty();
+        return;
+    }
     
     if (!wind)
         return;
 
     wind->is_render_scheduled = is_dirty;
+    wind->damage = is_dirty ? GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS) : GRect(0, 0, 0, 0);
+}
+
+/*
+ * Invalidate part of the window (in screen coordinates)
+ * and schedule a redraw
+ */
+void window_dirty_rect(Window *window, GRect rect)
+{
+    if (!window)
+        return;
+
+    rect = grect_intersection(rect, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    if (rect.size.w <= 0 || rect.size.h <= 0)
+        return;
+
+    window->damage = grect_union(window->damage, rect);
+    window->is_render_scheduled = true;
+}
+
+/*
+ * The content owner paints in rect (screen coordinates) has moved down by dy.
+ * Next draw, what is already on screen there is shifted to match, and only
+ * the strip it uncovers is painted.
+ */
+void window_scroll_rect(Window *window, const Layer *owner, GRect rect, int16_t dy)
+{
+    if (!window)
+        return;
+
+    rect = grect_intersection(rect, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+    if (rect.size.w <= 0 || rect.size.h <= 0)
+        return;
+
+    /* only the one area can be shifted each frame, the rest are repainted */
+    if (window->scroll_owner && (window->scroll_owner != owner || !RECT_EQ(window->scroll_rect, rect)))
+    {
+        window_dirty_rect(window, window->scroll_rect);
+        window_dirty_rect(window, rect);
+        window->scroll_owner = NULL;
+        window->scroll_dy = 0;
+        return;
+    }
+
+    window->scroll_owner = owner;
+    window->scroll_rect = rect;
+    window->scroll_dy += dy;
+    window->is_render_scheduled = true;
+}
+
+/*
+ * Move framebuffer rows in rect down by dy (up if negative)
+ */
+static void _window_shift_rows(GRect rect, int16_t dy)
+{
+    uint8_t *fb = display_get_buffer();
+    int16_t from = dy > 0 ? rect.origin.y : rect.origin.y - dy;
+    int16_t rows = rect.size.h - abs(dy);
+
+    if (rect.origin.x == 0 && rect.size.w == DISPLAY_COLS)
+    {
+        memmove(fb + (from + dy) * DISPLAY_ROW_BYTES, fb + from * DISPLAY_ROW_BYTES,
+                rows * DISPLAY_ROW_BYTES);
+        return;
+    }
+
+#ifdef PBL_BW
+    uint16_t first = rect.origin.x >> 3;
+    uint16_t bytes = rect.size.w >> 3;
+#else
+    uint16_t first = rect.origin.x;
+    uint16_t bytes = rect.size.w;
+#endif
+
+    /* copy away from the direction of travel so rows aren't overwritten before they move */
+    for (int16_t i = 0; i < rows; i++)
+    {
+        int16_t y = dy > 0 ? from + rows - 1 - i : from + i;
+        memcpy(fb + (y + dy) * DISPLAY_ROW_BYTES + first, fb + y * DISPLAY_ROW_BYTES + first, bytes);
+    }
+}
+
+/*
+ * Apply a pending scroll to the framebuffer, and work out what still needs
+ * painting. Damage from before the scroll moves along with the content.
+ * Returns false (and damages the whole area) if the shift can't be trusted.
+ */
+static bool _window_scroll(Window *window, GRect *damage, GRect *shifted)
+{
+    GRect rect = window->scroll_rect;
+    int16_t dy = window->scroll_dy;
+    const Layer *owner = window->scroll_owner;
+    
+    window->scroll_owner = NULL;
+    window->scroll_dy = 0;
+
+    /* being repainted anyway */
+    if (RECT_EQ(grect_union(*damage, rect), *damage))
+        return false;
+    
+    if (dy == 0 || abs(dy) >= rect.size.h || overlay_window_count() > 0 ||
+#ifdef PBL_BW
+        (rect.origin.x & 7) || (rect.size.w & 7) ||
+#endif
+        !layer_subtree_owns_rect(window->root_layer, window->frame.origin, owner, rect))
+    {
+        *damage = grect_union(*damage, rect);
+        return false;
+    }
+
+    _window_shift_rows(rect, dy);
+    
+    GRect moved = grect_intersection(*damage, rect);
+    moved.origin.y += dy;
+    moved = grect_intersection(moved, rect);
+    
+    GRect strip = dy > 0 ? GRect(rect.origin.x, rect.origin.y, rect.size.w, dy)
+                         : GRect(rect.origin.x, rect.origin.y + rect.size.h + dy, rect.size.w, -dy);
+    
+    *damage = grect_union(grect_union(*damage, moved), strip);
+    *shifted = rect;
+    
+    return true;
 }
 
 /* 
  * Draw a window.
  */
 void rbl_window_draw(Window *window)
+{
+    _window_draw_damage(window, GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS));
+}
+
+/*
+ * Draw the part of a window covered by the damage rect.
+ * Layers are drawn whole, so the damage should already have been grown
+ * to cover any layer it touches.
+ */
+static void _window_draw_damage(Window *window, GRect damage)
 {
     assert(window && "Invalid window to draw");
 
@@ -364,8 +612,13 @@ void rbl_window_draw(Window *window)
     /* Apply window offset too */
     context->offset = frame;
     context->fill_color = window->background_color;
-    graphics_fill_rect(context, GRect(0, 0, frame.size.w, frame.size.h), 0, GCornerNone);
-    layer_draw(window->root_layer, context);
+    
+    /* Only the damaged part of the background */
+    GRect fill = grect_intersection(damage, frame);
+    if (fill.size.w > 0 && fill.size.h > 0)
+        graphics_fill_rect(context, GRect(fill.origin.x - frame.origin.x, fill.origin.y - frame.origin.y,
+                                          fill.size.w, fill.size.h), 0, GCornerNone);
+    layer_draw_damage(window->root_layer, context, damage);
 }
 
 /*
@@ -389,15 +642,82 @@ bool window_draw(void)
     }
     else if (appmanager_get_thread_type() != AppThreadMainApp)
     {
-        SYS_LOG("window", APP_LOG_LEVEL_ERROR, "XXX Not app thread! I don't trust you to allocate memory correctly.");
-        SYS_LOG("window", APP_LOG_LEVEL_ERROR, "XXX Please find the correct mechanism! (did you mean overlay_x?).");
+        LOG_ERROR("XXX Not app thread! I don't trust you to allocate memory correctly.");
+        LOG_ERROR("XXX Please find the correct mechanism! (did you mean overlay_x?).");
         return false;
     }
 
     Window *wind = window_stack_get_top_window();
+    GRect screen = GRect(0, 0, DISPLAY_COLS, DISPLAY_ROWS);
+    GRect shifted = GRect(0, 0, 0, 0);
+    
+    /* Recorded layers that were marked dirty only add damage if they changed.
+     * If they were all that asked for this draw and none did, we're done */
+    if (wind->is_record_pending)
+    {
+        bool records_only = (wind->damage.size.w <= 0 || wind->damage.size.h <= 0) &&
+                            !wind->scroll_owner && !wind->push_snapshot;
+        
+        wind->is_record_pending = false;
+        layer_record_pending(wind->root_layer, rwatch_neographics_get_global_context());
+        
+        if (records_only && (wind->damage.size.w <= 0 || wind->damage.size.h <= 0))
+        {
+            wind->is_render_scheduled = false;
+            return false;
+        }
+    }
+    
+    GRect damage = wind->damage;
+    
+    if (wind->scroll_owner)
+        _window_scroll(wind, &damage, &shifted);
+    
+    /* Nobody said what changed, so assume it all did.
+     * Overlays that don't fit in their plane are painted in full over
+     * the top each frame, so while they are up we have to be too */
+    if (damage.size.w <= 0 || damage.size.h <= 0 ||
+        (overlay_window_count() > 0 && !overlay_window_plane_valid()))
+        damage = screen;
+    
+    damage = layer_grow_damage(wind->root_layer, wind->frame.origin, damage);
+    damage = grect_intersection(damage, screen);
+    
+    /* Mid push, only the part of the window that has slid in is ours to paint */
+    if (wind->push_snapshot && wind->frame.origin.x != 0)
+    {
+        GRect visible = grect_intersection(wind->frame, screen);
+        damage = visible.size.w > 0 ? grect_intersection(damage, visible) : GRect(0, 0, 0, 0);
+    }
 
-    rbl_window_draw(wind);
+#ifdef DISPLAY_DEBUG_STATS
+    TickType_t start = xTaskGetTickCount();
+#endif
+
+    if (damage.size.w > 0 && damage.size.h > 0)
+    {
+        _window_draw_damage(wind, damage);
+        display_mark_dirty_rows(damage.origin.y, damage.origin.y + damage.size.h - 1);
+    }
+    
+    if (wind->push_snapshot && wind->frame.origin.x != 0)
+    {
+        _window_push_composite(wind);
+        display_mark_dirty_rows(0, DISPLAY_ROWS - 1);
+        _push_frames++;
+    }
+    /* shifted rows weren't drawn, but they did change */
+    if (shifted.size.h > 0)
+        display_mark_dirty_rows(shifted.origin.y, shifted.origin.y + shifted.size.h - 1);
+
+#ifdef DISPLAY_DEBUG_STATS
+    LOG_DEBUG("damage %d,%d %dx%d: %d px, shifted %d rows, %dms",
+            damage.origin.x, damage.origin.y, damage.size.w, damage.size.h,
+            damage.size.w * damage.size.h, shifted.size.h,
+            (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+#endif
     wind->is_render_scheduled = false;
+    wind->damage = GRect(0, 0, 0, 0);
     
     return true;
 }
@@ -566,65 +886,6 @@ void window_load_click_config(Window *window)
 }
 
 
-/* This prob shouldn't be in here, but I feel it doesn't live in 
-   animation either */
-
-/* 
- * Grab the screenbuffer and push it off the screen left or right by n
- * pixels.
- */
-static void _animation_util_push_fb(GRect rect, int16_t distance)
-{
-#ifdef PBL_BW
-#  warning XXX: PBL_BW no push_fb support
-    return;
-#else
-    /* To revisit at some later time.
-     * The issue I can't find time to fix is that pushfb happens
-     * while we are painting */
-    return;
-    
-    uint8_t *fb = display_get_buffer();
-    if (!display_buffer_lock_take(0))
-        return;
-    
-    if (rect.origin.x < 0) rect.origin.x = 0;
-    if (rect.origin.x > DISPLAY_COLS) rect.origin.x = DISPLAY_COLS;
-    if (rect.origin.y < 0) rect.origin.y = 0;
-    if (rect.origin.y > DISPLAY_ROWS) rect.origin.y = DISPLAY_ROWS;
-    
-    uint8_t *origin = &fb[(rect.origin.y * DISPLAY_COLS) + rect.origin.x];
-    uint8_t *p;
-    int8_t incr = distance > 0 ? -1 : 1;
-
-    for (int16_t y = 0; y < rect.size.h; y++)
-    {
-        uint16_t x = distance > 0 ? rect.size.w - 1 : 0;
-       
-        p = origin + (y * DISPLAY_COLS) + x;
-        
-        for (;;)
-        {      
-            *(p + distance) = *p;
-            
-            x += incr;
-            p += incr;
-            
-            if (distance < 0 && x >= rect.size.w)
-                break;
-            else if (distance > 0 && x <= 0)
-                break;
-            
-            if ((p + distance > origin + (DISPLAY_COLS * rect.size.h) + rect.size.w) ||
-                p > origin + DISPLAY_ROWS * DISPLAY_COLS)
-                continue;
-        }
-        
-    }
-    display_buffer_lock_give();
-#endif
-}
-
 bool window_get_fullscreen(Window *window)
 {
     return true;
@@ -44,6 +44,7 @@ typedef struct Window
     void *user_data;
     GColor background_color;
     bool is_render_scheduled : 1;
+    bool is_record_pending : 1; /* recorded layers to check for changes before drawing */
     //bool on_screen : 1;
     WindowLoadState load_state;
     //bool overrides_back_button : 1;
@@ -52,6 +53,11 @@ typedef struct Window
     const char *debug_name;
     void *context;
     GRect frame;
+    GRect damage; /* screen area to repaint on the next draw */
+    const Layer *scroll_owner; /* whose content in scroll_rect moved by scroll_dy */
+    GRect scroll_rect;
+    int16_t scroll_dy;
+    uint8_t *push_snapshot; /* the screen we are sliding in over, while a push animates */
     list_node node;
 } Window;
 
@@ -87,6 +93,8 @@ Window * window_stack_get_top_window(void);
 
 void window_configure(Window *window);
 void window_dirty(bool is_dirty);
+void window_dirty_rect(Window *window, GRect rect);
+void window_scroll_rect(Window *window, const Layer *owner, GRect rect, int16_t dy);
 bool window_draw(void);
 void rbl_window_draw(Window *window);
 